@@ -0,0 +1,402 @@
+#include "client/graph_client.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "json/json.h"
+
+#include "client/http_connection.h"
+#include "util/assert.h"
+#include "util/stdx/memory.h"
+
+namespace {
+    // The requests a client sends.  The node and edge operations are also
+    // the operations of a batch, by the same names.
+    enum Route {
+        ADD_NODE,
+        REMOVE_NODE,
+        GET_NODE,
+        ADD_EDGE,
+        REMOVE_EDGE,
+        GET_EDGE,
+        GET_NEIGHBORS,
+        SHORTEST_PATH
+    };
+
+    const struct {
+        const char* name;
+        bool isEdge;
+        bool isWrite;
+    } routes[] = {
+        {"add_node", false, true},
+        {"remove_node", false, true},
+        {"get_node", false, false},
+        {"add_edge", true, true},
+        {"remove_edge", true, true},
+        {"get_edge", true, false},
+        {"get_neighbors", false, false},
+        {"shortest_path", true, false},
+    };
+
+    const char* durabilityName(Durability durability) {
+        switch (durability) {
+            case Durability::SYNC:
+                return "sync";
+            case Durability::GROUP:
+                return "group";
+            case Durability::ASYNC:
+                return "async";
+        }
+
+        return "sync";
+    }
+
+    bool isBatchable(int route) {
+        return route != GET_NEIGHBORS && route != SHORTEST_PATH;
+    }
+
+    // The status of a node or edge operation answered with 'code'.
+    Status toStatus(int route, int code, const Json::Value& value) {
+        switch (code) {
+            case 200:
+                if (routes[route].isWrite) {
+                    return StatusCode::SUCCESS;
+                }
+
+                return value["in_graph"].asBool() ? StatusCode::SUCCESS : StatusCode::DOES_NOT_EXIST;
+            case 204:
+                return StatusCode::NO_ACTION;
+            case 400:
+                return StatusCode::INVALID;
+            case 504:
+                return StatusCode::CANCELLED;
+            case 507:
+                return StatusCode::NO_SPACE;
+            default:
+                return StatusCode::ERROR;
+        }
+    }
+
+    // Split "host:port".
+    std::pair<std::string, int> splitAddress(const std::string& address) {
+        auto pos = address.find_last_of(':');
+        invariant(pos != std::string::npos);
+        return {address.substr(0, pos), std::atoi(address.c_str() + pos + 1)};
+    }
+}
+
+/**
+ * A request waiting to be sent.
+ */
+struct GraphClient::Call {
+    int route;
+    NodeId nodeAId;
+    NodeId nodeBId;
+
+    // Called with the response code and body, or with an error status if
+    // there was no response.
+    std::function<void(Status, int, const Json::Value&)> complete;
+
+    // Append the fields of the request, without braces.
+    void appendFields(std::string* out) const {
+        // Ids are sent unsigned, as the server reads them.
+        if (routes[route].isEdge) {
+            *out += "\"node_a_id\":" + std::to_string(static_cast<uint64_t>(nodeAId)) +
+                    ",\"node_b_id\":" + std::to_string(static_cast<uint64_t>(nodeBId));
+        } else {
+            *out += "\"node_id\":" + std::to_string(static_cast<uint64_t>(nodeAId));
+        }
+    }
+};
+
+/**
+ * The connections to one server, each with a thread sending the calls
+ * queued for it.
+ */
+class GraphClient::Endpoint {
+    DISALLOW_COPY(Endpoint);
+public:
+    Endpoint(const std::string& address, const Options& options, bool batching)
+            : _options(options), _batching(batching) {
+        if (options.deadline.count() > 0) {
+            _headers = "X-Deadline: " + std::to_string(options.deadline.count()) + "\r\n";
+        }
+
+        auto hostAndPort = splitAddress(address);
+        for (std::size_t i = 0; i < std::max<std::size_t>(options.connectionsPerServer, 1); i++) {
+            _senders.emplace_back(&Endpoint::run, this, hostAndPort.first, hostAndPort.second);
+        }
+    }
+
+    // Sends the calls still queued first.
+    ~Endpoint() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _queued.notify_all();
+
+        for (auto& sender : _senders) {
+            sender.join();
+        }
+    }
+
+    void submit(Call call) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _calls.push_back(std::move(call));
+        }
+        _queued.notify_one();
+    }
+
+private:
+    // Send calls on one connection until stopped and none are left.
+    void run(std::string host, int port) {
+        HTTPConnection connection(host, port);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            _queued.wait(lock, [this] { return _stopping || !_calls.empty(); });
+            if (_calls.empty()) {
+                return;
+            }
+
+            // Take a batch of node and edge operations, waiting briefly for
+            // it to fill, or else a run of requests to pipeline.
+            std::vector<Call> calls;
+            bool batch = _batching && isBatchable(_calls.front().route);
+            if (batch && _calls.size() < _options.maxBatchSize) {
+                _queued.wait_for(lock, _options.batchDelay, [this] {
+                    return _stopping || _calls.size() >= _options.maxBatchSize;
+                });
+            }
+
+            std::size_t limit = batch ? _options.maxBatchSize : _options.maxPipelineDepth;
+            while (!_calls.empty() && calls.size() < std::max<std::size_t>(limit, 1) &&
+                   (_batching && isBatchable(_calls.front().route)) == batch) {
+                calls.push_back(std::move(_calls.front()));
+                _calls.pop_front();
+            }
+
+            lock.unlock();
+            if (calls.size() > 1 && batch) {
+                sendBatch(connection, calls);
+            } else {
+                sendPipelined(connection, calls);
+            }
+            lock.lock();
+        }
+    }
+
+    void sendBatch(HTTPConnection& connection, const std::vector<Call>& calls) {
+        std::string body = "{\"operations\":[";
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            body += i ? ",{\"op\":\"" : "{\"op\":\"";
+            body += routes[calls[i].route].name;
+            body += "\",";
+            calls[i].appendFields(&body);
+            body += '}';
+        }
+        body += "],\"durability\":\"";
+        body += durabilityName(_options.durability);
+        body += "\"}";
+
+        Json::Value response;
+        auto status = connection.post("/api/v1/batch", body, _headers);
+        if (status) {
+            status = receive(connection, &response);
+        }
+
+        const Json::Value& results = response["results"];
+        if (status && (!results.isArray() || results.size() != calls.size())) {
+            connection.close();
+            status = StatusCode::ERROR;
+        }
+
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            if (status) {
+                const Json::Value& result = results[static_cast<Json::ArrayIndex>(i)];
+                calls[i].complete(status, result["code"].asInt(), result);
+            } else {
+                calls[i].complete(status, 0, Json::Value());
+            }
+        }
+    }
+
+    void sendPipelined(HTTPConnection& connection, const std::vector<Call>& calls) {
+        std::size_t sent = 0;
+        Status status = StatusCode::SUCCESS;
+        for (; sent < calls.size() && status; sent++) {
+            std::string body = "{";
+            calls[sent].appendFields(&body);
+            if (routes[calls[sent].route].isWrite) {
+                body += ",\"durability\":\"";
+                body += durabilityName(_options.durability);
+                body += '"';
+            }
+            body += '}';
+
+            status = connection.post(std::string("/api/v1/") + routes[calls[sent].route].name, body,
+                                     _headers);
+        }
+
+        // Once the connection fails, the calls without a response fail.
+        for (std::size_t i = 0; i < calls.size(); i++) {
+            Json::Value value;
+            int code = 0;
+            if (status && i < sent) {
+                status = receive(connection, &value, &code);
+            }
+
+            calls[i].complete(status, code, value);
+        }
+    }
+
+    // Receive a response, and parse its body if it has one.
+    Status receive(HTTPConnection& connection, Json::Value* value, int* code = nullptr) {
+        auto response = connection.receive();
+        if (!response) {
+            return response.getCode();
+        }
+
+        if (code) {
+            *code = response->code;
+        }
+
+        if (!response->body.empty() && !Json::Reader().parse(response->body, *value)) {
+            connection.close();
+            return StatusCode::ERROR;
+        }
+
+        return StatusCode::SUCCESS;
+    }
+
+    const Options& _options;
+    const bool _batching;
+    // Added to each request.
+    std::string _headers;
+
+    std::mutex _mutex;
+    std::condition_variable _queued;
+    std::deque<Call> _calls;
+    bool _stopping = false;
+
+    std::vector<std::thread> _senders;
+};
+
+GraphClient::GraphClient(Options options)
+        : _options(std::move(options)), _partitions(_options.servers, 0) {
+    invariant(!_options.servers.empty());
+    invariant(_options.readServers.empty() ||
+              _options.readServers.size() == _options.servers.size());
+
+    // Partitioned servers do not take batches.
+    bool batching = _options.servers.size() == 1;
+    for (const auto& address : _options.servers) {
+        _writeEndpoints.push_back(stdx::make_unique<Endpoint>(address, _options, batching));
+    }
+
+    for (const auto& address : _options.readServers) {
+        _readEndpoints.push_back(stdx::make_unique<Endpoint>(address, _options, batching));
+    }
+}
+
+GraphClient::~GraphClient() = default;
+
+void GraphClient::submit(NodeId nodeId, bool write, Call call) {
+    std::size_t partition = _partitions.target(nodeId);
+    if (write || _readEndpoints.empty()) {
+        _writeEndpoints[partition]->submit(std::move(call));
+    } else {
+        _readEndpoints[partition]->submit(std::move(call));
+    }
+}
+
+std::future<Status> GraphClient::submitStatus(int route, NodeId nodeAId, NodeId nodeBId) {
+    auto promise = std::make_shared<std::promise<Status>>();
+    Call call;
+    call.route = route;
+    call.nodeAId = nodeAId;
+    call.nodeBId = nodeBId;
+    call.complete = [promise, route](Status status, int code, const Json::Value& value) {
+        promise->set_value(status ? toStatus(route, code, value) : status);
+    };
+
+    submit(nodeAId, routes[route].isWrite, std::move(call));
+    return promise->get_future();
+}
+
+std::future<Status> GraphClient::addNode(NodeId nodeId) {
+    return submitStatus(ADD_NODE, nodeId, 0);
+}
+
+std::future<Status> GraphClient::removeNode(NodeId nodeId) {
+    return submitStatus(REMOVE_NODE, nodeId, 0);
+}
+
+std::future<Status> GraphClient::addEdge(NodeId nodeAId, NodeId nodeBId) {
+    return submitStatus(ADD_EDGE, nodeAId, nodeBId);
+}
+
+std::future<Status> GraphClient::removeEdge(NodeId nodeAId, NodeId nodeBId) {
+    return submitStatus(REMOVE_EDGE, nodeAId, nodeBId);
+}
+
+std::future<Status> GraphClient::getNode(NodeId nodeId) {
+    return submitStatus(GET_NODE, nodeId, 0);
+}
+
+std::future<Status> GraphClient::getEdge(NodeId nodeAId, NodeId nodeBId) {
+    return submitStatus(GET_EDGE, nodeAId, nodeBId);
+}
+
+std::future<StatusWith<NodeIdList>> GraphClient::getNeighbors(NodeId nodeId) {
+    auto promise = std::make_shared<std::promise<StatusWith<NodeIdList>>>();
+    Call call;
+    call.route = GET_NEIGHBORS;
+    call.nodeAId = nodeId;
+    call.nodeBId = 0;
+    call.complete = [promise](Status status, int code, const Json::Value& value) {
+        if (!status || code != 200) {
+            promise->set_value(status ? toStatus(GET_NEIGHBORS, code, value).getCode() : status.getCode());
+            return;
+        }
+
+        NodeIdList neighbors;
+        neighbors.reserve(value["neighbors"].size());
+        for (const Json::Value& neighbor : value["neighbors"]) {
+            neighbors.push_back(neighbor.asInt64());
+        }
+
+        promise->set_value(std::move(neighbors));
+    };
+
+    submit(nodeId, false, std::move(call));
+    return promise->get_future();
+}
+
+std::future<StatusWith<uint64_t>> GraphClient::shortestPath(NodeId nodeAId, NodeId nodeBId) {
+    auto promise = std::make_shared<std::promise<StatusWith<uint64_t>>>();
+    Call call;
+    call.route = SHORTEST_PATH;
+    call.nodeAId = nodeAId;
+    call.nodeBId = nodeBId;
+    call.complete = [promise](Status status, int code, const Json::Value& value) {
+        if (!status || code != 200) {
+            promise->set_value(status ? toStatus(SHORTEST_PATH, code, value).getCode() : status.getCode());
+            return;
+        }
+
+        promise->set_value(value["distance"].asUInt64());
+    };
+
+    submit(nodeAId, false, std::move(call));
+    return promise->get_future();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "db/graph_store.h"
+#include "db/partition/partition_config.h"
+#include "db/types.h"
+#include "util/nocopy.h"
+#include "util/status.h"
+
+/**
+ * A client of the graph servers, over their HTTP API.
+ *
+ * Requests are sent on persistent connections, several to each server, each
+ * served by a thread of the client.  Node and edge operations queued for an
+ * unpartitioned server are sent together as batch requests, and other
+ * requests are pipelined.
+ *
+ * Each operation is sent to the partition of its node, or of its first
+ * node, as chosen by 'PartitionConfig::target'.  With chain replication,
+ * writes go to the head of the chain and reads to its tail.
+ *
+ * Operations are applied in no particular order, except that an operation
+ * is applied after any whose future was ready when it was queued.
+ *
+ * Thread-safe.
+ */
+class GraphClient {
+    DISALLOW_COPY(GraphClient);
+public:
+    struct Options {
+        explicit Options(std::vector<std::string> servers) : servers(std::move(servers)) {}
+
+        // The "host:port" of the server of each partition, in partition
+        // order, or of the only server.  With chain replication, the head
+        // of each chain.
+        std::vector<std::string> servers;
+
+        // With chain replication, the tail of each chain, which serves
+        // reads.  Reads go to 'servers' if empty.
+        std::vector<std::string> readServers;
+
+        // The connections kept open to each server.
+        std::size_t connectionsPerServer = 4;
+
+        // The most operations sent in one batch, and how long a connection
+        // waits for more operations to fill a batch.
+        std::size_t maxBatchSize = 256;
+        std::chrono::microseconds batchDelay{100};
+
+        // The most requests sent on a connection before their responses are
+        // read.
+        std::size_t maxPipelineDepth = 32;
+
+        // How durable writes must be before they are acknowledged.
+        Durability durability = Durability::SYNC;
+
+        // How long a server may take to answer a request, sent to it as
+        // the request's deadline, or 0 for no limit.  Requests queued in
+        // the client are not limited.
+        std::chrono::milliseconds deadline{0};
+    };
+
+    explicit GraphClient(Options options);
+
+    // Waits for the operations queued to be answered.
+    ~GraphClient();
+
+    /**
+     * Writes complete with the status of their single request: SUCCESS,
+     * NO_ACTION if there was nothing to do, NO_SPACE if the server is out
+     * of log space, INVALID if refused, CANCELLED if the deadline passed,
+     * or ERROR if the server could not be reached or failed.  A write which
+     * fails with ERROR or CANCELLED may have been applied.
+     */
+    std::future<Status> addNode(NodeId nodeId);
+    std::future<Status> removeNode(NodeId nodeId);
+    std::future<Status> addEdge(NodeId nodeAId, NodeId nodeBId);
+    std::future<Status> removeEdge(NodeId nodeAId, NodeId nodeBId);
+
+    /**
+     * Lookups complete with SUCCESS if the node or edge exists, and
+     * DOES_NOT_EXIST if not.
+     */
+    std::future<Status> getNode(NodeId nodeId);
+    std::future<Status> getEdge(NodeId nodeAId, NodeId nodeBId);
+
+    /**
+     * Find the neighbors of 'nodeId'.  Fails with INVALID if it does not
+     * exist.
+     */
+    std::future<StatusWith<NodeIdList>> getNeighbors(NodeId nodeId);
+
+    /**
+     * Find the length of the shortest path between 'nodeAId' and 'nodeBId'.
+     * Only unpartitioned servers find paths.
+     */
+    std::future<StatusWith<uint64_t>> shortestPath(NodeId nodeAId, NodeId nodeBId);
+
+private:
+    class Endpoint;
+    struct Call;
+
+    // Queue 'call' for the server of 'nodeId'.
+    void submit(NodeId nodeId, bool write, Call call);
+
+    std::future<Status> submitStatus(int route, NodeId nodeAId, NodeId nodeBId);
+
+    Options _options;
+    PartitionConfig _partitions;
+
+    // The servers of each partition, which are the same unless replicated.
+    std::vector<std::unique_ptr<Endpoint>> _writeEndpoints;
+    std::vector<std::unique_ptr<Endpoint>> _readEndpoints;
+};
@@ -0,0 +1,254 @@
+#include "client/http_connection.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    const std::size_t READ_SIZE = 64 * 1024;
+
+    // Whether the header line [begin, end) is 'name', which is lower case,
+    // and if so point 'value' at its value.
+    bool matchHeader(const char* begin, const char* end, const char* name, const char** value) {
+        std::size_t length = std::strlen(name);
+        if (static_cast<std::size_t>(end - begin) <= length || begin[length] != ':') {
+            return false;
+        }
+
+        for (std::size_t i = 0; i < length; i++) {
+            if (std::tolower(static_cast<unsigned char>(begin[i])) != name[i]) {
+                return false;
+            }
+        }
+
+        *value = begin + length + 1;
+        while (*value < end && **value == ' ') {
+            (*value)++;
+        }
+
+        return true;
+    }
+
+    // Parse a chunked body starting at 'position', appending it to 'body' if
+    // set.  Returns the end of the body, 0 if incomplete, or INVALID.
+    StatusWith<std::size_t> parseChunks(const std::string& data, std::size_t position,
+                                        std::string* body) {
+        for (;;) {
+            std::size_t lineEnd = data.find("\r\n", position);
+            if (lineEnd == std::string::npos) {
+                return static_cast<std::size_t>(0);
+            }
+
+            char* sizeEnd;
+            unsigned long size = std::strtoul(data.c_str() + position, &sizeEnd, 16);
+            if (sizeEnd == data.c_str() + position) {
+                return StatusCode::INVALID;
+            }
+
+            position = lineEnd + 2;
+            if (size == 0) {
+                // No trailers are sent.
+                if (data.size() < position + 2) {
+                    return static_cast<std::size_t>(0);
+                }
+
+                return position + 2;
+            }
+
+            if (data.size() < position + size + 2) {
+                return static_cast<std::size_t>(0);
+            }
+
+            if (body) {
+                body->append(data, position, size);
+            }
+            position += size + 2;
+        }
+    }
+}
+
+StatusWith<std::size_t> parseHTTPResponse(const std::string& data, HTTPResponse* response) {
+    std::size_t headEnd = data.find("\r\n\r\n");
+    if (headEnd == std::string::npos) {
+        return static_cast<std::size_t>(0);
+    }
+
+    // "HTTP/1.x <code>..."
+    if (data.compare(0, 5, "HTTP/") != 0) {
+        return StatusCode::INVALID;
+    }
+
+    std::size_t codeStart = data.find(' ');
+    if (codeStart == std::string::npos || codeStart > headEnd) {
+        return StatusCode::INVALID;
+    }
+
+    response->code = std::atoi(data.c_str() + codeStart + 1);
+    response->body.clear();
+    if (response->code < 100) {
+        return StatusCode::INVALID;
+    }
+
+    // Header values may hold any bytes, so lines are only split on CRLF.
+    std::size_t contentLength = 0;
+    bool chunked = false;
+    std::size_t lineStart = data.find("\r\n") + 2;
+    while (lineStart < headEnd + 2) {
+        std::size_t lineEnd = data.find("\r\n", lineStart);
+        const char* begin = data.data() + lineStart;
+        const char* end = data.data() + lineEnd;
+        const char* value;
+        if (matchHeader(begin, end, "content-length", &value)) {
+            contentLength = std::strtoul(value, nullptr, 10);
+        } else if (matchHeader(begin, end, "transfer-encoding", &value)) {
+            chunked = std::string(value, end).find("chunked") != std::string::npos;
+        }
+
+        lineStart = lineEnd + 2;
+    }
+
+    std::size_t bodyStart = headEnd + 4;
+    if (chunked) {
+        // The body is only copied out once all of it has arrived.
+        auto end = parseChunks(data, bodyStart, nullptr);
+        if (end && *end) {
+            parseChunks(data, bodyStart, &response->body);
+        }
+
+        return end;
+    }
+
+    if (data.size() < bodyStart + contentLength) {
+        return static_cast<std::size_t>(0);
+    }
+
+    response->body.assign(data, bodyStart, contentLength);
+    return bodyStart + contentLength;
+}
+
+HTTPConnection::HTTPConnection(std::string host, int port)
+        : _host(std::move(host)), _port(port) {}
+
+HTTPConnection::~HTTPConnection() {
+    close();
+}
+
+Status HTTPConnection::connect() {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses;
+    if (getaddrinfo(_host.c_str(), std::to_string(_port).c_str(), &hints, &addresses) != 0) {
+        return StatusCode::ERROR;
+    }
+
+    for (struct addrinfo* address = addresses; address; address = address->ai_next) {
+        _fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (_fd == -1) {
+            continue;
+        }
+
+        if (::connect(_fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+
+        ::close(_fd);
+        _fd = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (_fd == -1) {
+        return StatusCode::ERROR;
+    }
+
+    // Requests are small, and should not wait to be coalesced.
+    int noDelay = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return StatusCode::SUCCESS;
+}
+
+Status HTTPConnection::post(const std::string& path, const std::string& body,
+                            const std::string& headers) {
+    if (_fd == -1) {
+        auto status = connect();
+        if (!status) {
+            return status;
+        }
+    }
+
+    std::string request;
+    request.reserve(128 + path.size() + headers.size() + body.size());
+    request += "POST ";
+    request += path;
+    request += " HTTP/1.1\r\nHost: ";
+    request += _host;
+    request += "\r\nContent-Type: application/json\r\nContent-Length: ";
+    request += std::to_string(body.size());
+    request += "\r\n";
+    request += headers;
+    request += "\r\n";
+    request += body;
+
+    std::size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t size = send(_fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (size == -1 && errno == EINTR) {
+            continue;
+        } else if (size == -1) {
+            close();
+            return StatusCode::ERROR;
+        }
+
+        sent += size;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusWith<HTTPResponse> HTTPConnection::receive() {
+    if (_fd == -1) {
+        return StatusCode::ERROR;
+    }
+
+    HTTPResponse response;
+    for (;;) {
+        auto parsed = parseHTTPResponse(_buffer, &response);
+        if (!parsed) {
+            close();
+            return StatusCode::ERROR;
+        } else if (*parsed) {
+            _buffer.erase(0, *parsed);
+            return std::move(response);
+        }
+
+        char data[READ_SIZE];
+        ssize_t size = recv(_fd, data, sizeof(data), 0);
+        if (size == -1 && errno == EINTR) {
+            continue;
+        } else if (size <= 0) {
+            close();
+            return StatusCode::ERROR;
+        }
+
+        _buffer.append(data, size);
+    }
+}
+
+void HTTPConnection::close() {
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    _buffer.clear();
+}
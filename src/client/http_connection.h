@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "util/nocopy.h"
+#include "util/status.h"
+
+/**
+ * A response received by an 'HTTPConnection'.
+ */
+struct HTTPResponse {
+    int code = 0;
+    std::string body;
+};
+
+/**
+ * Parse the response at the start of 'data', which holds a status line,
+ * headers, and a body with a Content-Length or chunked transfer encoding.
+ *
+ * Returns: The number of bytes of the response, 0 if 'data' does not hold
+ * all of it yet, or INVALID if it is malformed.
+ */
+StatusWith<std::size_t> parseHTTPResponse(const std::string& data, HTTPResponse* response);
+
+/**
+ * A persistent HTTP/1.1 connection to a server, which may have several
+ * requests outstanding.
+ *
+ * Not thread-safe.
+ */
+class HTTPConnection {
+    DISALLOW_COPY(HTTPConnection);
+public:
+    HTTPConnection(std::string host, int port);
+
+    ~HTTPConnection();
+
+    /**
+     * Send a POST of the JSON 'body' to 'path', connecting first if needed.
+     * 'headers' are added to the request, each line ending with CRLF.
+     * Further requests may be sent before the response to this one is
+     * received.
+     */
+    Status post(const std::string& path, const std::string& body,
+                const std::string& headers = std::string());
+
+    /**
+     * Receive the response to the earliest request not yet answered.
+     */
+    StatusWith<HTTPResponse> receive();
+
+    /**
+     * Close the connection, dropping any outstanding requests.  The next
+     * request opens a new one.
+     */
+    void close();
+
+private:
+    Status connect();
+
+    std::string _host;
+    int _port;
+
+    int _fd = -1;
+    // Bytes received, but not yet parsed.
+    std::string _buffer;
+};
@@ -0,0 +1,54 @@
+#include "client/http_connection.h"
+
+#include <string>
+
+#include "util/testing.h"
+
+TEST(HTTPConnectionParseResponse) {
+    // Header values may hold NULs.
+    std::string data = "HTTP/1.0 200\r\nContent-Length: 14\r\nSet-cookie: ab\r\n\r\n"
+                       "{\"node_id\":1}\nHTTP/1.0 204\r\nContent-Length: 0\r\n\r\n";
+    data.insert(data.find("ab") + 1, 1, '\0');
+
+    HTTPResponse response;
+    auto parsed = parseHTTPResponse(data, &response);
+    EXPECT_TRUE(parsed);
+    EXPECT_EQ(response.code, 200);
+    EXPECT_EQ(response.body, "{\"node_id\":1}\n");
+
+    data.erase(0, *parsed);
+    parsed = parseHTTPResponse(data, &response);
+    EXPECT_EQ(*parsed, data.size());
+    EXPECT_EQ(response.code, 204);
+    EXPECT_EQ(response.body, "");
+
+    // Incomplete responses are not parsed.
+    parsed = parseHTTPResponse("HTTP/1.0 200\r\nContent-Length: 14\r\n\r\n{\"no", &response);
+    EXPECT_TRUE(parsed);
+    EXPECT_EQ(*parsed, 0);
+
+    EXPECT_FALSE(parseHTTPResponse("SPDY 200\r\n\r\n", &response));
+
+    END;
+}
+
+TEST(HTTPConnectionParseChunkedResponse) {
+    std::string data = "HTTP/1.1 200\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "5\r\n{\"a\":\r\n2\r\n1}\r\n0\r\n\r\n";
+
+    HTTPResponse response;
+    for (std::size_t size = 0; size < data.size(); size++) {
+        EXPECT_EQ(*parseHTTPResponse(data.substr(0, size), &response), 0);
+    }
+
+    auto parsed = parseHTTPResponse(data, &response);
+    EXPECT_EQ(*parsed, data.size());
+    EXPECT_EQ(response.body, "{\"a\":1}");
+
+    END;
+}
+
+int main() {
+    HTTPConnectionParseResponse();
+    HTTPConnectionParseChunkedResponse();
+}
@@ -0,0 +1,226 @@
+#include "db/caching_store.h"
+
+#include <functional>
+#include <utility>
+
+#include "util/assert.h"
+
+CachingStore::CachingStore(GraphStore* store, std::size_t capacity)
+        : _store(store), _capacity(capacity) {
+    invariant(_store);
+}
+
+StatusWith<std::shared_ptr<const std::string>> CachingStore::getSerializedNeighbors(
+        NodeId nodeId, const Serializer& serialize) {
+    std::size_t stripe = std::hash<NodeId>()(nodeId) % VERSION_STRIPES;
+
+    Ticket ticket;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(nodeId);
+        if (it != _entries.end()) {
+            _hits++;
+            _recent.splice(_recent.begin(), _recent, it->second.recent);
+            return it->second.data;
+        }
+
+        _misses++;
+        ticket = {_versions[stripe], _removalsStarted, _removalsStarted == _removalsFinished};
+    }
+
+    auto neighbors = _store->getNeighbors(nodeId);
+    if (!neighbors) {
+        return neighbors.getCode();
+    }
+
+    auto data = std::make_shared<const std::string>(serialize(nodeId, *neighbors));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool current = ticket.cacheable && _versions[stripe] == ticket.version &&
+                   _removalsStarted == ticket.removals;
+    if (current && data->size() <= _capacity && !_entries.count(nodeId)) {
+        _recent.push_front(nodeId);
+        _entries.emplace(nodeId, Entry{data, _recent.begin()});
+        _bytes += data->size();
+        evictLocked();
+    }
+
+    return std::shared_ptr<const std::string>(std::move(data));
+}
+
+CachingStore::Stats CachingStore::getStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {_hits, _misses, _entries.size(), _bytes, _capacity};
+}
+
+void CachingStore::invalidate(std::initializer_list<NodeId> nodeIds) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (NodeId nodeId : nodeIds) {
+        invalidateLocked(nodeId);
+    }
+}
+
+void CachingStore::invalidateLocked(NodeId nodeId) {
+    _versions[std::hash<NodeId>()(nodeId) % VERSION_STRIPES]++;
+
+    auto it = _entries.find(nodeId);
+    if (it == _entries.end()) {
+        return;
+    }
+
+    _bytes -= it->second.data->size();
+    _recent.erase(it->second.recent);
+    _entries.erase(it);
+}
+
+void CachingStore::evictLocked() {
+    while (_bytes > _capacity) {
+        auto it = _entries.find(_recent.back());
+        _bytes -= it->second.data->size();
+        _entries.erase(it);
+        _recent.pop_back();
+    }
+}
+
+Status CachingStore::addNode(NodeId nodeId, Durability durability) {
+    // A node added has no neighbors, and a node not in the store has no
+    // list cached.
+    return _store->addNode(nodeId, durability);
+}
+
+Status CachingStore::removeNode(NodeId nodeId, Durability durability) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _removalsStarted++;
+    }
+
+    // An edge to the node added after its neighbors are found drops the
+    // list of its other node itself, and no list is cached until the
+    // removal finishes.
+    std::vector<NodeId> touched = {nodeId};
+    auto neighbors = _store->getNeighbors(nodeId);
+    if (neighbors) {
+        touched.insert(touched.end(), neighbors->begin(), neighbors->end());
+    }
+
+    auto status = _store->removeNode(nodeId, durability);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (NodeId touchedId : touched) {
+        invalidateLocked(touchedId);
+    }
+    _removalsFinished++;
+    return status;
+}
+
+StatusWith<Node*> CachingStore::findNode(NodeId nodeId) const {
+    return _store->findNode(nodeId);
+}
+
+StatusWith<std::pair<Node*, Node*>> CachingStore::getEdge(NodeId nodeAId, NodeId nodeBId) const {
+    return _store->getEdge(nodeAId, nodeBId);
+}
+
+Status CachingStore::addEdge(NodeId nodeAId, NodeId nodeBId, Durability durability) {
+    auto status = _store->addEdge(nodeAId, nodeBId, durability);
+    invalidate({nodeAId, nodeBId});
+    return status;
+}
+
+Status CachingStore::removeEdge(NodeId nodeAId, NodeId nodeBId, Durability durability) {
+    auto status = _store->removeEdge(nodeAId, nodeBId, durability);
+    invalidate({nodeAId, nodeBId});
+    return status;
+}
+
+Status CachingStore::getEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) const {
+    return _store->getEdgePart(nodeLocalId, nodeRemoteId);
+}
+
+Status CachingStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability durability) {
+    auto status = _store->addEdgePart(nodeLocalId, nodeRemoteId, durability);
+    invalidate({nodeLocalId});
+    return status;
+}
+
+Status CachingStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability durability) {
+    auto status = _store->removeEdgePart(nodeLocalId, nodeRemoteId, durability);
+    invalidate({nodeLocalId});
+    return status;
+}
+
+StatusWith<NodeIdList> CachingStore::getNeighbors(NodeId nodeId) const {
+    return _store->getNeighbors(nodeId);
+}
+
+StatusWith<uint64_t> CachingStore::getDegree(NodeId nodeId) const {
+    return _store->getDegree(nodeId);
+}
+
+StatusWith<NodeIdList> CachingStore::getNeighborPage(NodeId nodeId, NodeId from,
+                                                     std::size_t limit) const {
+    return _store->getNeighborPage(nodeId, from, limit);
+}
+
+Status CachingStore::visitNeighbors(NodeId nodeId,
+                                    const std::function<void(NodeId)>& visit) const {
+    return _store->visitNeighbors(nodeId, visit);
+}
+
+StatusWith<uint64_t> CachingStore::shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                                 const Cancellation* cancellation) const {
+    return _store->shortestPath(nodeAId, nodeBId, cancellation);
+}
+
+std::vector<Status> CachingStore::applyBatch(const std::vector<BatchOperation>& operations,
+                                             Durability durability) {
+    std::vector<NodeId> touched;
+    bool removes = false;
+    for (const auto& operation : operations) {
+        switch (operation.type) {
+            case BatchOperation::Type::REMOVE_NODE:
+                removes = true;
+                touched.push_back(operation.nodeAId);
+                break;
+            case BatchOperation::Type::ADD_EDGE:
+            case BatchOperation::Type::REMOVE_EDGE:
+                touched.push_back(operation.nodeAId);
+                touched.push_back(operation.nodeBId);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Removals are applied as by 'removeNode'.  Edges the batch adds to a
+    // removed node are touched by the batch already.
+    if (removes) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _removalsStarted++;
+        }
+
+        for (const auto& operation : operations) {
+            if (operation.type != BatchOperation::Type::REMOVE_NODE) {
+                continue;
+            }
+
+            auto neighbors = _store->getNeighbors(operation.nodeAId);
+            if (neighbors) {
+                touched.insert(touched.end(), neighbors->begin(), neighbors->end());
+            }
+        }
+    }
+
+    auto statuses = _store->applyBatch(operations, durability);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (NodeId nodeId : touched) {
+        invalidateLocked(nodeId);
+    }
+    if (removes) {
+        _removalsFinished++;
+    }
+
+    return statuses;
+}
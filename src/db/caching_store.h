@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "db/graph_store.h"
+#include "db/types.h"
+#include "util/nocopy.h"
+#include "util/status.h"
+
+/**
+ * A graph store which caches the serialized neighbor lists of the nodes of
+ * another store, keeping those used most recently up to a number of bytes.
+ *
+ * All writes must go through the caching store, which drops the lists of
+ * the nodes they touch once they are applied.  A list is never cached from
+ * a read which a write may have overtaken, so a read which starts after a
+ * write finishes sees it.
+ *
+ * Thread-safe, if the store it wraps is.
+ */
+class CachingStore : public GraphStore {
+    DISALLOW_COPY(CachingStore);
+public:
+    /**
+     * Serializes the neighbors of a node.  All callers must serialize the
+     * same way.
+     */
+    using Serializer = std::function<std::string(NodeId, const NodeIdList&)>;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        std::size_t entries;
+        std::size_t bytes;
+        std::size_t capacity;
+    };
+
+    CachingStore(GraphStore* store, std::size_t capacity);
+
+    /**
+     * Find the neighbors of 'nodeId', serialized by 'serialize', from the
+     * cache if they are there.
+     */
+    StatusWith<std::shared_ptr<const std::string>> getSerializedNeighbors(NodeId nodeId,
+                                                                          const Serializer& serialize);
+
+    /**
+     * Get the hits and misses of 'getSerializedNeighbors' so far, and what
+     * the cache holds.
+     */
+    Stats getStats() const;
+
+    virtual Status addNode(NodeId nodeId,
+                           Durability durability = Durability::SYNC) override;
+
+    /**
+     * Remove a node from the store, dropping its list and the lists of its
+     * neighbors.
+     */
+    virtual Status removeNode(NodeId nodeId,
+                              Durability durability = Durability::SYNC) override;
+
+    virtual StatusWith<Node*> findNode(NodeId nodeId) const override;
+
+    virtual StatusWith<std::pair<Node*, Node*>> getEdge(NodeId nodeAId,
+                                                        NodeId nodeBId) const override;
+
+    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId,
+                           Durability durability = Durability::SYNC) override;
+
+    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId,
+                              Durability durability = Durability::SYNC) override;
+
+    virtual Status getEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) const override;
+
+    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                               Durability durability = Durability::SYNC) override;
+
+    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                                  Durability durability = Durability::SYNC) override;
+
+    virtual StatusWith<NodeIdList> getNeighbors(NodeId nodeId) const override;
+
+    virtual StatusWith<uint64_t> getDegree(NodeId nodeId) const override;
+
+    virtual StatusWith<NodeIdList> getNeighborPage(NodeId nodeId, NodeId from,
+                                                   std::size_t limit) const override;
+
+    virtual Status visitNeighbors(NodeId nodeId,
+                                  const std::function<void(NodeId)>& visit) const override;
+
+    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                              const Cancellation* cancellation = nullptr) const override;
+
+    virtual std::vector<Status> applyBatch(const std::vector<BatchOperation>& operations,
+                                           Durability durability = Durability::SYNC) override;
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::string> data;
+        // The entry's place in '_recent'.
+        std::list<NodeId>::iterator recent;
+    };
+
+    // What a list read from the store is checked against before it is
+    // cached: whether a write touching the node, or removing any node,
+    // has been applied since the read started.  Lists read while a
+    // removal is applied are not cached.
+    struct Ticket {
+        uint64_t version;
+        uint64_t removals;
+        bool cacheable;
+    };
+
+    static const std::size_t VERSION_STRIPES = 256;
+
+    // Drop the lists of 'nodeIds'.  Called after the writes touching them
+    // are applied.
+    void invalidate(std::initializer_list<NodeId> nodeIds);
+
+    // Called with '_mutex' held.
+    void invalidateLocked(NodeId nodeId);
+    void evictLocked();
+
+    GraphStore* _store;
+    const std::size_t _capacity;
+
+    mutable std::mutex _mutex;
+    std::unordered_map<NodeId, Entry> _entries;
+    // Node ids, the most recently used first.
+    std::list<NodeId> _recent;
+    std::size_t _bytes = 0;
+
+    // Counts of the writes applied to the nodes of each stripe, and of the
+    // node removals started and finished.  Removals touch nodes not known
+    // until they are applied, so no list is cached while one is applied.
+    std::array<uint64_t, VERSION_STRIPES> _versions{};
+    uint64_t _removalsStarted = 0;
+    uint64_t _removalsFinished = 0;
+
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+};
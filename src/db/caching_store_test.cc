@@ -0,0 +1,106 @@
+#include "util/testing.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "db/caching_store.h"
+#include "db/memory_store.h"
+#include "db/types.h"
+#include "util/status.h"
+
+namespace {
+    // The neighbors, in id order.
+    std::string serialize(NodeId, const NodeIdList& neighbors) {
+        NodeIdList sorted = neighbors;
+        std::sort(sorted.begin(), sorted.end());
+
+        std::string data;
+        for (NodeId neighbor : sorted) {
+            data += std::to_string(neighbor) + ";";
+        }
+        return data;
+    }
+
+    std::string neighbors(CachingStore& store, NodeId nodeId) {
+        auto data = store.getSerializedNeighbors(nodeId, serialize);
+        return data ? **data : "missing";
+    }
+}
+
+TEST(CachingStoreInvalidate) {
+    MemoryStore memoryStore;
+    CachingStore store(&memoryStore, 1 << 20);
+
+    for (NodeId nodeId = 1; nodeId <= 4; nodeId++) {
+        EXPECT_TRUE(store.addNode(nodeId) == StatusCode::SUCCESS);
+    }
+    EXPECT_TRUE(store.addEdge(1, 2) == StatusCode::SUCCESS);
+
+    EXPECT_EQ(neighbors(store, 1), "2;");
+    EXPECT_EQ(neighbors(store, 1), "2;");
+    EXPECT_EQ(neighbors(store, 2), "1;");
+    EXPECT_EQ(neighbors(store, 5), "missing");
+
+    auto stats = store.getStats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 3);
+    EXPECT_EQ(stats.entries, 2);
+    EXPECT_EQ(stats.bytes, 4);
+
+    // Each write drops the lists of the nodes it touches.
+    EXPECT_TRUE(store.addEdge(1, 3) == StatusCode::SUCCESS);
+    EXPECT_EQ(neighbors(store, 1), "2;3;");
+    EXPECT_TRUE(store.removeEdge(1, 2) == StatusCode::SUCCESS);
+    EXPECT_EQ(neighbors(store, 1), "3;");
+    EXPECT_EQ(neighbors(store, 2), "");
+
+    std::vector<BatchOperation> batch = {
+        BatchOperation(BatchOperation::Type::ADD_EDGE, 2, 3),
+        BatchOperation(BatchOperation::Type::REMOVE_NODE, 4),
+    };
+    store.applyBatch(batch);
+    EXPECT_EQ(neighbors(store, 2), "3;");
+
+    // Removing a node changes the lists of its neighbors.
+    EXPECT_EQ(neighbors(store, 3), "1;2;");
+    EXPECT_TRUE(store.removeNode(1) == StatusCode::SUCCESS);
+    EXPECT_EQ(neighbors(store, 3), "2;");
+    EXPECT_EQ(neighbors(store, 1), "missing");
+
+    END;
+}
+
+TEST(CachingStoreEvict) {
+    MemoryStore memoryStore;
+    CachingStore store(&memoryStore, 4);
+
+    for (NodeId nodeId = 1; nodeId <= 4; nodeId++) {
+        EXPECT_TRUE(store.addNode(nodeId) == StatusCode::SUCCESS);
+    }
+    EXPECT_TRUE(store.addEdge(1, 2) == StatusCode::SUCCESS);
+    EXPECT_TRUE(store.addEdge(3, 4) == StatusCode::SUCCESS);
+
+    // The least recently used list is dropped to make room.
+    neighbors(store, 1);
+    neighbors(store, 2);
+    neighbors(store, 1);
+    neighbors(store, 3);
+
+    auto stats = store.getStats();
+    EXPECT_EQ(stats.entries, 2);
+    EXPECT_EQ(stats.bytes, 4);
+
+    neighbors(store, 1);
+    neighbors(store, 2);
+    stats = store.getStats();
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.misses, 4);
+
+    END;
+}
+
+int main() {
+    CachingStoreInvalidate();
+    CachingStoreEvict();
+}
@@ -1,8 +1,14 @@
 #include "db/checkpoint_manager.h"
 
+#include <algorithm>
+#include <cstring>
 #include <exception>
+#include <future>
+#include <memory>
 #include <utility>
+#include <vector>
 
+#include "db/csr_image.h"
 #include "db/logged_store.h"
 #include "db/types.h"
 #include "io/buffer_manager.h"
@@ -11,19 +17,62 @@
 #include "util/stdx/memory.h"
 #include "platform_params.h"
 
-struct CheckpointSuperBlock {
-    bool checkpointed;
+// The number of incremental checkpoints taken before compacting into a new
+// base image.
+constexpr uint64_t MAX_DELTA_CHECKPOINTS = 8;
+
+// Marks a node record of a node removed since the previous checkpoint, in
+// place of the edge count.
+constexpr uint64_t REMOVED_NODE = UINT64_MAX;
+
+/**
+ * An incremental checkpoint, holding a record for each node modified since
+ * the previous checkpoint.
+ */
+struct DeltaCheckpoint {
     uint64_t checkpointVersion;
-    uint64_t nodeCount;
+    uint64_t recordCount;
+    uint64_t startBlock;
+};
+
+/**
+ * A base image, followed by the incremental checkpoints taken after it.  The
+ * base image is a `CsrImage` at the start of the slot.
+ */
+struct CheckpointSlot {
+    bool checkpointed;
+    uint64_t checkpointVersion; // The generation of the newest delta, or the base.
+    uint64_t nodeCount; // The number of nodes in the base image.
+    uint64_t edgeCount; // The number of edges in the base image.
+    uint64_t endBlock; // The first unused block of the slot.
+    uint64_t deltaCount;
+    DeltaCheckpoint deltas[MAX_DELTA_CHECKPOINTS];
+};
+
+/**
+ * The checkpoint space is split in two slots.  A new base image is written to
+ * the slot not holding the newest complete one, which remains restorable
+ * until the new base image completes.
+ */
+struct CheckpointSuperBlock {
+    CheckpointSlot slots[2];
 };
 
+// The number of nodes copied out of the snapshot at a time.
+constexpr std::size_t CHECKPOINT_BATCH_SIZE = 1024;
+
+// The number of blocks moved by each checkpoint read or write.
+constexpr uint64_t CHECKPOINT_IO_BLOCKS = 512;
+
 CheckpointManager::CheckpointManager(const BufferManager& bufferManager,
                                      std::pair<uint64_t, uint64_t> blockRange,
                                      LoggedStore* loggedStore)
         : _bufferManager(bufferManager), _loggedStore(loggedStore),
           _checkpointBlockMin(blockRange.first),
-          _checkpointBlockMax(blockRange.second) {
+          _checkpointBlockMax(blockRange.second),
+          _slotSize((_checkpointBlockMax - _checkpointBlockMin - 1) / 2) {
     invariant(_checkpointBlockMin < _checkpointBlockMax);
+    invariant(_slotSize > 0);
 }
 
 
@@ -44,155 +93,436 @@ bool CheckpointManager::hasCheckpoint(uint64_t generationNumber) {
     invariant(_superblock);
     CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
 
-    return superblock->checkpointed && superblock->checkpointVersion == generationNumber;
+    for (const CheckpointSlot& slot : superblock->slots) {
+        if (slot.checkpointed && slot.checkpointVersion == generationNumber) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+StatusWith<uint64_t> CheckpointManager::getLatestCheckpoint() {
+    invariant(_superblock);
+    CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+
+    int slot = latestSlot();
+    if (slot == -1) {
+        return StatusCode::DOES_NOT_EXIST;
+    }
+
+    return superblock->slots[slot].checkpointVersion;
+}
+
+int CheckpointManager::latestSlot() const {
+    CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+
+    int latest = -1;
+    for (int i = 0; i < 2; i++) {
+        const CheckpointSlot& slot = superblock->slots[i];
+        if (slot.checkpointed && (latest == -1 ||
+                slot.checkpointVersion > superblock->slots[latest].checkpointVersion)) {
+            latest = i;
+        }
+    }
+
+    return latest;
+}
+
+std::pair<uint64_t, uint64_t> CheckpointManager::slotRange(int slot) const {
+    uint64_t start = _checkpointBlockMin + 1 + slot * _slotSize;
+    return {start, start + _slotSize};
+}
+
+bool CheckpointManager::needsFullCheckpoint() {
+    invariant(_superblock);
+    CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+
+    int latest = latestSlot();
+    if (latest == -1 || _forceFullCheckpoint) {
+        return true;
+    }
+
+    const CheckpointSlot& slot = superblock->slots[latest];
+    if (slot.deltaCount == MAX_DELTA_CHECKPOINTS) {
+        return true;
+    }
+
+    // Compact once the deltas outgrow the base image, or fill half the slot.
+    uint64_t slotStart = slotRange(latest).first;
+    uint64_t baseEnd = slot.deltaCount ? slot.deltas[0].startBlock : slot.endBlock;
+    if (slot.endBlock - baseEnd > baseEnd - slotStart ||
+            slot.endBlock - slotStart > _slotSize / 2) {
+        return true;
+    }
+
+    // A delta of most of the graph costs as much as a full checkpoint.
+    const auto& memoryStore = _loggedStore->_memoryStore;
+    return memoryStore.getDirtyNodeCount() * 2 > memoryStore.getNodeCount();
 }
 
+/**
+ * Streams data to consecutive blocks.  Blocks are written a contiguous window
+ * of CHECKPOINT_IO_BLOCKS at a time, in the background while the next window
+ * is filled.
+ */
 class BlockWriter {
 public:
     class OutOfSpaceException : public std::exception {
     };
 
     BlockWriter(const BufferManager& bufferManager, uint64_t start, uint64_t end)
-            : _bufferManager(bufferManager), _start(start), _end(end),
-              _currentBlock(_start),
-              _current(std::move(*_bufferManager.get(_start))) {
-        readBlock(_currentBlock);
+            : _bufferManager(bufferManager), _end(end), _windowStart(start),
+              _windowSize(std::max<uint64_t>(1, std::min(CHECKPOINT_IO_BLOCKS, end - start))),
+              _window(_bufferManager.allocate(_windowSize)),
+              _pending(_bufferManager.allocate(_windowSize)) {}
+
+    ~BlockWriter() {
+        // The buffers must outlive a write in flight, even when abandoned.
+        if (_pendingWrite.valid()) {
+            _pendingWrite.wait();
+        }
     }
 
     void writeUint64(uint64_t data) {
-        if (_currentBlock >= _end)
-            throw OutOfSpaceException{};
-
         if (_currWrite >= _endWrite) {
-            _currentBlock++;
-            if (_currentBlock == _end)
-                throw OutOfSpaceException{};
-
-            readBlock(_currentBlock);
+            nextBlock();
         }
 
         *(_currWrite++) = data;
     }
 
+    // Write out everything written so far.  Writing resumes on a new block.
     void flush() {
-        _bufferManager.write(_current);
+        writeWindow();
+        waitPending();
+        _currWrite = _endWrite = nullptr;
+    }
+
+    // The first block after the data written so far.
+    uint64_t endBlock() const {
+        return _windowStart + _windowUsed;
     }
 
 private:
-    void readBlock(uint64_t blockNo) {
-        _bufferManager.write(_current);
-        _current = std::move(*_bufferManager.get(blockNo, true));
+    void nextBlock() {
+        if (_windowUsed == _windowSize) {
+            writeWindow();
+        }
 
-        _currWrite = static_cast<uint64_t *>(_current.getRaw());
-        _endWrite = _currWrite + (_current.size() / sizeof(uint64_t));
+        if (_windowStart + _windowUsed >= _end)
+            throw OutOfSpaceException{};
+
+        std::size_t blockSize = _bufferManager.getBlockSize();
+        char* block = static_cast<char*>(_window.getRaw()) + _windowUsed++ * blockSize;
+        std::memset(block, 0, blockSize);
+
+        _currWrite = reinterpret_cast<uint64_t *>(block);
+        _endWrite = _currWrite + (blockSize / sizeof(uint64_t));
+    }
+
+    // Start writing the filled blocks of the window, and continue in the
+    // other window.
+    void writeWindow() {
+        if (_windowUsed == 0)
+            return;
+
+        waitPending();
+        std::swap(_window, _pending);
+
+        uint64_t blockNum = _windowStart;
+        std::size_t count = _windowUsed;
+        _pendingWrite = _bufferManager.writeRangeAsync(blockNum, _pending, count);
+
+        _windowStart += count;
+        _windowUsed = 0;
+    }
+
+    void waitPending() {
+        if (_pendingWrite.valid()) {
+            invariant(_pendingWrite.get());
+        }
     }
 
     const BufferManager& _bufferManager;
-    uint64_t _start;
     uint64_t _end;
-    uint64_t _currentBlock;
 
-    Buffer _current;
+    // The block the window is written to, and the number of blocks of it
+    // filled so far.
+    uint64_t _windowStart;
+    std::size_t _windowUsed = 0;
+
+    // The number of blocks of a window.
+    std::size_t _windowSize;
+
+    // The window being filled, and the one being written.
+    Buffer _window;
+    Buffer _pending;
+    std::future<Status> _pendingWrite;
 
-    uint64_t* _currWrite;
-    uint64_t* _endWrite;
+    uint64_t* _currWrite = nullptr;
+    uint64_t* _endWrite = nullptr;
 };
 
-Status CheckpointManager::performCheckpoint(uint64_t generationNumber) {
+// Write the records of the active snapshot of 'memoryStore' to 'writer'.
+// Returns the number of records written.
+uint64_t writeSnapshot(MemoryStore& memoryStore, BlockWriter& writer) {
+    uint64_t recordCount = 0;
+    MemoryStore::SnapshotBatch batch;
+    while (!(batch = memoryStore.readSnapshot(CHECKPOINT_BATCH_SIZE)).empty()) {
+        for (const Node& node : batch.nodes) {
+            writer.writeUint64(node.getId());
+            auto edges = node.edges();
+            writer.writeUint64(edges.size());
+            for (const NodeId& edgeId : edges) {
+                writer.writeUint64(edgeId);
+            }
+        }
+
+        for (const NodeId& nodeId : batch.removed) {
+            writer.writeUint64(nodeId);
+            writer.writeUint64(REMOVED_NODE);
+        }
+
+        recordCount += batch.nodes.size() + batch.removed.size();
+    }
+
+    return recordCount;
+}
+
+// Write the 'nodeCount' nodes of the active full snapshot of 'memoryStore'
+// as the sections of a `CsrImage`.  Returns the number of edges written.
+uint64_t writeImage(MemoryStore& memoryStore, uint64_t nodeCount, BlockWriter& ids,
+                    BlockWriter& offsets, BlockWriter& neighbors) {
+    uint64_t nodesWritten = 0;
+    uint64_t edgeCount = 0;
+    NodeIdList edges;
+    MemoryStore::SnapshotBatch batch;
+    while (!(batch = memoryStore.readSnapshot(CHECKPOINT_BATCH_SIZE)).empty()) {
+        for (const Node& node : batch.nodes) {
+            ids.writeUint64(node.getId());
+            offsets.writeUint64(edgeCount);
+
+            // Edges are written in id order, so pages of them can be found
+            // by binary search.
+            edges.clear();
+            node.visitEdges([&](NodeId edgeId) { edges.push_back(edgeId); });
+            std::sort(edges.begin(), edges.end());
+            for (NodeId edgeId : edges) {
+                neighbors.writeUint64(edgeId);
+                edgeCount++;
+            }
+        }
+
+        nodesWritten += batch.nodes.size();
+    }
+
+    offsets.writeUint64(edgeCount);
+    invariant(nodesWritten == nodeCount);
+    return edgeCount;
+}
+
+Status CheckpointManager::performCheckpoint(uint64_t generationNumber, bool incremental) {
     invariant(_superblock);
     CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+    auto& memoryStore = _loggedStore->_memoryStore;
+
+    if (incremental) {
+        // Append a delta to the newest checkpoint.  The slot is only updated
+        // once the delta is completely written.
+        int latest = latestSlot();
+        invariant(latest != -1);
+        CheckpointSlot& slot = superblock->slots[latest];
+        invariant(slot.deltaCount < MAX_DELTA_CHECKPOINTS);
+
+        auto range = slotRange(latest);
+        if (slot.endBlock >= range.second) {
+            _forceFullCheckpoint = true;
+            return StatusCode::NO_SPACE;
+        }
+
+        BlockWriter writer(_bufferManager, slot.endBlock, range.second);
+        uint64_t recordCount;
+        try {
+            recordCount = writeSnapshot(memoryStore, writer);
+        } catch (const BlockWriter::OutOfSpaceException&) {
+            _forceFullCheckpoint = true;
+            return StatusCode::NO_SPACE;
+        }
+
+        writer.flush();
+        _bufferManager.sync();
+
+        slot.deltas[slot.deltaCount] = {generationNumber, recordCount, slot.endBlock};
+        slot.deltaCount++;
+        slot.endBlock = writer.endBlock();
+        slot.checkpointVersion = generationNumber;
+        _bufferManager.write(*_superblock);
+        _bufferManager.sync();
+
+        return StatusCode::SUCCESS;
+    }
+
+    int latest = latestSlot();
+    int target = latest == -1 ? 0 : 1 - latest;
+    CheckpointSlot& slot = superblock->slots[target];
+
+    // The store may still be serving nodes from the image about to be
+    // overwritten.
+    if (target == _baseImageSlot) {
+        memoryStore.releaseBaseImage();
+        _baseImageSlot = -1;
+    }
 
     // Update superblock.
-    superblock->checkpointVersion = generationNumber;
-    superblock->checkpointed = false;
-    superblock->nodeCount = _loggedStore->_memoryStore._nodes.size();
+    slot.checkpointVersion = generationNumber;
+    slot.checkpointed = false;
+    slot.nodeCount = 0;
+    slot.edgeCount = 0;
+    slot.deltaCount = 0;
     _bufferManager.write(*_superblock);
+    _bufferManager.sync();
+
+    // The sizes of the ids and offsets sections follow from the number of
+    // nodes, so all three sections are written at once.
+    uint64_t nodeCount = memoryStore.getSnapshotNodeCount();
+    auto layout = CsrImage::getLayout(nodeCount, 0, _bufferManager.getBlockSize());
+    auto range = slotRange(target);
+    if (range.first + layout.blockCount > range.second) {
+        return StatusCode::NO_SPACE;
+    }
 
-    // Write out node by node checkpoints.
-    auto nodeIterator = _loggedStore->_memoryStore._nodes.begin();
-    BlockWriter writer(_bufferManager, _checkpointBlockMin + 1, _checkpointBlockMax);
+    BlockWriter idsWriter(_bufferManager, range.first,
+                          range.first + layout.offsetsBlock);
+    BlockWriter offsetsWriter(_bufferManager, range.first + layout.offsetsBlock,
+                              range.first + layout.neighborsBlock);
+    BlockWriter neighborsWriter(_bufferManager, range.first + layout.neighborsBlock,
+                                range.second);
+    uint64_t edgeCount;
     try {
-        while (nodeIterator != _loggedStore->_memoryStore._nodes.end()) {
-            writer.writeUint64(nodeIterator->first);
-            auto edges = nodeIterator->second->edges();
-            writer.writeUint64(edges.size());
-            for (const NodeId& edgeId : nodeIterator->second->edges()) {
-                writer.writeUint64(edgeId);
-            }
-
-            nodeIterator++;
-        }
+        edgeCount = writeImage(memoryStore, nodeCount, idsWriter, offsetsWriter,
+                               neighborsWriter);
     } catch (const BlockWriter::OutOfSpaceException&) {
         return StatusCode::NO_SPACE;
     }
 
-    writer.flush();
+    idsWriter.flush();
+    offsetsWriter.flush();
+    neighborsWriter.flush();
+    _bufferManager.sync();
 
-    superblock->checkpointed = true;
+    slot.nodeCount = nodeCount;
+    slot.edgeCount = edgeCount;
+    slot.endBlock = range.first + CsrImage::getLayout(
+        nodeCount, edgeCount, _bufferManager.getBlockSize()).blockCount;
+    slot.checkpointed = true;
     _bufferManager.write(*_superblock);
+    _bufferManager.sync();
 
+    _forceFullCheckpoint = false;
     return StatusCode::SUCCESS;
 }
 
+/**
+ * Streams data from consecutive blocks.  Blocks are read a contiguous window
+ * of CHECKPOINT_IO_BLOCKS at a time, with the next window read ahead in the
+ * background.
+ */
 class BlockReader {
 public:
     BlockReader(const BufferManager& bufferManager, uint64_t start, uint64_t end)
-            : _bufferManager(bufferManager), _start(start), _end(end),
-              _currentBlock(_start),
-              _current(std::move(*_bufferManager.get(_start))) {
-        readBlock(_currentBlock);
+            : _bufferManager(bufferManager), _end(end), _nextBlock(start),
+              _windowSize(std::max<uint64_t>(1, std::min(CHECKPOINT_IO_BLOCKS, end - start))),
+              _window(_bufferManager.allocate(_windowSize)),
+              _pending(_bufferManager.allocate(_windowSize)) {
+        readAhead();
     }
 
-    uint64_t readUint64() {
-        invariant(_currentBlock < _end);
+    ~BlockReader() {
+        if (_pendingRead.valid()) {
+            _pendingRead.wait();
+        }
+    }
 
+    uint64_t readUint64() {
         if (_currRead >= _endRead) {
-            _currentBlock++;
-            readBlock(_currentBlock);
+            nextBlock();
         }
 
         return *(_currRead++);
     }
 
 private:
-    void readBlock(uint64_t blockNo) {
-        _current = std::move(*_bufferManager.get(blockNo));
+    void nextBlock() {
+        if (_windowPos == _windowCount) {
+            invariant(_pendingRead.valid());
+            invariant(_pendingRead.get());
+            _windowCount = _pendingCount;
+            _windowPos = 0;
+            std::swap(_window, _pending);
+            readAhead();
+        }
 
-        _currRead = static_cast<uint64_t *>(_current.getRaw());
-        _endRead = _currRead + (_current.size() / sizeof(uint64_t));
+        std::size_t blockSize = _bufferManager.getBlockSize();
+        char* block = static_cast<char*>(_window.getRaw()) + _windowPos++ * blockSize;
+        _currRead = reinterpret_cast<uint64_t *>(block);
+        _endRead = _currRead + (blockSize / sizeof(uint64_t));
+    }
+
+    // Start reading the window after the last one read.
+    void readAhead() {
+        std::size_t count = std::min<uint64_t>(_windowSize, _end - _nextBlock);
+        if (count == 0)
+            return;
+
+        _pendingRead = _bufferManager.readRangeAsync(_nextBlock, _pending, count);
+        _pendingCount = count;
+        _nextBlock += count;
     }
 
     const BufferManager& _bufferManager;
-    uint64_t _start;
     uint64_t _end;
-    uint64_t _currentBlock;
 
-    Buffer _current;
+    // The first block not yet read.
+    uint64_t _nextBlock;
 
-    uint64_t* _currRead;
-    uint64_t* _endRead;
-};
+    // The number of blocks in the window, and the position in it.
+    std::size_t _windowCount = 0;
+    std::size_t _windowPos = 0;
 
-void CheckpointManager::restoreCheckpoint(uint64_t generationNumber) {
-    invariant(_superblock);
-    CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+    // The number of blocks of a window.
+    std::size_t _windowSize;
 
-    // Update superblock.
-    if (superblock->checkpointVersion != generationNumber)
-        return;
+    // The window being read from, and the one being read ahead.
+    Buffer _window;
+    Buffer _pending;
+    std::future<Status> _pendingRead;
+    std::size_t _pendingCount = 0;
 
-    // Write out node by node checkpoints.
-    auto& memoryStore = _loggedStore->_memoryStore;
-    auto nodesRemaining = superblock->nodeCount;
+    uint64_t* _currRead = nullptr;
+    uint64_t* _endRead = nullptr;
+};
 
-    BlockReader reader(_bufferManager, _checkpointBlockMin + 1,
-                       _checkpointBlockMax);
-    while (nodesRemaining--) {
+// Apply 'recordCount' node records read from 'reader' to 'memoryStore'.
+void restoreRecords(MemoryStore& memoryStore, BlockReader& reader,
+                    uint64_t recordCount) {
+    while (recordCount--) {
         uint64_t nodeId = reader.readUint64();
         uint64_t edgeCounts = reader.readUint64();
+        if (edgeCounts == REMOVED_NODE) {
+            memoryStore.removeNode(nodeId);
+            continue;
+        }
+
         memoryStore.addNode(nodeId);
         Node *node = *memoryStore.findNode(nodeId);
 
+        // A node record replaces the edges of an earlier one.  Its neighbors
+        // have records of their own.
+        for (const NodeId& edgeId : node->edges()) {
+            node->removeEdge(edgeId);
+        }
+
         // Read edges
         while (edgeCounts--) {
             uint64_t edgeId = reader.readUint64();
@@ -206,3 +536,60 @@ void CheckpointManager::restoreCheckpoint(uint64_t generationNumber) {
         }
     }
 }
+
+// Map the base image of 'nodeCount' nodes and 'edgeCount' edges starting at
+// 'startBlock', or read it into memory if the device can not be mapped.
+std::unique_ptr<CsrImage> loadImage(const BufferManager& bufferManager, uint64_t startBlock,
+                                    uint64_t nodeCount, uint64_t edgeCount) {
+    uint64_t blockSize = bufferManager.getBlockSize();
+    auto layout = CsrImage::getLayout(nodeCount, edgeCount, blockSize);
+
+    auto status_with_mapping = bufferManager.map(startBlock, layout.blockCount);
+    if (status_with_mapping) {
+        return stdx::make_unique<CsrImage>(std::move(*status_with_mapping), nodeCount,
+                                           blockSize);
+    }
+
+    std::vector<uint64_t> data(layout.blockCount * blockSize / sizeof(uint64_t));
+    BlockReader reader(bufferManager, startBlock, startBlock + layout.blockCount);
+    for (uint64_t& word : data) {
+        word = reader.readUint64();
+    }
+
+    return stdx::make_unique<CsrImage>(std::move(data), nodeCount, blockSize);
+}
+
+void CheckpointManager::restoreCheckpoint(uint64_t generationNumber) {
+    invariant(_superblock);
+    CheckpointSuperBlock* superblock = static_cast<CheckpointSuperBlock*>(_superblock->getRaw());
+
+    int slotIndex = -1;
+    for (int i = 0; i < 2; i++) {
+        if (superblock->slots[i].checkpointed &&
+                superblock->slots[i].checkpointVersion == generationNumber) {
+            slotIndex = i;
+        }
+    }
+
+    if (slotIndex == -1)
+        return;
+
+    auto& memoryStore = _loggedStore->_memoryStore;
+    const CheckpointSlot& slot = superblock->slots[slotIndex];
+    auto range = slotRange(slotIndex);
+
+    // Nodes are served from the base image, and only copied into memory as
+    // they are modified.
+    memoryStore.setBaseImage(loadImage(_bufferManager, range.first, slot.nodeCount,
+                                       slot.edgeCount));
+    _baseImageSlot = slotIndex;
+
+    for (uint64_t i = 0; i < slot.deltaCount; i++) {
+        const DeltaCheckpoint& delta = slot.deltas[i];
+        BlockReader reader(_bufferManager, delta.startBlock, range.second);
+        restoreRecords(memoryStore, reader, delta.recordCount);
+    }
+
+    // The restored state is already on disk.
+    memoryStore.clearDirtyNodes();
+}
@@ -31,20 +31,50 @@ public:
      */
     bool hasCheckpoint(uint64_t generationNumber);
 
+    /**
+     * Get the generation of the newest complete checkpoint.
+     *
+     * Returns: DOES_NOT_EXIST if no checkpoint has completed.
+     */
+    StatusWith<uint64_t> getLatestCheckpoint();
+
+    /**
+     * Check whether the next checkpoint must be a full one, rather than an
+     * incremental checkpoint of the nodes modified since the last one.
+     *
+     * Full checkpoints are taken periodically to compact the incremental
+     * ones into a new base image.
+     */
+    bool needsFullCheckpoint();
+
     /*
      * Perform a checkpoint of the store, with 'generationNumber'
+     *
+     * Writes out the active snapshot of the memory store, so the store
+     * does not need to be locked while the checkpoint is written.  A full
+     * checkpoint starts a new base image, and keeps the newest complete
+     * checkpoint intact until it completes.  An incremental checkpoint is
+     * appended to the newest complete checkpoint.
      */
-    Status performCheckpoint(uint64_t generationNumber);
+    Status performCheckpoint(uint64_t generationNumber, bool incremental);
 
     /*
      * Restore a checkpoing of the store, with 'generationNumber'.
      *
-     * Does nothing if the checkpoint on disk doesn't match
-     * the generation number.
+     * Maps the base image for the memory store to serve nodes from, and
+     * then applies each incremental checkpoint taken after it.  Does
+     * nothing if the checkpoint on disk doesn't match the generation number.
      */
     void restoreCheckpoint(uint64_t generationNumber);
 
 private:
+    // Get the index of the slot holding the newest complete checkpoint, or
+    // -1 if there is none.
+    int latestSlot() const;
+
+    // Get the block range of checkpoint slot 'slot'.
+    std::pair<uint64_t, uint64_t> slotRange(int slot) const;
+
     const BufferManager& _bufferManager;
     LoggedStore* _loggedStore = nullptr;
 
@@ -52,4 +82,12 @@ private:
 
     uint64_t _checkpointBlockMin;
     uint64_t _checkpointBlockMax;
+    // The number of blocks in each checkpoint slot.
+    uint64_t _slotSize;
+
+    // Set when an incremental checkpoint ran out of space.
+    bool _forceFullCheckpoint = false;
+    // The slot holding the base image the memory store serves nodes from, or
+    // -1 if there is none.
+    int _baseImageSlot = -1;
 };
@@ -0,0 +1,80 @@
+#include "db/csr_image.h"
+
+#include <algorithm>
+
+#include "util/stdx/memory.h"
+
+namespace {
+
+uint64_t blocksFor(uint64_t words, uint64_t blockSize) {
+    return (words * sizeof(uint64_t) + blockSize - 1) / blockSize;
+}
+
+} // namespace
+
+const std::size_t CsrImage::npos;
+
+CsrImage::Layout CsrImage::getLayout(uint64_t nodeCount, uint64_t edgeCount,
+                                     uint64_t blockSize) {
+    Layout layout;
+    layout.offsetsBlock = blocksFor(nodeCount, blockSize);
+    layout.neighborsBlock = layout.offsetsBlock + blocksFor(nodeCount + 1, blockSize);
+    layout.blockCount = layout.neighborsBlock + blocksFor(edgeCount, blockSize);
+    return layout;
+}
+
+CsrImage::CsrImage(Mapping mapping, uint64_t nodeCount, uint64_t blockSize)
+        : _mapping(stdx::make_unique<Mapping>(std::move(mapping))),
+          _nodeCount(nodeCount) {
+    init(static_cast<const uint64_t*>(_mapping->getRaw()), blockSize);
+}
+
+CsrImage::CsrImage(std::vector<uint64_t> data, uint64_t nodeCount, uint64_t blockSize)
+        : _data(std::move(data)), _nodeCount(nodeCount) {
+    init(_data.data(), blockSize);
+}
+
+void CsrImage::init(const uint64_t* data, uint64_t blockSize) {
+    Layout layout = getLayout(_nodeCount, 0, blockSize);
+    uint64_t blockWords = blockSize / sizeof(uint64_t);
+
+    _ids = reinterpret_cast<const NodeId*>(data);
+    _offsets = data + layout.offsetsBlock * blockWords;
+    _neighbors = reinterpret_cast<const NodeId*>(data + layout.neighborsBlock * blockWords);
+}
+
+uint64_t CsrImage::getNodeCount() const {
+    return _nodeCount;
+}
+
+std::size_t CsrImage::find(NodeId nodeId) const {
+    std::size_t index = lowerBound(nodeId);
+    if (index == _nodeCount || _ids[index] != nodeId) {
+        return npos;
+    }
+
+    return index;
+}
+
+std::size_t CsrImage::lowerBound(NodeId nodeId) const {
+    return std::lower_bound(_ids, _ids + _nodeCount, nodeId) - _ids;
+}
+
+NodeId CsrImage::getNodeId(std::size_t index) const {
+    return _ids[index];
+}
+
+std::pair<const NodeId*, const NodeId*> CsrImage::getEdges(std::size_t index) const {
+    return {_neighbors + _offsets[index], _neighbors + _offsets[index + 1]};
+}
+
+std::unique_ptr<Node> CsrImage::buildNode(std::size_t index) const {
+    auto node = stdx::make_unique<Node>(_ids[index]);
+    auto edges = getEdges(index);
+    node->reserveEdges(edges.second - edges.first);
+    for (const NodeId* edge = edges.first; edge != edges.second; edge++) {
+        node->addEdge(*edge);
+    }
+
+    return node;
+}
@@ -0,0 +1,93 @@
+/**
+ * csr_image.h: A read-only graph image in compressed sparse row layout.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "db/types.h"
+#include "io/mapping.h"
+#include "util/nocopy.h"
+
+/**
+ * An immutable graph, laid out as three block-aligned sections:
+ *
+ *  - ids: the sorted ids of the 'nodeCount' nodes.
+ *  - offsets: 'nodeCount' + 1 indexes into the neighbors section, where the
+ *    edges of each node start, followed by the total number of edges.
+ *  - neighbors: the edges of each node, in the order of the ids section,
+ *    and in id order within a node.
+ *
+ * The image is either mapped from the device, or read into memory.
+ */
+class CsrImage {
+    DISALLOW_COPY(CsrImage);
+public:
+    /**
+     * The block offsets of the sections of an image, relative to its start.
+     */
+    struct Layout {
+        uint64_t offsetsBlock;
+        uint64_t neighborsBlock;
+        // The number of blocks of the whole image.
+        uint64_t blockCount;
+    };
+
+    static const std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    /**
+     * Get the layout of an image of 'nodeCount' nodes and 'edgeCount' edges.
+     */
+    static Layout getLayout(uint64_t nodeCount, uint64_t edgeCount, uint64_t blockSize);
+
+    /**
+     * View an image in 'mapping'.
+     */
+    CsrImage(Mapping mapping, uint64_t nodeCount, uint64_t blockSize);
+
+    /**
+     * View an image read into 'data'.
+     */
+    CsrImage(std::vector<uint64_t> data, uint64_t nodeCount, uint64_t blockSize);
+
+    uint64_t getNodeCount() const;
+
+    /**
+     * Get the index of 'nodeId', or npos if it is not in the image.
+     */
+    std::size_t find(NodeId nodeId) const;
+
+    /**
+     * Get the index of the first node with an id not less than 'nodeId'.
+     */
+    std::size_t lowerBound(NodeId nodeId) const;
+
+    NodeId getNodeId(std::size_t index) const;
+
+    /**
+     * Get the range of edges of the node at 'index'.
+     */
+    std::pair<const NodeId*, const NodeId*> getEdges(std::size_t index) const;
+
+    /**
+     * Build a heap node of the node at 'index'.
+     */
+    std::unique_ptr<Node> buildNode(std::size_t index) const;
+
+private:
+    void init(const uint64_t* data, uint64_t blockSize);
+
+    std::unique_ptr<Mapping> _mapping;
+    std::vector<uint64_t> _data;
+
+    const uint64_t _nodeCount;
+    const NodeId* _ids;
+    const uint64_t* _offsets;
+    const NodeId* _neighbors;
+};
@@ -5,23 +5,65 @@
 #pragma once
 
 #include <map>
+#include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "db/types.h"
+#include "util/cancellation.h"
 #include "util/status.h"
 
+/**
+ * How durable a write must be before it is acknowledged.
+ */
+enum class Durability {
+    // Synced to disk by the writer.
+    SYNC,
+    // Synced to disk by a group commit shared with concurrent writes.
+    GROUP,
+    // Applied in memory, and synced within a bounded flush interval.
+    ASYNC
+};
+
+/**
+ * One operation of a batch.  Node operations only use 'nodeAId'.
+ */
+struct BatchOperation {
+    enum class Type {
+        ADD_NODE,
+        REMOVE_NODE,
+        GET_NODE,
+        ADD_EDGE,
+        REMOVE_EDGE,
+        GET_EDGE
+    };
+
+    BatchOperation(Type type, NodeId nodeAId, NodeId nodeBId = 0)
+        : type(type), nodeAId(nodeAId), nodeBId(nodeBId) {}
+
+    Type type;
+    NodeId nodeAId;
+    NodeId nodeBId;
+};
+
+/**
+ * The writes of a graph store take the durability to acknowledge them at.
+ * Stores without durability ignore it.
+ */
 class GraphStore {
 public:
     /**
      * Add a node with id `node_id` to the store.
      */
-    virtual Status addNode(NodeId nodeId) = 0;
+    virtual Status addNode(NodeId nodeId,
+                           Durability durability = Durability::SYNC) = 0;
 
     /**
      * Remove a node from the store.
      */
-    virtual Status removeNode(NodeId nodeId) = 0;
+    virtual Status removeNode(NodeId nodeId,
+                              Durability durability = Durability::SYNC) = 0;
 
     /**
      * Find a node in the store.
@@ -37,12 +79,14 @@ public:
     /**
      * Adds an edge between `nodeAId` and `nodeBId`.
      */
-    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId) = 0;
+    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId,
+                           Durability durability = Durability::SYNC) = 0;
 
     /**
      * Remove an edge between 'nodeAId' and 'nodeBId'.
      */
-    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId) = 0;
+    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId,
+                              Durability durability = Durability::SYNC) = 0;
 
     // An edge part is a one-way edge between two nodes.
 
@@ -54,26 +98,59 @@ public:
     /**
      * Adds an edge part between `nodeLocalId` and `nodeRemoteId`.
      */
-    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) = 0;
+    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                               Durability durability = Durability::SYNC) = 0;
 
     /**
      * Remove an edge part between 'nodeLocalId' and 'nodeRemoteId'.
      *
      * Precondition: 'nodeLocalId' is on this partition.
      */
-    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) = 0;
+    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                                  Durability durability = Durability::SYNC) = 0;
 
     /**
      * Find the neighbors of 'nodeId'.
      */
     virtual StatusWith<NodeIdList> getNeighbors(NodeId nodeId) const = 0;
 
+    /**
+     * Find the number of neighbors of 'nodeId', without listing them.
+     */
+    virtual StatusWith<uint64_t> getDegree(NodeId nodeId) const = 0;
+
+    /**
+     * Find the up to 'limit' lowest neighbors of 'nodeId' with ids of at
+     * least 'from', in id order.
+     */
+    virtual StatusWith<NodeIdList> getNeighborPage(NodeId nodeId, NodeId from,
+                                                   std::size_t limit) const = 0;
+
+    /**
+     * Call 'visit' with each neighbor of 'nodeId', in the order
+     * 'getNeighbors' lists them, without listing them first.  The store is
+     * locked throughout, so 'visit' may not call into it.
+     */
+    virtual Status visitNeighbors(NodeId nodeId,
+                                  const std::function<void(NodeId)>& visit) const = 0;
+
     /**
      * Find the length of the shortest path between 'nodeAId' and 'nodeBId'.
      *
      * Note, since there is no maximum distance, this implementation is
-     * unbounded in its time and memory usage.
+     * unbounded in its time and memory usage.  It stops early with
+     * CANCELLED once 'cancellation' is set and cancelled.
+     */
+    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                              const Cancellation* cancellation = nullptr) const = 0;
+
+    /**
+     * Apply 'operations' in order, without other operations interleaved.
+     * The writes are acknowledged together, at 'durability'.
+     *
+     * Returns: The status of each operation, as its single operation would
+     * return it.  A get succeeds if the node or edge exists.
      */
-    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId,
-                                              NodeId nodeBId) const = 0;
+    virtual std::vector<Status> applyBatch(const std::vector<BatchOperation>& operations,
+                                           Durability durability = Durability::SYNC) = 0;
 };
@@ -0,0 +1,76 @@
+#include "db/group_commit.h"
+
+GroupCommit::GroupCommit(const BufferManager& device,
+                         std::chrono::milliseconds flushInterval)
+        : _device(device), _flushInterval(flushInterval) {
+    _flusher = std::thread(&GroupCommit::run, this);
+}
+
+GroupCommit::~GroupCommit() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _requested.notify_one();
+    _flusher.join();
+}
+
+uint64_t GroupCommit::appended() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return ++_appended;
+}
+
+void GroupCommit::wait(uint64_t sequence, Durability durability) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (durability == Durability::ASYNC || sequence <= _durable) {
+        return;
+    }
+
+    if (durability == Durability::SYNC) {
+        flush(lock);
+        return;
+    }
+
+    _waiting++;
+    _requested.notify_one();
+    _flushed.wait(lock, [this, sequence] { return sequence <= _durable; });
+    _waiting--;
+}
+
+GroupCommit::Stats GroupCommit::getStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return {_appended, _durable, _syncs};
+}
+
+void GroupCommit::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping) {
+        // Waiters stay counted until they wake, so only flush for them
+        // while some of their writes are not yet durable.
+        _requested.wait_for(lock, _flushInterval, [this] {
+            return _stopping || (_waiting > 0 && _appended > _durable);
+        });
+
+        if (_appended > _durable) {
+            flush(lock);
+        }
+    }
+
+    if (_appended > _durable) {
+        flush(lock);
+    }
+}
+
+void GroupCommit::flush(std::unique_lock<std::mutex>& lock) {
+    // Writes appended while syncing are left to the next flush.
+    uint64_t target = _appended;
+    lock.unlock();
+    _device.sync();
+    lock.lock();
+
+    _syncs++;
+    if (target > _durable) {
+        _durable = target;
+        _flushed.notify_all();
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "db/graph_store.h"
+#include "io/buffer_manager.h"
+#include "util/nocopy.h"
+
+/**
+ * Makes appended log writes durable, at the durability each write asks for.
+ *
+ * Writes are numbered as they are appended.  A background thread syncs the
+ * log device on behalf of every write waiting for a group commit, and at
+ * least every flush interval while writes are pending, which bounds the
+ * writes lost by asynchronous acknowledgement.
+ *
+ * Thread-safe.
+ */
+class GroupCommit {
+    DISALLOW_COPY(GroupCommit);
+public:
+    struct Stats {
+        uint64_t appended;
+        uint64_t durable;
+        uint64_t syncs;
+    };
+
+    GroupCommit(const BufferManager& device, std::chrono::milliseconds flushInterval);
+
+    // Syncs the writes still pending.
+    ~GroupCommit();
+
+    /**
+     * Record that a write has been appended to the log.  Called in log
+     * order, once the write has been issued.
+     *
+     * Returns: The sequence number of the write.
+     */
+    uint64_t appended();
+
+    /**
+     * Wait until write 'sequence' is as durable as 'durability' requires.
+     */
+    void wait(uint64_t sequence, Durability durability);
+
+    /**
+     * Get the number of writes appended and made durable so far, and of
+     * the syncs which made them durable.
+     */
+    Stats getStats() const;
+
+private:
+    // Run the background flushes until stopped.
+    void run();
+
+    // Sync the device, and mark the writes appended before as durable.
+    // Called with 'lock' held, and releases it while syncing.
+    void flush(std::unique_lock<std::mutex>& lock);
+
+    const BufferManager& _device;
+    const std::chrono::milliseconds _flushInterval;
+
+    mutable std::mutex _mutex;
+    // Signals the flusher that a group commit is awaited, or to stop.
+    std::condition_variable _requested;
+    // Signals waiters that more writes are durable.
+    std::condition_variable _flushed;
+
+    uint64_t _appended = 0;
+    uint64_t _durable = 0;
+    uint64_t _syncs = 0;
+    // The number of writes waiting for a group commit.
+    std::size_t _waiting = 0;
+    bool _stopping = false;
+
+    std::thread _flusher;
+};
@@ -0,0 +1,72 @@
+#include "util/testing.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "db/group_commit.h"
+#include "io/buffer_manager.h"
+
+TEST(GroupCommitLevels) {
+    const char* path = "/tmp/group_commit_test_file";
+    unlink(path);
+
+    BufferManager::Options options;
+    options.syncPolicy = BufferManager::SyncPolicy::BATCHED;
+    options.fileBlocks = 16;
+    BufferManager device(path, options);
+
+    {
+        GroupCommit commit(device, std::chrono::milliseconds(200));
+
+        // Synchronous writes are durable when they return.
+        uint64_t sequence = commit.appended();
+        commit.wait(sequence, Durability::SYNC);
+        EXPECT_TRUE(commit.getStats().durable >= sequence);
+        EXPECT_EQ(commit.getStats().syncs, 1);
+
+        // Asynchronous ones return at once, and are synced within the flush
+        // interval.
+        auto start = std::chrono::steady_clock::now();
+        sequence = commit.appended();
+        commit.wait(sequence, Durability::ASYNC);
+        EXPECT_TRUE(commit.getStats().durable < sequence);
+        EXPECT_EQ(commit.getStats().syncs, 1);
+
+        while (commit.getStats().durable < sequence) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        EXPECT_TRUE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(300));
+
+        // Concurrent writers share syncs.
+        uint64_t syncs = commit.getStats().syncs;
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 8; i++) {
+            writers.emplace_back([&commit] {
+                for (int j = 0; j < 100; j++) {
+                    uint64_t sequence = commit.appended();
+                    commit.wait(sequence, Durability::GROUP);
+                    EXPECT_TRUE(commit.getStats().durable >= sequence);
+                }
+            });
+        }
+
+        for (auto& writer : writers) {
+            writer.join();
+        }
+
+        auto stats = commit.getStats();
+        EXPECT_EQ(stats.durable, stats.appended);
+        EXPECT_TRUE(stats.syncs - syncs < 800);
+    }
+
+    unlink(path);
+
+    END;
+}
+
+int main() {
+    GroupCommitLevels();
+}
@@ -1,5 +1,7 @@
 #include "db/log_manager.h"
 
+#include <algorithm>
+
 #include "platform_params.h"
 #include "util/stdx/memory.h"
 
@@ -29,6 +31,8 @@ struct SuperBlock {
     uint32_t generation;
     uint32_t logSegmentStart; // First valid log block of this generation.
     uint32_t logSegmentSize; // Number of blocks in the log.
+    uint32_t previousSegmentStart; // First log block of the previous generation.
+    uint32_t previousSegmentSize; // Zero once the previous generation is released.
     bool __END;
 
     // Call when initializing a new superblock.
@@ -37,6 +41,8 @@ struct SuperBlock {
         generation = 0;
         logSegmentStart = superblockAddress + 1;
         logSegmentSize = 0;
+        previousSegmentStart = 0;
+        previousSegmentSize = 0;
     }
 
     bool valid() const {
@@ -78,12 +84,17 @@ struct LogBlock {
     }
 };
 
+// The number of blocks read at once by a log reader.
+constexpr uint64_t LOG_READ_BLOCKS = 256;
+
 LogManager::LogManager(const BufferManager& manager,
                        std::pair<std::size_t, std::size_t> blockRange) :
         _bufferManager(manager), _logMinBlock(blockRange.first),
-        _logMaxBlock(blockRange.second) {
-    invariant(_logMaxBlock < manager.getDeviceSize());
+        _logMaxBlock(blockRange.second),
+        _logBlockCount(_logMaxBlock - _logMinBlock - 1) {
+    invariant(_logMaxBlock <= manager.getDeviceSize());
     invariant(_logMaxBlock > _logMinBlock);
+    invariant(_logBlockCount > 1);
 }
 
 void LogManager::init() {
@@ -95,7 +106,7 @@ void LogManager::init() {
     invariant(superblock->valid());
 
     auto status_with_current_buffer = _bufferManager.get(
-            superblock->logSegmentStart + superblock->logSegmentSize - 1);
+            blockAt(superblock->logSegmentStart, superblock->logSegmentSize - 1));
     invariant(status_with_current_buffer);
     _currentBlock = stdx::make_unique<Buffer>(std::move(*status_with_current_buffer));
 
@@ -115,118 +126,248 @@ void LogManager::format() {
         _bufferManager.write(*_superblock);
     }
 
+    releasePreviousGeneration();
     increaseGeneration();
+    releasePreviousGeneration();
 }
 
 Status LogManager::logOperation(LogManager::Entry entry) {
+    if (logOperations(&entry, 1) == 0) {
+        return StatusCode::NO_SPACE;
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+std::size_t LogManager::logOperations(const Entry* entries, std::size_t count) {
+    SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
     LogBlock *logBlock = static_cast<LogBlock*>(_currentBlock->getRaw());
 
-    // Block is full.
-    if (logBlock->nEntries == LOG_BLOCK_ENTRY_COUNT) {
-        // Create new block.
-        SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    std::size_t logged = 0;
+    while (logged < count && logBlock->nEntries < LOG_BLOCK_ENTRY_COUNT) {
+        logBlock->entries[logBlock->nEntries++] = entries[logged++];
+    }
+
+    if (logged > 0) {
+        logBlock->prewrite();
+        _bufferManager.write(*_currentBlock);
+    }
+
+    // The rest go into new blocks.
+    std::size_t newBlocks = 0;
+    while (logged < count) {
+        // One block is kept free for the first block of the next generation.
+        if (getUsedBlocks() + newBlocks + 1 >= _logBlockCount) {
+            break;
+        }
+
+        std::size_t newBlock = blockAt(superblock->logSegmentStart,
+                                       superblock->logSegmentSize + newBlocks);
 
-        auto status_with_new_block = _bufferManager.get(
-               superblock->logSegmentStart + superblock->logSegmentSize);
+        auto status_with_new_block = _bufferManager.get(newBlock);
         if (!status_with_new_block) {
-            return status_with_new_block;
+            break;
         }
 
         _currentBlock = stdx::make_unique<Buffer>(std::move(*status_with_new_block));
         logBlock = static_cast<LogBlock*>(_currentBlock->getRaw());
         logBlock->init(superblock->generation);
 
-        superblock->logSegmentSize++;
+        while (logged < count && logBlock->nEntries < LOG_BLOCK_ENTRY_COUNT) {
+            logBlock->entries[logBlock->nEntries++] = entries[logged++];
+        }
+
+        logBlock->prewrite();
+        _bufferManager.write(*_currentBlock);
+        newBlocks++;
+    }
+
+    if (newBlocks > 0) {
+        // Write the blocks before the superblock references them.
+        _bufferManager.sync();
+
+        superblock->logSegmentSize += newBlocks;
         superblock->prewrite();
         _bufferManager.write(*_superblock);
     }
 
-    logBlock->entries[logBlock->nEntries++] = entry;
-    logBlock->prewrite();
-    _bufferManager.write(*_currentBlock);
-
-    return StatusCode::SUCCESS;
+    return logged;
 }
 
 uint64_t LogManager::increaseGeneration() {
     SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    invariant(!hasPreviousGeneration());
 
-    superblock->generation++;
-    superblock->logSegmentStart = _logMinBlock + 1;
-    superblock->logSegmentSize = 1;
+    uint64_t generation = superblock->generation + 1;
+    std::size_t segmentStart = blockAt(superblock->logSegmentStart, superblock->logSegmentSize);
 
-    superblock->prewrite();
-    _bufferManager.write(*_superblock);
-
-    auto status_with_buffer = _bufferManager.get(
-            superblock->logSegmentStart);
+    // Write the first block of the new generation before the superblock
+    // references it.
+    auto status_with_buffer = _bufferManager.get(segmentStart);
     invariant(status_with_buffer);
     _currentBlock = stdx::make_unique<Buffer>(std::move(*status_with_buffer));
 
     LogBlock *logBlock = static_cast<LogBlock*>(_currentBlock->getRaw());
-    logBlock->init(superblock->generation);
+    logBlock->init(generation);
     logBlock->prewrite();
 
     _bufferManager.write(*_currentBlock);
+    _bufferManager.sync();
+
+    superblock->previousSegmentStart = superblock->logSegmentStart;
+    superblock->previousSegmentSize = superblock->logSegmentSize;
+    superblock->generation = generation;
+    superblock->logSegmentStart = segmentStart;
+    superblock->logSegmentSize = 1;
+
+    superblock->prewrite();
+    _bufferManager.write(*_superblock);
+    _bufferManager.sync();
 
     return superblock->generation;
 }
 
+void LogManager::releasePreviousGeneration() {
+    SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    if (!hasPreviousGeneration()) {
+        return;
+    }
+
+    superblock->previousSegmentStart = 0;
+    superblock->previousSegmentSize = 0;
+
+    superblock->prewrite();
+    _bufferManager.write(*_superblock);
+}
+
+bool LogManager::hasPreviousGeneration() const {
+    SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    return superblock->previousSegmentSize > 0;
+}
+
+bool LogManager::hasGeneration(uint64_t generation) const {
+    uint64_t current = getGeneration();
+    return generation == current ||
+        (generation + 1 == current && hasPreviousGeneration());
+}
+
 uint64_t LogManager::getGeneration() const {
     SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
     return superblock->generation;
 }
 
-LogManager::Reader::Reader(LogManager& logManager) : _logManager(logManager) {
-    SuperBlock *superblock = static_cast<SuperBlock*>(_logManager._superblock->getRaw());
-    _startBlock = superblock->logSegmentStart;
-    _endBlock = _startBlock + superblock->logSegmentSize;
-    _generation = superblock->generation;
-    _blockNum = _startBlock;
-
-    if (_startBlock < _endBlock) {
-        auto status_with_buffer = _logManager._bufferManager.get(_startBlock);
-        invariant(status_with_buffer);
-        _buffer = stdx::make_unique<Buffer>(std::move(*status_with_buffer));
-        invariant(static_cast<LogBlock*>(_buffer->getRaw())->valid());
+std::size_t LogManager::getUsedBlocks() const {
+    SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    return superblock->logSegmentSize + superblock->previousSegmentSize;
+}
+
+std::size_t LogManager::getCapacity() const {
+    return _logBlockCount;
+}
+
+std::size_t LogManager::blockAt(std::size_t segmentStart, std::size_t offset) const {
+    std::size_t firstBlock = _logMinBlock + 1;
+    return firstBlock + (segmentStart - firstBlock + offset) % _logBlockCount;
+}
+
+LogManager::Reader::Reader(LogManager& logManager, uint64_t startBlock,
+                           uint64_t blockCount, uint64_t generation)
+        : _logManager(logManager),
+          _startBlock(startBlock),
+          _endBlock(blockCount),
+          _blockNum(0),
+          _generation(generation),
+          _nextRead(0),
+          _windowSize(std::max<uint64_t>(1, std::min(LOG_READ_BLOCKS, blockCount))),
+          _window(logManager._bufferManager.allocate(_windowSize)),
+          _pending(logManager._bufferManager.allocate(_windowSize)) {
+    if (_endBlock > 0) {
+        readAhead();
+        nextBlock();
+    }
+}
+
+LogManager::Reader::~Reader() {
+    if (_pendingRead.valid()) {
+        _pendingRead.wait();
     }
 }
 
 bool LogManager::Reader::hasNext() const {
-    if (!_buffer)
+    if (!_block)
         return false;
 
     if (_blockNum < _endBlock - 1)
         return true;
 
-    LogBlock* logBlock = static_cast<LogBlock*>(_buffer->getRaw());
-    return _entryIndex < logBlock->nEntries;
+    return _entryIndex < _block->nEntries;
 }
 
 LogManager::Entry LogManager::Reader::getNext() {
-    invariant(_buffer);
-    LogBlock* logBlock = static_cast<LogBlock*>(_buffer->getRaw());
-    invariant(logBlock->valid());
+    invariant(_block);
 
     // At end of current buffer.
-    if (_entryIndex == logBlock->nEntries) {
+    if (_entryIndex == _block->nEntries) {
         _blockNum++;
-        _entryIndex = 0;
         invariant(_blockNum < _endBlock);
+        nextBlock();
+    }
+
+    invariant(_entryIndex < LOG_BLOCK_ENTRY_COUNT);
+    return _block->entries[_entryIndex++];
+}
 
-        auto status_with_next_buffer = _logManager._bufferManager.get(_blockNum);
-        invariant(status_with_next_buffer);
-        _buffer = stdx::make_unique<Buffer>(std::move(*status_with_next_buffer));
+LogManager::Reader::Batch LogManager::Reader::getBatch() {
+    if (!_block) {
+        return {nullptr, 0};
+    }
+
+    while (_entryIndex == _block->nEntries) {
+        if (_blockNum + 1 == _endBlock) {
+            return {nullptr, 0};
+        }
 
-        logBlock = static_cast<LogBlock*>(_buffer->getRaw());
-        invariant(logBlock->valid());
+        _blockNum++;
+        nextBlock();
     }
 
-    invariant(_entryIndex < LOG_BLOCK_ENTRY_COUNT);
-    LogManager::Entry entry = logBlock->entries[_entryIndex];
+    Batch batch = {&_block->entries[_entryIndex], _block->nEntries - _entryIndex};
+    _entryIndex = _block->nEntries;
+    return batch;
+}
+
+void LogManager::Reader::nextBlock() {
+    if (_windowPos == _windowCount) {
+        invariant(_pendingRead.valid());
+        invariant(_pendingRead.get());
+        std::swap(_window, _pending);
+        _windowCount = _pendingCount;
+        _windowPos = 0;
+        readAhead();
+    }
 
-    _entryIndex++;
-    return entry;
+    std::size_t blockSize = _logManager._bufferManager.getBlockSize();
+    _block = reinterpret_cast<const LogBlock*>(
+        static_cast<const char*>(_window.getRaw()) + _windowPos++ * blockSize);
+    _entryIndex = 0;
+
+    invariant(_block->valid());
+    invariant(_block->generation == _generation);
+    invariant(_block->nEntries <= LOG_BLOCK_ENTRY_COUNT);
+}
+
+void LogManager::Reader::readAhead() {
+    std::size_t count = std::min<uint64_t>(_windowSize, _endBlock - _nextRead);
+    if (count == 0)
+        return;
+
+    // A window stops where the log wraps around.
+    std::size_t blockNum = _logManager.blockAt(_startBlock, _nextRead);
+    count = std::min<uint64_t>(count, _logManager._logMaxBlock - blockNum);
+
+    _pendingRead = _logManager._bufferManager.readRangeAsync(blockNum, _pending, count);
+    _pendingCount = count;
+    _nextRead += count;
 }
 
 void LogManager::Reader::close() {
@@ -234,7 +375,21 @@ void LogManager::Reader::close() {
 }
 
 LogManager::Reader& LogManager::readLog() {
-    _reader.reset(new Reader(*this));
+    return readLog(getGeneration());
+}
+
+LogManager::Reader& LogManager::readLog(uint64_t generation) {
+    SuperBlock *superblock = static_cast<SuperBlock*>(_superblock->getRaw());
+    invariant(hasGeneration(generation));
+
+    if (generation == superblock->generation) {
+        _reader.reset(new Reader(*this, superblock->logSegmentStart,
+                                 superblock->logSegmentSize, generation));
+    } else {
+        _reader.reset(new Reader(*this, superblock->previousSegmentStart,
+                                 superblock->previousSegmentSize, generation));
+    }
+
     return *_reader;
 }
 
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <ostream>
 
@@ -9,9 +10,16 @@
 #include "io/buffer.h"
 #include "util/status.h"
 
+struct LogBlock;
+
 /**
  * Manages the on-disk log.
  *
+ * The log blocks form a circular buffer.  Each generation follows on from the
+ * end of the one before it, and the blocks of a generation are reclaimed once
+ * it is released, so checkpoints free log space as they go rather than the
+ * log restarting from a fixed position.
+ *
  * Not thread-safe.
  */
 class LogManager {
@@ -45,25 +53,74 @@ public:
 
     /**
      * Used to read the log sequentially.
+     *
+     * Blocks are read a contiguous window at a time, with the next window
+     * read ahead in the background, and each block is validated once.
      */
     class Reader {
     public:
+        /**
+         * A run of consecutive entries of the log.  Valid until the reader
+         * is advanced or closed.
+         */
+        struct Batch {
+            const Entry* entries;
+            std::size_t count;
+        };
+
+        ~Reader();
+
         Entry getNext();
         bool hasNext() const;
+
+        /**
+         * Get the entries up to the end of the current block, or of the next
+         * one if the current block has been read.
+         *
+         * Returns: A batch of entries, which is empty at the end of the log.
+         */
+        Batch getBatch();
+
         void close();
 
         friend class LogManager;
     private:
-        Reader(LogManager& logManager);
+        Reader(LogManager& logManager, uint64_t startBlock, uint64_t blockCount,
+               uint64_t generation);
+
+        // Move to the next block, waiting for its window if needed.
+        void nextBlock();
+
+        // Start reading the window after the last one read.
+        void readAhead();
 
         LogManager& _logManager;
-        std::unique_ptr<Buffer> _buffer = nullptr;
 
+        // The first block of the generation.  The positions below count
+        // blocks from it, since the generation may wrap around the log.
         uint64_t _startBlock;
         uint64_t _endBlock;
         uint64_t _blockNum;
         uint64_t _generation;
         uint32_t _entryIndex = 0;
+
+        // The first block not yet read.
+        uint64_t _nextRead;
+
+        // The number of blocks in a window, in the current window, and the
+        // position of the next block in it.
+        std::size_t _windowSize;
+        std::size_t _windowCount = 0;
+        std::size_t _windowPos = 0;
+
+        // The window being read from, and the one being read ahead.
+        Buffer _window;
+        Buffer _pending;
+        std::future<Status> _pendingRead;
+        std::size_t _pendingCount = 0;
+
+        // The current block, or null if the log is empty.
+        const LogBlock* _block = nullptr;
     };
 
     /**
@@ -92,18 +149,59 @@ public:
      */
     Status logOperation(Entry entry);
 
+    /**
+     * Add the `count` operations of 'entries' to the end of the log, in
+     * order.  Each block they touch is written once, and the superblock at
+     * most once.
+     *
+     * Returns: The number of operations added, which is less than `count`
+     * only if the log filled up.
+     */
+    std::size_t logOperations(const Entry* entries, std::size_t count);
+
     /**
      * Increment the log generation.
+     *
+     * The previous generation is retained on disk, and stays readable, until
+     * 'releasePreviousGeneration' is called.  It is invalid to call this while
+     * a previous generation is still retained.
      */
     uint64_t increaseGeneration();
 
+    /**
+     * Discard the retained previous generation, once it is covered by a
+     * checkpoint.  Does nothing if no previous generation is retained.
+     */
+    void releasePreviousGeneration();
+
+    /**
+     * Check whether the previous generation is still retained.
+     */
+    bool hasPreviousGeneration() const;
+
+    /**
+     * Check whether the entries of 'generation' can be read.
+     */
+    bool hasGeneration(uint64_t generation) const;
+
     /**
      * Get the current log generation.
      */
     uint64_t getGeneration() const;
 
     /**
-     * Return a log reader starting at the front of the log.
+     * Get the number of blocks held by the current and retained generations.
+     */
+    std::size_t getUsedBlocks() const;
+
+    /**
+     * Get the number of blocks the log wraps around.  One of them is always
+     * kept free to start the next generation in.
+     */
+    std::size_t getCapacity() const;
+
+    /**
+     * Return a log reader starting at the front of the current generation.
      *
      * It is invalid to request another log reader when one is already
      * open.
@@ -112,7 +210,16 @@ public:
      * is open.
      */
     Reader& readLog();
+
+    /**
+     * Return a log reader over 'generation', which must be readable.
+     */
+    Reader& readLog(uint64_t generation);
 private:
+    // Get the block 'offset' blocks into the segment at 'segmentStart',
+    // wrapping around the end of the log.
+    std::size_t blockAt(std::size_t segmentStart, std::size_t offset) const;
+
     // Release our reader.  Invalidates all external references to the
     // reader.
     void releaseReader();
@@ -123,6 +230,8 @@ private:
     const std::size_t _logMinBlock;
     // The maximum block used by the log.
     const std::size_t _logMaxBlock;
+    // The number of log blocks after the superblock.
+    const std::size_t _logBlockCount;
 
     // The log superblock.
     std::unique_ptr<Buffer> _superblock = nullptr;
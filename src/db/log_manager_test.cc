@@ -1,5 +1,9 @@
 #include "util/testing.h"
 
+#include <fstream>
+#include <string>
+#include <vector>
+
 #include "db/log_manager.h"
 #include "io/buffer_manager.h"
 
@@ -120,10 +124,184 @@ TEST(LogManagerIncreasesGeneration) {
     END;
 }
 
+TEST(LogManagerRetainsPreviousGeneration) {
+    BufferManager manager("/dev/rdisk2");
+    LogManager logManager(manager, {0, 10});
+
+    logManager.format();
+    EXPECT_FALSE(logManager.hasPreviousGeneration());
+
+    LogManager::Entry entry(LogManager::OpCode::ADD_NODE, 1, 2);
+    EXPECT_TRUE(logManager.logOperation(entry));
+
+    uint64_t generation = logManager.increaseGeneration();
+    EXPECT_TRUE(logManager.hasPreviousGeneration());
+    EXPECT_TRUE(logManager.hasGeneration(generation - 1));
+
+    LogManager::Entry entryNew(LogManager::OpCode::ADD_EDGE, 1, 2);
+    EXPECT_TRUE(logManager.logOperation(entryNew));
+
+    LogManager::Reader &reader = logManager.readLog(generation - 1);
+    EXPECT_TRUE(reader.hasNext());
+    EXPECT_TRUE(reader.getNext() == entry);
+    EXPECT_FALSE(reader.hasNext());
+    reader.close();
+
+    LogManager::Reader &newReader = logManager.readLog(generation);
+    EXPECT_TRUE(newReader.hasNext());
+    EXPECT_TRUE(newReader.getNext() == entryNew);
+    EXPECT_FALSE(newReader.hasNext());
+    newReader.close();
+
+    logManager.releasePreviousGeneration();
+    EXPECT_FALSE(logManager.hasPreviousGeneration());
+    EXPECT_FALSE(logManager.hasGeneration(generation - 1));
+
+    END;
+}
+
+TEST(LogManagerGenerationFull) {
+    BufferManager manager("/dev/rdisk2");
+    LogManager logManager(manager, {0, 10});
+
+    logManager.format();
+
+    // A generation may use all but one of the 9 log blocks.
+    LogManager::Entry entry(LogManager::OpCode::ADD_NODE, 1, 2);
+    Status status = StatusCode::SUCCESS;
+    int logged = 0;
+    while ((status = logManager.logOperation(entry))) {
+        logged++;
+    }
+
+    EXPECT_TRUE(status == StatusCode::NO_SPACE);
+    EXPECT_EQ(logged, 8 * 169);
+
+    END;
+}
+
+TEST(LogManagerReadBatches) {
+    BufferManager manager("/dev/rdisk2");
+    LogManager logManager(manager, {0, 1000});
+
+    // Enough entries for several windows of reads.
+    logManager.format();
+    for (int i = 0; i < 60000; i++) {
+        LogManager::Entry entry(LogManager::OpCode::ADD_NODE, i, 0);
+        EXPECT_TRUE(logManager.logOperation(entry));
+    }
+
+    LogManager::Reader &reader = logManager.readLog();
+    int64_t next = 0;
+    LogManager::Reader::Batch batch;
+    while ((batch = reader.getBatch()).count) {
+        for (std::size_t i = 0; i < batch.count; i++) {
+            EXPECT_EQ(batch.entries[i].idA, next++);
+        }
+    }
+    EXPECT_EQ(next, 60000);
+    EXPECT_FALSE(reader.hasNext());
+    reader.close();
+
+    END;
+}
+
+TEST(LogManagerWrapsAround) {
+    BufferManager manager("/dev/rdisk2");
+    LogManager logManager(manager, {0, 10});
+
+    logManager.format();
+
+    // Generations of three blocks wrap around the 9 log blocks repeatedly.
+    for (int64_t generation = 0; generation < 10; generation++) {
+        for (int i = 0; i < 3 * 169; i++) {
+            LogManager::Entry entry(LogManager::OpCode::ADD_NODE, generation, i);
+            EXPECT_TRUE(logManager.logOperation(entry));
+        }
+
+        logManager.increaseGeneration();
+        EXPECT_EQ(logManager.getUsedBlocks(), 4);
+
+        LogManager::Reader &reader = logManager.readLog(logManager.getGeneration() - 1);
+        int read = 0;
+        while (reader.hasNext()) {
+            LogManager::Entry entry = reader.getNext();
+            EXPECT_EQ(entry.idA, generation);
+            EXPECT_EQ(entry.idB, read++);
+        }
+        EXPECT_EQ(read, 3 * 169);
+        reader.close();
+
+        logManager.releasePreviousGeneration();
+        EXPECT_EQ(logManager.getUsedBlocks(), 1);
+    }
+
+    END;
+}
+
+namespace {
+
+// The number of write calls this process has made, from /proc.
+uint64_t countWrites() {
+    std::ifstream io("/proc/self/io");
+    std::string name;
+    uint64_t value;
+    while (io >> name >> value) {
+        if (name == "syscw:") {
+            return value;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+TEST(LogManagerBatch) {
+    BufferManager manager("/dev/rdisk2");
+    LogManager logManager(manager, {0, 10});
+
+    logManager.format();
+    logManager.init();
+
+    // The batch fills the current block and one more.
+    std::vector<LogManager::Entry> entries;
+    for (int i = 0; i < 300; i++) {
+        entries.emplace_back(LogManager::OpCode::ADD_EDGE, 1, i);
+    }
+
+    uint64_t writes = countWrites();
+    EXPECT_EQ(logManager.logOperations(entries.data(), entries.size()), 300);
+
+    // A write of each of the two blocks, and one of the superblock.
+    EXPECT_EQ(countWrites() - writes, 3);
+    EXPECT_EQ(logManager.getUsedBlocks(), 2);
+
+    LogManager::Reader &reader = logManager.readLog();
+    for (int i = 0; i < 300; i++) {
+        EXPECT_TRUE(reader.hasNext());
+        EXPECT_TRUE(reader.getNext() == entries[i]);
+    }
+    EXPECT_FALSE(reader.hasNext());
+    reader.close();
+
+    // Only the entries which fit are added, leaving a block free.
+    entries.assign(10 * 169, entries[0]);
+    EXPECT_EQ(logManager.logOperations(entries.data(), entries.size()), 8 * 169 - 300);
+    EXPECT_EQ(logManager.getUsedBlocks(), 8);
+
+    END;
+}
+
 int main() {
     LogManagerFormatCheckpoint();
     LogManagerIncrementCheckpoint();
     LogManagerReadWrite();
     LogManagerReadWriteAcrossBoundaries();
     LogManagerIncreasesGeneration();
+    LogManagerRetainsPreviousGeneration();
+    LogManagerGenerationFull();
+    LogManagerReadBatches();
+    LogManagerWrapsAround();
+    LogManagerBatch();
 }
@@ -0,0 +1,519 @@
+#include "db/log_replayer.h"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "db/types.h"
+#include "util/stdx/memory.h"
+
+namespace {
+
+using NodeMap = std::map<NodeId, std::unique_ptr<Node>>;
+
+// The index of an entry in the replayed log.  Initial state is at -1.
+using Position = int64_t;
+
+std::size_t shardOf(NodeId nodeId, std::size_t shardCount) {
+    return static_cast<uint64_t>(nodeId) % shardCount;
+}
+
+bool isNodeOperation(const LogManager::Entry& entry) {
+    return entry.opcode == LogManager::OpCode::ADD_NODE ||
+           entry.opcode == LogManager::OpCode::REMOVE_NODE;
+}
+
+bool isEdgePartOperation(const LogManager::Entry& entry) {
+    return entry.opcode == LogManager::OpCode::ADD_EDGE_PART ||
+           entry.opcode == LogManager::OpCode::REMOVE_EDGE_PART;
+}
+
+/**
+ * An edge, identified by its nodes in ascending order.
+ */
+using EdgeKey = std::pair<NodeId, NodeId>;
+
+EdgeKey edgeKey(NodeId nodeAId, NodeId nodeBId) {
+    return nodeAId < nodeBId ? EdgeKey(nodeAId, nodeBId) : EdgeKey(nodeBId, nodeAId);
+}
+
+struct EdgeKeyHash {
+    std::size_t operator()(const EdgeKey& key) const {
+        return std::hash<NodeId>()(key.first) * 31 + std::hash<NodeId>()(key.second);
+    }
+};
+
+/**
+ * The spans of the log in which a node was added and then removed again,
+ * from the addition to the removal inclusive.
+ */
+using Lifetimes = std::vector<std::pair<Position, Position>>;
+
+bool within(const Lifetimes& lifetimes, Position position) {
+    auto it = std::upper_bound(lifetimes.begin(), lifetimes.end(),
+                               std::make_pair(position, std::numeric_limits<Position>::max()));
+    return it != lifetimes.begin() && (it - 1)->second >= position;
+}
+
+/**
+ * The positions at which a node was added or removed.
+ */
+struct NodeHistory {
+    bool initiallyExists;
+    // Positions of the entries which changed whether the node exists.
+    std::vector<Position> changes;
+
+    // Whether the node exists just before the entry at 'position'.
+    bool existsBefore(Position position) const {
+        auto changed = std::lower_bound(changes.begin(), changes.end(), position) - changes.begin();
+        return initiallyExists != (changed % 2 == 1);
+    }
+
+    // Whether the node was removed strictly between 'after' and 'before'.
+    bool removedBetween(Position after, Position before) const {
+        auto it = std::upper_bound(changes.begin(), changes.end(), after);
+        // Changes alternate, so one of the next two is a removal.
+        for (int i = 0; i < 2 && it != changes.end() && *it < before; i++, it++) {
+            bool removal = initiallyExists == ((it - changes.begin()) % 2 == 0);
+            if (removal) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+using ShardHistories = std::vector<std::unordered_map<NodeId, NodeHistory>>;
+
+/**
+ * Answers whether nodes exist at points in the log, across all shards.
+ */
+class Timeline {
+public:
+    Timeline(const NodeMap& nodes, const ShardHistories& histories)
+        : _nodes(nodes), _histories(histories) {};
+
+    bool existsBefore(NodeId nodeId, Position position) const {
+        const auto& shard = _histories[shardOf(nodeId, _histories.size())];
+        auto it = shard.find(nodeId);
+        if (it == shard.end()) {
+            return _nodes.find(nodeId) != _nodes.end();
+        }
+
+        return it->second.existsBefore(position);
+    }
+
+    bool removedBetween(NodeId nodeId, Position after, Position before) const {
+        const auto& shard = _histories[shardOf(nodeId, _histories.size())];
+        auto it = shard.find(nodeId);
+        return it != shard.end() && it->second.removedBetween(after, before);
+    }
+
+private:
+    const NodeMap& _nodes;
+    const ShardHistories& _histories;
+};
+
+/**
+ * An edge of a node being replayed.
+ */
+struct EdgeState {
+    // Where the edge was added.
+    Position added;
+    // Whether this is an edge part, which the other node does not hold, and
+    // so is not dropped when the other node is removed.
+    bool part;
+};
+
+/**
+ * A node being replayed.  Edges are dropped lazily once the other node is
+ * found to have been removed since the edge was added.
+ */
+struct NodeState {
+    bool exists;
+    std::unordered_map<NodeId, EdgeState> edges;
+};
+
+/**
+ * Replays the entries touching the nodes of one shard.
+ */
+class ShardReplayer {
+public:
+    ShardReplayer(const NodeMap& nodes, const Timeline& timeline,
+                  std::size_t shard, std::size_t shardCount)
+        : _nodes(nodes), _timeline(timeline), _shard(shard),
+          _shardCount(shardCount) {};
+
+    void replay(const std::vector<LogManager::Entry>& entries) {
+        for (Position i = 0; i < static_cast<Position>(entries.size()); i++) {
+            const LogManager::Entry& entry = entries[i];
+            if (isNodeOperation(entry)) {
+                if (!ours(entry.idA)) {
+                    continue;
+                }
+
+                NodeState& state = load(entry.idA);
+                bool adding = entry.opcode == LogManager::OpCode::ADD_NODE;
+                if (state.exists != adding) {
+                    state.exists = adding;
+                    state.edges.clear();
+                }
+
+                continue;
+            }
+
+            NodeId nodeAId = entry.idA;
+            NodeId nodeBId = entry.idB;
+            if (nodeAId == nodeBId || (!ours(nodeAId) && !ours(nodeBId))) {
+                continue;
+            }
+
+            if (!_timeline.existsBefore(nodeAId, i) || !_timeline.existsBefore(nodeBId, i)) {
+                continue;
+            }
+
+            bool adding = entry.opcode == LogManager::OpCode::ADD_EDGE;
+            for (auto ends : {std::make_pair(nodeAId, nodeBId), std::make_pair(nodeBId, nodeAId)}) {
+                if (!ours(ends.first)) {
+                    continue;
+                }
+
+                NodeState& state = load(ends.first);
+                bool present = hasEdge(state, ends.second, i);
+                if (adding && !present) {
+                    state.edges[ends.second] = {i, false};
+                } else if (!adding && present) {
+                    state.edges.erase(ends.second);
+                }
+            }
+        }
+    }
+
+    /**
+     * Load the nodes of this shard which had an edge to a removed node in the
+     * initial state, so their edges are brought up to date too.
+     */
+    void loadNeighborsOf(const NodeIdList& removedNodes) {
+        for (const NodeId& nodeId : removedNodes) {
+            for (const NodeId& neighborId : _nodes.at(nodeId)->edges()) {
+                if (ours(neighborId)) {
+                    load(neighborId);
+                }
+            }
+        }
+    }
+
+    /**
+     * Build the final state of each node touched, at position 'end'.  A null
+     * node marks a node which no longer exists.
+     */
+    std::vector<std::pair<NodeId, std::unique_ptr<Node>>> finish(Position end) {
+        std::vector<std::pair<NodeId, std::unique_ptr<Node>>> result;
+        result.reserve(_states.size());
+        for (auto& it : _states) {
+            std::unique_ptr<Node> node;
+            if (it.second.exists) {
+                node = stdx::make_unique<Node>(it.first);
+                node->reserveEdges(it.second.edges.size());
+                for (const auto& edge : it.second.edges) {
+                    if (edge.second.part ||
+                            !_timeline.removedBetween(edge.first, edge.second.added, end)) {
+                        node->addEdge(edge.first);
+                    }
+                }
+            }
+
+            result.emplace_back(it.first, std::move(node));
+        }
+
+        return result;
+    }
+
+private:
+    bool ours(NodeId nodeId) const {
+        return shardOf(nodeId, _shardCount) == _shard;
+    }
+
+    // Get the state of 'nodeId', starting from its initial state.
+    NodeState& load(NodeId nodeId) {
+        auto it = _states.find(nodeId);
+        if (it != _states.end()) {
+            return it->second;
+        }
+
+        NodeState& state = _states[nodeId];
+        auto node = _nodes.find(nodeId);
+        state.exists = node != _nodes.end();
+        if (state.exists) {
+            for (const NodeId& edgeId : node->second->edges()) {
+                auto other = _nodes.find(edgeId);
+                bool part = other == _nodes.end() || !other->second->hasEdge(nodeId);
+                state.edges[edgeId] = {-1, part};
+            }
+        }
+
+        return state;
+    }
+
+    // Whether 'state' has an edge to 'nodeId' just before 'position'.
+    bool hasEdge(NodeState& state, NodeId nodeId, Position position) {
+        auto it = state.edges.find(nodeId);
+        if (it == state.edges.end()) {
+            return false;
+        }
+
+        if (!it->second.part &&
+                _timeline.removedBetween(nodeId, it->second.added, position)) {
+            state.edges.erase(it);
+            return false;
+        }
+
+        return true;
+    }
+
+    const NodeMap& _nodes;
+    const Timeline& _timeline;
+    const std::size_t _shard;
+    const std::size_t _shardCount;
+
+    std::unordered_map<NodeId, NodeState> _states;
+};
+
+} // namespace
+
+LogReplayer::LogReplayer(MemoryStore& memoryStore, std::size_t threadCount)
+    : _memoryStore(memoryStore), _threadCount(std::max<std::size_t>(threadCount, 1)) {}
+
+void LogReplayer::replay(const std::vector<LogManager::Entry>& log) {
+    std::vector<LogManager::Entry> netted;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_memoryStore._memoryStoreMutex);
+        netted = net(log);
+    }
+
+    const std::vector<LogManager::Entry>& entries = netted;
+    bool hasEdgeParts = std::any_of(entries.begin(), entries.end(), isEdgePartOperation);
+
+    // Edge parts are held by one node only, which the partitioned replay
+    // does not model.
+    if (hasEdgeParts || _threadCount == 1) {
+        replaySerially(entries);
+        return;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(_memoryStore._memoryStoreMutex);
+    const NodeMap& nodes = _memoryStore._nodes;
+
+    // The replay works on the in memory nodes, so copy the nodes the entries
+    // touch, and their neighbors, out of the base image.
+    if (_memoryStore._baseImage) {
+        for (const LogManager::Entry& entry : entries) {
+            for (NodeId nodeId : {entry.idA, entry.idB}) {
+                if (const Node* node = _memoryStore.lookupNode(nodeId)) {
+                    for (const NodeId& edgeId : node->edges()) {
+                        _memoryStore.lookupNode(edgeId);
+                    }
+                }
+
+                if (isNodeOperation(entry)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Find when each node was added and removed.
+    ShardHistories histories(_threadCount);
+    parallel::run(_threadCount, [&](std::size_t shard) {
+        auto& shardHistories = histories[shard];
+        for (Position i = 0; i < static_cast<Position>(entries.size()); i++) {
+            const LogManager::Entry& entry = entries[i];
+            if (!isNodeOperation(entry) || shardOf(entry.idA, _threadCount) != shard) {
+                continue;
+            }
+
+            auto it = shardHistories.find(entry.idA);
+            if (it == shardHistories.end()) {
+                it = shardHistories.emplace(entry.idA,
+                    NodeHistory{nodes.find(entry.idA) != nodes.end(), {}}).first;
+            }
+
+            NodeHistory& history = it->second;
+            bool exists = history.initiallyExists != (history.changes.size() % 2 == 1);
+            if (exists != (entry.opcode == LogManager::OpCode::ADD_NODE)) {
+                history.changes.push_back(i);
+            }
+        }
+    });
+
+    // Nodes present initially and removed, whose neighbors lose their edges.
+    NodeIdList removedNodes;
+    for (const auto& shardHistories : histories) {
+        for (const auto& it : shardHistories) {
+            if (it.second.initiallyExists && !it.second.changes.empty()) {
+                removedNodes.push_back(it.first);
+            }
+        }
+    }
+
+    Timeline timeline(nodes, histories);
+    std::vector<std::vector<std::pair<NodeId, std::unique_ptr<Node>>>> results(_threadCount);
+    parallel::run(_threadCount, [&](std::size_t shard) {
+        ShardReplayer replayer(nodes, timeline, shard, _threadCount);
+        replayer.replay(entries);
+        replayer.loadNeighborsOf(removedNodes);
+        results[shard] = replayer.finish(entries.size());
+    });
+
+    for (auto& result : results) {
+        for (auto& it : result) {
+            _memoryStore.willModify(it.first);
+            if (it.second) {
+                _memoryStore._nodes[it.first] = std::move(it.second);
+            } else {
+                _memoryStore.eraseNode(it.first);
+            }
+        }
+    }
+}
+
+std::vector<LogManager::Entry> LogReplayer::net(const std::vector<LogManager::Entry>& entries) {
+    const Position count = entries.size();
+    std::vector<bool> superseded(count, false);
+
+    // Find the lifetimes of nodes added and removed within the log.  Every
+    // edge made to such a node is dropped again by its removal, so the whole
+    // lifetime has no effect.  Edge parts are not dropped by the removal of
+    // the other node, so nodes with edge part operations are left alone.
+    std::unordered_map<NodeId, std::pair<bool, Position>> existence;
+    std::unordered_map<NodeId, Lifetimes> lifetimes;
+    std::unordered_set<NodeId> hasEdgeParts;
+    for (Position i = 0; i < count; i++) {
+        const LogManager::Entry& entry = entries[i];
+        if (isEdgePartOperation(entry)) {
+            hasEdgeParts.insert(entry.idA);
+            hasEdgeParts.insert(entry.idB);
+            continue;
+        }
+
+        if (!isNodeOperation(entry)) {
+            continue;
+        }
+
+        auto it = existence.find(entry.idA);
+        if (it == existence.end()) {
+            // An initial node has no addition in the log to start a lifetime.
+            bool exists = _memoryStore.lookupNode(entry.idA) != nullptr;
+            it = existence.emplace(entry.idA, std::make_pair(exists, Position(-1))).first;
+        }
+
+        bool& exists = it->second.first;
+        Position& added = it->second.second;
+        if (entry.opcode == LogManager::OpCode::ADD_NODE && !exists) {
+            exists = true;
+            added = i;
+        } else if (entry.opcode == LogManager::OpCode::REMOVE_NODE && exists) {
+            exists = false;
+            if (added >= 0) {
+                lifetimes[entry.idA].emplace_back(added, i);
+            }
+        }
+    }
+
+    for (NodeId nodeId : hasEdgeParts) {
+        lifetimes.erase(nodeId);
+    }
+
+    auto inLifetime = [&](NodeId nodeId, Position position) {
+        auto it = lifetimes.find(nodeId);
+        return it != lifetimes.end() && within(it->second, position);
+    };
+
+    // Between operations on its nodes, only the last of a run of operations
+    // on an edge decides whether it exists.
+    struct LastOperation {
+        Position position;
+        uint64_t generationA;
+        uint64_t generationB;
+    };
+    std::unordered_map<NodeId, uint64_t> generations;
+    std::unordered_map<EdgeKey, LastOperation, EdgeKeyHash> lastOperations;
+    for (Position i = 0; i < count; i++) {
+        const LogManager::Entry& entry = entries[i];
+        if (isNodeOperation(entry)) {
+            if (inLifetime(entry.idA, i)) {
+                superseded[i] = true;
+            } else {
+                generations[entry.idA]++;
+            }
+
+            continue;
+        }
+
+        EdgeKey key = edgeKey(entry.idA, entry.idB);
+        if (isEdgePartOperation(entry)) {
+            lastOperations.erase(key);
+            continue;
+        }
+
+        if (inLifetime(entry.idA, i) || inLifetime(entry.idB, i)) {
+            superseded[i] = true;
+            continue;
+        }
+
+        LastOperation operation{i, generations[key.first], generations[key.second]};
+        auto inserted = lastOperations.emplace(key, operation);
+        if (!inserted.second) {
+            LastOperation& last = inserted.first->second;
+            if (last.generationA == operation.generationA &&
+                    last.generationB == operation.generationB) {
+                superseded[last.position] = true;
+            }
+
+            last = operation;
+        }
+    }
+
+    std::vector<LogManager::Entry> result;
+    result.reserve(count - std::count(superseded.begin(), superseded.end(), true));
+    for (Position i = 0; i < count; i++) {
+        if (!superseded[i]) {
+            result.push_back(entries[i]);
+        }
+    }
+
+    return result;
+}
+
+void LogReplayer::replaySerially(const std::vector<LogManager::Entry>& entries) {
+    for (const LogManager::Entry& entry : entries) {
+        switch (entry.opcode) {
+            case LogManager::OpCode::ADD_NODE:
+                _memoryStore.addNode(entry.idA);
+                break;
+            case LogManager::OpCode::REMOVE_NODE:
+                _memoryStore.removeNode(entry.idA);
+                break;
+            case LogManager::OpCode::ADD_EDGE:
+                _memoryStore.addEdge(entry.idA, entry.idB);
+                break;
+            case LogManager::OpCode::REMOVE_EDGE:
+                _memoryStore.removeEdge(entry.idA, entry.idB);
+                break;
+            case LogManager::OpCode::ADD_EDGE_PART:
+                _memoryStore.addEdgePart(entry.idA, entry.idB);
+                break;
+            case LogManager::OpCode::REMOVE_EDGE_PART:
+                _memoryStore.removeEdgePart(entry.idA, entry.idB);
+                break;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * log_replayer.h: Replay log entries into a memory store.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "db/log_manager.h"
+#include "db/memory_store.h"
+#include "util/nocopy.h"
+#include "util/parallel.h"
+
+/**
+ * Replays a sequence of log entries into a `MemoryStore`, with the same
+ * result as applying the entries one at a time.
+ *
+ * The log is netted first: entries whose effects are superseded later in the
+ * log are dropped.  Nodes added and removed again within the log are skipped
+ * with every edge made to them, and a run of operations on one edge collapses
+ * to its last operation.
+ *
+ * Nodes are partitioned across threads by id, and each thread replays the
+ * entries touching its nodes in log order.  Whether an edge operation takes
+ * effect depends on both of its nodes existing at that point in the log, so
+ * node additions and removals are resolved for every node first.  The final
+ * state of each touched node is then installed into the store.
+ *
+ * Logs holding edge part operations are replayed serially.
+ */
+class LogReplayer {
+    DISALLOW_COPY(LogReplayer);
+public:
+    LogReplayer(MemoryStore& memoryStore,
+                std::size_t threadCount = parallel::threadCount());
+
+    /**
+     * Replay 'entries', in order, into the store.
+     */
+    void replay(const std::vector<LogManager::Entry>& entries);
+
+private:
+    // Return 'entries' without the entries superseded later in the log.
+    std::vector<LogManager::Entry> net(const std::vector<LogManager::Entry>& entries);
+
+    // Apply 'entries' one at a time through the store interface.
+    void replaySerially(const std::vector<LogManager::Entry>& entries);
+
+    MemoryStore& _memoryStore;
+    const std::size_t _threadCount;
+};
@@ -0,0 +1,163 @@
+#include "util/testing.h"
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "db/log_manager.h"
+#include "db/log_replayer.h"
+#include "db/memory_store.h"
+
+namespace {
+
+using Entries = std::vector<LogManager::Entry>;
+
+// Build the initial graph of a store to replay into.
+void populate(MemoryStore& store) {
+    for (NodeId i = 0; i < 40; i++) {
+        store.addNode(i);
+    }
+
+    for (NodeId i = 1; i < 40; i++) {
+        store.addEdge(i, i / 3);
+    }
+}
+
+std::map<NodeId, std::set<NodeId>> contents(const MemoryStore& store) {
+    std::map<NodeId, std::set<NodeId>> result;
+    for (NodeId i = 0; i < 60; i++) {
+        if (auto status_with_node = store.findNode(i)) {
+            auto edges = (*status_with_node)->edges();
+            result[i] = std::set<NodeId>(edges.begin(), edges.end());
+        }
+    }
+
+    return result;
+}
+
+// Apply 'entries' one at a time through the store interface.
+void applySerially(MemoryStore& store, const Entries& entries) {
+    for (const LogManager::Entry& entry : entries) {
+        switch (entry.opcode) {
+            case LogManager::OpCode::ADD_NODE:
+                store.addNode(entry.idA);
+                break;
+            case LogManager::OpCode::REMOVE_NODE:
+                store.removeNode(entry.idA);
+                break;
+            case LogManager::OpCode::ADD_EDGE:
+                store.addEdge(entry.idA, entry.idB);
+                break;
+            case LogManager::OpCode::REMOVE_EDGE:
+                store.removeEdge(entry.idA, entry.idB);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+Entries randomEntries(unsigned seed, std::size_t count) {
+    std::srand(seed);
+    Entries entries;
+    for (std::size_t i = 0; i < count; i++) {
+        NodeId nodeAId = std::rand() % 60;
+        NodeId nodeBId = std::rand() % 60;
+        switch (std::rand() % 6) {
+            case 0:
+                entries.emplace_back(LogManager::OpCode::ADD_NODE, nodeAId, 0);
+                break;
+            case 1:
+                entries.emplace_back(LogManager::OpCode::REMOVE_NODE, nodeAId, 0);
+                break;
+            case 2:
+            case 3:
+                entries.emplace_back(LogManager::OpCode::ADD_EDGE, nodeAId, nodeBId);
+                break;
+            default:
+                entries.emplace_back(LogManager::OpCode::REMOVE_EDGE, nodeAId, nodeBId);
+                break;
+        }
+    }
+
+    return entries;
+}
+
+} // namespace
+
+TEST(LogReplayerMatchesSerialReplay) {
+    for (unsigned seed = 0; seed < 50; seed++) {
+        Entries entries = randomEntries(seed, 400);
+
+        MemoryStore serial;
+        populate(serial);
+        applySerially(serial, entries);
+
+        MemoryStore single;
+        populate(single);
+        LogReplayer(single, 1).replay(entries);
+
+        MemoryStore parallel;
+        populate(parallel);
+        LogReplayer(parallel, 4).replay(entries);
+
+        EXPECT_TRUE(contents(serial) == contents(single));
+        EXPECT_TRUE(contents(serial) == contents(parallel));
+    }
+
+    END;
+}
+
+TEST(LogReplayerNetsChurn) {
+    MemoryStore store(true);
+    populate(store);
+    store.clearDirtyNodes();
+
+    // A node which comes and goes with edges to existing nodes, and an edge
+    // toggled repeatedly, leave only the edge's last state behind.
+    Entries entries;
+    for (int round = 0; round < 3; round++) {
+        entries.emplace_back(LogManager::OpCode::ADD_NODE, 50, 0);
+        for (NodeId i = 0; i < 10; i++) {
+            entries.emplace_back(LogManager::OpCode::ADD_EDGE, 50, i);
+        }
+        entries.emplace_back(LogManager::OpCode::REMOVE_NODE, 50, 0);
+        entries.emplace_back(LogManager::OpCode::ADD_EDGE, 20, 21);
+        entries.emplace_back(LogManager::OpCode::REMOVE_EDGE, 20, 21);
+    }
+    entries.emplace_back(LogManager::OpCode::ADD_EDGE, 20, 21);
+    LogReplayer(store, 1).replay(entries);
+
+    EXPECT_FALSE(store.findNode(50));
+    EXPECT_TRUE(store.getEdge(20, 21));
+    EXPECT_EQ(store.getDirtyNodeCount(), 2);
+
+    END;
+}
+
+TEST(LogReplayerTracksDirtyNodes) {
+    MemoryStore store(true);
+    populate(store);
+    store.clearDirtyNodes();
+
+    Entries entries;
+    entries.emplace_back(LogManager::OpCode::REMOVE_NODE, 3, 0);
+    entries.emplace_back(LogManager::OpCode::ADD_EDGE, 20, 21);
+    LogReplayer(store, 4).replay(entries);
+
+    EXPECT_FALSE(store.findNode(3));
+    EXPECT_TRUE(store.getEdge(20, 21));
+    EXPECT_FALSE(store.getEdge(1, 3));
+
+    // The removed node, its neighbors and the new edge's nodes.
+    EXPECT_EQ(store.getDirtyNodeCount(), 7);
+
+    END;
+}
+
+int main() {
+    LogReplayerMatchesSerialReplay();
+    LogReplayerTracksDirtyNodes();
+    LogReplayerNetsChurn();
+}
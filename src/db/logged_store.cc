@@ -4,16 +4,30 @@
 #include <mutex>
 
 #include "db/log_manager.h"
+#include "db/log_replayer.h"
 #include "db/memory_store.h"
 #include "db/types.h"
 #include "util/status.h"
+#include "util/stdx/memory.h"
 
 LoggedStore::LoggedStore(const char* deviceName, bool formatLog) :
-        _bufferManager(deviceName),
-        _log(_bufferManager, {0, _bufferManager.getDeviceSize() / 5}),
-        _checkpoint(_bufferManager,
-                    {_bufferManager.getDeviceSize() / 5, _bufferManager.getDeviceSize()},
-                    this) {
+        LoggedStore(StorageLayout{deviceName, deviceName}, formatLog) {}
+
+LoggedStore::LoggedStore(const StorageLayout& layout, bool formatLog) :
+        _logDevice(layout.logDevice.c_str(), layout.logOptions),
+        _checkpointDevice(openCheckpointDevice(layout)),
+        _log(_logDevice, getLogBlocks(layout)),
+        _checkpoint(_checkpointDevice ? *_checkpointDevice : _logDevice,
+                    getCheckpointBlocks(layout), this),
+        _commit(_logDevice, layout.flushInterval),
+        _memoryStore(true),
+        _compactionThreshold(layout.compactionThreshold) {
+    if (!_checkpointDevice) {
+        auto log = getLogBlocks(layout);
+        auto checkpoint = getCheckpointBlocks(layout);
+        invariant(log.second <= checkpoint.first || checkpoint.second <= log.first);
+    }
+
     if (formatLog) {
         _log.format();
         _checkpoint.format();
@@ -22,24 +36,56 @@ LoggedStore::LoggedStore(const char* deviceName, bool formatLog) :
         _checkpoint.init();
         recover();
     }
+
+    if (_compactionThreshold > 0) {
+        _compactor = std::thread(&LoggedStore::compact, this);
+    }
 }
 
-Status LoggedStore::addNode(NodeId nodeId) {
-    std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::ADD_NODE, nodeId, 0});
-    if (!status)
-        return status;
+LoggedStore::~LoggedStore() {
+    if (!_compactor.joinable()) {
+        return;
+    }
 
-    return _memoryStore.addNode(nodeId);
+    {
+        std::lock_guard<std::mutex> lock(_compactionMutex);
+        _stopping = true;
+    }
+    _compactionRequested.notify_one();
+    _compactor.join();
 }
 
-Status LoggedStore::removeNode(NodeId nodeId) {
-    std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::REMOVE_NODE, nodeId, 0});
-    if (!status)
-        return status;
+template <typename Apply>
+Status LoggedStore::logAndApply(LogManager::Entry entry, Durability durability,
+                                Apply apply) {
+    uint64_t sequence;
+    Status status = StatusCode::SUCCESS;
+    {
+        std::lock_guard<std::recursive_mutex> guard(_lock);
+        status = _log.logOperation(entry);
+        checkCompaction();
+        if (!status)
+            return status;
+
+        status = apply();
+        sequence = _commit.appended();
+    }
 
-    return _memoryStore.removeNode(nodeId);
+    // Other writes proceed while this one waits to become durable.
+    _commit.wait(sequence, durability);
+    return status;
+}
+
+Status LoggedStore::addNode(NodeId nodeId, Durability durability) {
+    return logAndApply({LogManager::OpCode::ADD_NODE, nodeId, 0}, durability, [&] {
+        return _memoryStore.addNode(nodeId);
+    });
+}
+
+Status LoggedStore::removeNode(NodeId nodeId, Durability durability) {
+    return logAndApply({LogManager::OpCode::REMOVE_NODE, nodeId, 0}, durability, [&] {
+        return _memoryStore.removeNode(nodeId);
+    });
 }
 
 StatusWith<Node*> LoggedStore::findNode(NodeId nodeId) const {
@@ -53,95 +99,285 @@ StatusWith<std::pair<Node*, Node*>> LoggedStore::getEdge(NodeId nodeAId,
     return _memoryStore.getEdge(nodeAId, nodeBId);
 }
 
-Status LoggedStore::addEdge(NodeId nodeAId, NodeId nodeBId) {
-    std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::ADD_EDGE, nodeAId, nodeBId});
-    if (!status)
-        return status;
+Status LoggedStore::addEdge(NodeId nodeAId, NodeId nodeBId, Durability durability) {
+    return logAndApply({LogManager::OpCode::ADD_EDGE, nodeAId, nodeBId}, durability, [&] {
+        return _memoryStore.addEdge(nodeAId, nodeBId);
+    });
+}
 
-    return _memoryStore.addEdge(nodeAId, nodeBId);
+Status LoggedStore::removeEdge(NodeId nodeAId, NodeId nodeBId, Durability durability) {
+    return logAndApply({LogManager::OpCode::REMOVE_EDGE, nodeAId, nodeBId}, durability, [&] {
+        return _memoryStore.removeEdge(nodeAId, nodeBId);
+    });
 }
 
-Status LoggedStore::removeEdge(NodeId nodeAId, NodeId nodeBId) {
-    std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::REMOVE_EDGE, nodeAId, nodeBId});
-    if (!status)
-        return status;
+Status LoggedStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability durability) {
+    return logAndApply({LogManager::OpCode::ADD_EDGE_PART, nodeLocalId, nodeRemoteId}, durability, [&] {
+        return _memoryStore.addEdgePart(nodeLocalId, nodeRemoteId);
+    });
+}
 
-    return _memoryStore.removeEdge(nodeAId, nodeBId);
+Status LoggedStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability durability) {
+    return logAndApply({LogManager::OpCode::REMOVE_EDGE_PART, nodeLocalId, nodeRemoteId}, durability, [&] {
+        return _memoryStore.removeEdgePart(nodeLocalId, nodeRemoteId);
+    });
 }
 
-Status LoggedStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
+Status LoggedStore::getEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) const {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::ADD_EDGE_PART, nodeLocalId, nodeRemoteId});
-    if (!status)
-        return status;
-
-    return _memoryStore.addEdgePart(nodeLocalId, nodeRemoteId);
+    return _memoryStore.getEdgePart(nodeLocalId, nodeRemoteId);
 }
 
-Status LoggedStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
+StatusWith<NodeIdList> LoggedStore::getNeighbors(NodeId nodeId) const {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    Status status = _log.logOperation({LogManager::OpCode::REMOVE_EDGE_PART, nodeLocalId, nodeRemoteId});
-    if (!status)
-        return status;
+    return _memoryStore.getNeighbors(nodeId);
+}
 
-    return _memoryStore.removeEdgePart(nodeLocalId, nodeRemoteId);
+StatusWith<uint64_t> LoggedStore::getDegree(NodeId nodeId) const {
+    std::lock_guard<std::recursive_mutex> guard(_lock);
+    return _memoryStore.getDegree(nodeId);
 }
 
-Status LoggedStore::getEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) const {
+StatusWith<NodeIdList> LoggedStore::getNeighborPage(NodeId nodeId, NodeId from,
+                                                    std::size_t limit) const {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    return _memoryStore.getEdgePart(nodeLocalId, nodeRemoteId);
+    return _memoryStore.getNeighborPage(nodeId, from, limit);
 }
 
-StatusWith<NodeIdList> LoggedStore::getNeighbors(NodeId nodeId) const {
+Status LoggedStore::visitNeighbors(NodeId nodeId,
+                                   const std::function<void(NodeId)>& visit) const {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    return _memoryStore.getNeighbors(nodeId);
+    return _memoryStore.visitNeighbors(nodeId, visit);
 }
 
-StatusWith<uint64_t> LoggedStore::shortestPath(NodeId nodeAId,
-                                  NodeId nodeBId) const {
+StatusWith<uint64_t> LoggedStore::shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                               const Cancellation* cancellation) const {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    return _memoryStore.shortestPath(nodeAId, nodeBId);
+    return _memoryStore.shortestPath(nodeAId, nodeBId, cancellation);
+}
+
+std::vector<Status> LoggedStore::applyBatch(const std::vector<BatchOperation>& operations,
+                                            Durability durability) {
+    std::vector<Status> result;
+    result.reserve(operations.size());
+
+    std::vector<LogManager::Entry> entries;
+    entries.reserve(operations.size());
+    for (const BatchOperation& operation : operations) {
+        auto entry = logEntry(operation);
+        if (entry) {
+            entries.push_back(*entry);
+        }
+    }
+
+    uint64_t sequence = 0;
+    {
+        std::lock_guard<std::recursive_mutex> guard(_lock);
+
+        // The writes are appended to the log together, before any is
+        // applied.  Those which did not fit are refused.
+        std::size_t logged = _log.logOperations(entries.data(), entries.size());
+        std::size_t written = 0;
+        for (const BatchOperation& operation : operations) {
+            if (logEntry(operation) && written++ >= logged) {
+                result.push_back(StatusCode::NO_SPACE);
+                continue;
+            }
+
+            result.push_back(_memoryStore.applyOperation(operation));
+        }
+
+        checkCompaction();
+        sequence = _commit.appended();
+    }
+
+    _commit.wait(sequence, durability);
+    return result;
 }
 
 Status LoggedStore::checkpoint() {
-    std::lock_guard<std::recursive_mutex> guard(_lock);
-    auto status = _checkpoint.performCheckpoint(_log.getGeneration());
+    std::lock_guard<std::mutex> checkpointGuard(_checkpointLock);
+    std::unique_lock<std::recursive_mutex> guard(_lock);
+    uint64_t generation = _log.getGeneration();
+
+    // Only write out the nodes modified since the last checkpoint, unless it
+    // is time to compact the checkpoint.
+    bool incremental = !_checkpoint.needsFullCheckpoint();
+
+    // The log only retains one generation behind the current one.  If the
+    // last checkpoint failed, that generation is still needed for recovery,
+    // so this checkpoint must cover the current generation with writes
+    // blocked.
+    if (_log.hasPreviousGeneration()) {
+        _memoryStore.beginSnapshot(incremental);
+        auto status = _checkpoint.performCheckpoint(generation, incremental);
+        _memoryStore.endSnapshot(status);
+        if (!status) {
+            return status;
+        }
+
+        _log.releasePreviousGeneration();
+        _log.increaseGeneration();
+        _log.releasePreviousGeneration();
+        return StatusCode::SUCCESS;
+    }
+
+    // Snapshot the store at the end of this log generation, then write it
+    // out while new operations go to the next generation.
+    _memoryStore.beginSnapshot(incremental);
+    _log.increaseGeneration();
+    guard.unlock();
+
+    auto status = _checkpoint.performCheckpoint(generation, incremental);
+
+    guard.lock();
+    _memoryStore.endSnapshot(status);
     if (!status) {
-        // Note the database is not recoverable at this point.
+        // The previous generation stays on disk, so the database remains
+        // recoverable from the last complete checkpoint.
         return status;
     }
 
-    _log.increaseGeneration();
+    _log.releasePreviousGeneration();
     return StatusCode::SUCCESS;
 }
 
 void LoggedStore::recover() {
     std::lock_guard<std::recursive_mutex> guard(_lock);
-    _checkpoint.restoreCheckpoint(_log.getGeneration() - 1);
-    LogManager::Reader &reader = _log.readLog();
-    while (reader.hasNext()) {
-        LogManager::Entry entry = reader.getNext();
-        switch (entry.opcode) {
-            case LogManager::OpCode::ADD_NODE:
-                _memoryStore.addNode(entry.idA);
-                break;
-            case LogManager::OpCode::REMOVE_NODE:
-                _memoryStore.removeNode(entry.idA);
-                break;
-            case LogManager::OpCode::ADD_EDGE:
-                _memoryStore.addEdge(entry.idA, entry.idB);
-                break;
-            case LogManager::OpCode::REMOVE_EDGE:
-                _memoryStore.removeEdge(entry.idA, entry.idB);
-            case LogManager::OpCode::ADD_EDGE_PART:
-                _memoryStore.addEdgePart(entry.idA, entry.idB);
-                break;
-            case LogManager::OpCode::REMOVE_EDGE_PART:
-                _memoryStore.removeEdgePart(entry.idA, entry.idB);
-                break;
+
+    // Restore the newest complete checkpoint, then replay the log
+    // generations written after it.
+    uint64_t checkpointGeneration = 0;
+    auto status_with_generation = _checkpoint.getLatestCheckpoint();
+    if (status_with_generation) {
+        checkpointGeneration = *status_with_generation;
+        _checkpoint.restoreCheckpoint(checkpointGeneration);
+    }
+
+    // Both generations are replayed together, so the replay can be spread
+    // across threads.
+    std::vector<LogManager::Entry> entries;
+    uint64_t generation = _log.getGeneration();
+    if (checkpointGeneration + 1 < generation && _log.hasGeneration(generation - 1)) {
+        // The checkpoint of the previous generation did not complete.
+        readEntries(_log.readLog(generation - 1), entries);
+    }
+
+    if (checkpointGeneration < generation) {
+        readEntries(_log.readLog(generation), entries);
+    }
+
+    LogReplayer(_memoryStore).replay(entries);
+}
+
+StatusWith<LogManager::Entry> LoggedStore::logEntry(const BatchOperation& operation) {
+    switch (operation.type) {
+        case BatchOperation::Type::ADD_NODE:
+            return LogManager::Entry(LogManager::OpCode::ADD_NODE, operation.nodeAId, 0);
+        case BatchOperation::Type::REMOVE_NODE:
+            return LogManager::Entry(LogManager::OpCode::REMOVE_NODE, operation.nodeAId, 0);
+        case BatchOperation::Type::ADD_EDGE:
+            return LogManager::Entry(LogManager::OpCode::ADD_EDGE, operation.nodeAId,
+                                     operation.nodeBId);
+        case BatchOperation::Type::REMOVE_EDGE:
+            return LogManager::Entry(LogManager::OpCode::REMOVE_EDGE, operation.nodeAId,
+                                     operation.nodeBId);
+        case BatchOperation::Type::GET_NODE:
+        case BatchOperation::Type::GET_EDGE:
+            break;
+    }
+
+    return StatusCode::NO_ACTION;
+}
+
+bool LoggedStore::needsCompaction() const {
+    return _compactionThreshold > 0 &&
+        _log.getUsedBlocks() >= _compactionThreshold * _log.getCapacity();
+}
+
+void LoggedStore::checkCompaction() {
+    if (!needsCompaction()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_compactionMutex);
+        _compactionPending = true;
+    }
+    _compactionRequested.notify_one();
+}
+
+void LoggedStore::compact() {
+    std::unique_lock<std::mutex> lock(_compactionMutex);
+    while (true) {
+        _compactionRequested.wait(lock, [this] {
+            return _stopping || _compactionPending;
+        });
+
+        if (_stopping) {
+            return;
+        }
+
+        _compactionPending = false;
+        lock.unlock();
+
+        // Writes made while the last checkpoint was written may have asked
+        // for a compaction it has since made unnecessary.
+        bool needed;
+        {
+            std::lock_guard<std::recursive_mutex> guard(_lock);
+            needed = needsCompaction();
+        }
+
+        // A failed checkpoint keeps its generation in the log, and the next
+        // write past the threshold retries.
+        if (needed) {
+            checkpoint();
         }
+
+        lock.lock();
+    }
+}
+
+std::unique_ptr<BufferManager> LoggedStore::openCheckpointDevice(
+        const StorageLayout& layout) {
+    if (layout.checkpointDevice == layout.logDevice) {
+        return nullptr;
+    }
+
+    return stdx::make_unique<BufferManager>(layout.checkpointDevice.c_str(),
+                                            layout.checkpointOptions);
+}
+
+std::pair<std::size_t, std::size_t> LoggedStore::getLogBlocks(
+        const StorageLayout& layout) const {
+    if (layout.logBlocks.first < layout.logBlocks.second) {
+        return layout.logBlocks;
+    }
+
+    std::size_t deviceSize = _logDevice.getDeviceSize();
+    return {0, _checkpointDevice ? deviceSize : deviceSize / 5};
+}
+
+std::pair<std::size_t, std::size_t> LoggedStore::getCheckpointBlocks(
+        const StorageLayout& layout) const {
+    if (layout.checkpointBlocks.first < layout.checkpointBlocks.second) {
+        return layout.checkpointBlocks;
+    }
+
+    if (_checkpointDevice) {
+        return {0, _checkpointDevice->getDeviceSize()};
+    }
+
+    std::size_t deviceSize = _logDevice.getDeviceSize();
+    return {deviceSize / 5, deviceSize};
+}
+
+void LoggedStore::readEntries(LogManager::Reader& reader,
+                              std::vector<LogManager::Entry>& entries) {
+    LogManager::Reader::Batch batch;
+    while ((batch = reader.getBatch()).count) {
+        entries.insert(entries.end(), batch.entries, batch.entries + batch.count);
     }
 
     reader.close();
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "db/log_manager.h"
 #include "db/checkpoint_manager.h"
+#include "db/group_commit.h"
 #include "db/memory_store.h"
 #include "db/types.h"
 #include "util/nocopy.h"
@@ -13,22 +22,74 @@
  * A graph store that maintains an on disk log and checkpoint in addition
  * to an in memory data representation.
  *
- * This enables durability.
+ * This enables durability.  Writes are logged before they are applied, and
+ * acknowledged at the durability each asks for.  Lower durabilities only
+ * pay off when the log device syncs in batches.
  */
 class LoggedStore : public GraphStore {
     DISALLOW_COPY(LoggedStore);
 public:
+    /**
+     * Where the log and checkpoints are kept.
+     *
+     * Each is a range of blocks of a device, as [first, end).  The log and
+     * checkpoints may be on separate devices, so log appends do not queue
+     * behind checkpoint writes, or share one device in disjoint ranges.
+     */
+    struct StorageLayout {
+        StorageLayout(std::string logDevice, std::string checkpointDevice,
+                      std::pair<std::size_t, std::size_t> logBlocks = {0, 0},
+                      std::pair<std::size_t, std::size_t> checkpointBlocks = {0, 0})
+                : logDevice(std::move(logDevice)),
+                  checkpointDevice(std::move(checkpointDevice)),
+                  logBlocks(logBlocks), checkpointBlocks(checkpointBlocks) {}
+
+        std::string logDevice;
+        std::string checkpointDevice;
+
+        // Empty ranges default to the whole device, or, when the device is
+        // shared, the first fifth of it for the log and the rest for
+        // checkpoints.
+        std::pair<std::size_t, std::size_t> logBlocks;
+        std::pair<std::size_t, std::size_t> checkpointBlocks;
+
+        // How the devices are opened.  The log device's options apply to a
+        // shared device.
+        BufferManager::Options logOptions;
+        BufferManager::Options checkpointOptions;
+
+        // The longest asynchronously acknowledged writes wait to be synced.
+        std::chrono::milliseconds flushInterval{10};
+
+        // Continuous compaction: once the log fills past this fraction of its
+        // blocks, a background thread checkpoints the store, folding the
+        // oldest log generation into the checkpoints and freeing its blocks.
+        // Zero leaves checkpoints to explicit checkpoint() calls.  Should be
+        // below one, as one log block is always kept free.
+        double compactionThreshold = 0;
+    };
+
+    /**
+     * Create a store keeping both the log and checkpoints on 'deviceName'.
+     */
     LoggedStore(const char* deviceName, bool formatLog);
 
+    LoggedStore(const StorageLayout& layout, bool formatLog);
+
+    // Stops continuous compaction.
+    ~LoggedStore();
+
     /**
      * Add a node with id `node_id` to the store.
      */
-    virtual Status addNode(NodeId nodeId) override;
+    virtual Status addNode(NodeId nodeId,
+                           Durability durability = Durability::SYNC) override;
 
     /**
      * Remove a node from the store.
      */
-    virtual Status removeNode(NodeId nodeId) override;
+    virtual Status removeNode(NodeId nodeId,
+                              Durability durability = Durability::SYNC) override;
 
     /**
      * Find a node in the store.
@@ -44,12 +105,14 @@ public:
     /**
      * Adds an edge between `nodeAId` and `nodeBId`.
      */
-    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId) override;
+    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId,
+                           Durability durability = Durability::SYNC) override;
 
     /**
      * Remove an edge between 'nodeAId' and 'nodeBId'.
      */
-    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId) override;
+    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId,
+                              Durability durability = Durability::SYNC) override;
 
     /**
      * Get an edge part between 'nodeLocalId' and 'nodeRemoteId'.
@@ -59,32 +122,61 @@ public:
     /**
      * Adds an edge part between `nodeLocalId` and `nodeRemoteId`.
      */
-    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) override;
+    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                               Durability durability = Durability::SYNC) override;
 
     /**
      * Remove an edge part between 'nodeLocalId' and 'nodeRemoteId'.
      *
      * Precondition: 'nodeLocalId' is on this partition.
      */
-    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) override;
+    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                                  Durability durability = Durability::SYNC) override;
 
     /**
      * Find the neighbors of 'nodeId'.
      */
     virtual StatusWith<NodeIdList> getNeighbors(NodeId nodeId) const override;
 
+    /**
+     * Find the number of neighbors of 'nodeId'.
+     */
+    virtual StatusWith<uint64_t> getDegree(NodeId nodeId) const override;
+
+    /**
+     * Find a page of the neighbors of 'nodeId', in id order.
+     */
+    virtual StatusWith<NodeIdList> getNeighborPage(NodeId nodeId, NodeId from,
+                                                   std::size_t limit) const override;
+
+    /**
+     * Call 'visit' with each neighbor of 'nodeId'.
+     */
+    virtual Status visitNeighbors(NodeId nodeId,
+                                  const std::function<void(NodeId)>& visit) const override;
+
     /**
      * Find the length of the shortest path between 'nodeAId' and 'nodeBId'.
      *
      * Note, since there is no maximum distance, this implementation is
      * unbounded in its time and memory usage.
      */
-    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId,
-                                              NodeId nodeBId) const override;
+    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                              const Cancellation* cancellation = nullptr) const override;
+
+    /**
+     * Apply a batch of operations under one acquisition of the store lock,
+     * and wait for all of its writes to reach 'durability' at once.
+     */
+    virtual std::vector<Status> applyBatch(const std::vector<BatchOperation>& operations,
+                                           Durability durability = Durability::SYNC) override;
 
 
     /**
      * Checkpoint into the checkpoint space.
+     *
+     * The store is snapshotted and the log moved to a new generation, then
+     * the snapshot is written out without holding the store lock.
      */
     Status checkpoint();
 
@@ -95,10 +187,55 @@ public:
 
     friend class CheckpointManager;
 private:
-    BufferManager _bufferManager;
+    // Log 'entry', then 'apply' it to the memory store, and wait for the
+    // entry to reach 'durability'.
+    template <typename Apply>
+    Status logAndApply(LogManager::Entry entry, Durability durability, Apply apply);
+
+    // Get the log entry of a write of a batch, or NO_ACTION for a read.
+    static StatusWith<LogManager::Entry> logEntry(const BatchOperation& operation);
+
+    // Whether the log has filled past the compaction threshold.  Called with
+    // '_lock' held.
+    bool needsCompaction() const;
+
+    // Wake the compactor if the log needs compacting.  Called with '_lock'
+    // held.
+    void checkCompaction();
+
+    // Run continuous compaction until stopped.
+    void compact();
+
+    // Append every entry of 'reader' to 'entries', and close it.
+    void readEntries(LogManager::Reader& reader, std::vector<LogManager::Entry>& entries);
+
+    // Open the checkpoint device of 'layout', unless it is the log device.
+    static std::unique_ptr<BufferManager> openCheckpointDevice(const StorageLayout& layout);
+
+    // Get the ranges of 'layout' with their defaults filled in.
+    std::pair<std::size_t, std::size_t> getLogBlocks(const StorageLayout& layout) const;
+    std::pair<std::size_t, std::size_t> getCheckpointBlocks(const StorageLayout& layout) const;
+
+    BufferManager _logDevice;
+    // Null if checkpoints share the log device.
+    std::unique_ptr<BufferManager> _checkpointDevice;
+
     LogManager _log;
     CheckpointManager _checkpoint;
+    GroupCommit _commit;
     MemoryStore _memoryStore;
 
     mutable std::recursive_mutex _lock;
+
+    // Serializes checkpoints.  Acquired before '_lock'.
+    std::mutex _checkpointLock;
+
+    // Continuous compaction, if the threshold is nonzero.
+    const double _compactionThreshold;
+    // Acquired after '_lock'.
+    std::mutex _compactionMutex;
+    std::condition_variable _compactionRequested;
+    bool _compactionPending = false;
+    bool _stopping = false;
+    std::thread _compactor;
 };
@@ -1,6 +1,8 @@
 #include "db/memory_store.h"
 
+#include <algorithm>
 #include <deque>
+#include <limits>
 #include <mutex>
 #include <utility>
 
@@ -9,45 +11,57 @@
 #include "util/stdx/memory.h"
 #include "util/assert.h"
 
-Status MemoryStore::addNode(NodeId nodeId) {
+// The number of nodes copied out of the base image at a time when releasing
+// it.
+constexpr std::size_t RELEASE_BATCH_SIZE = 1024;
+
+// The number of nodes a search visits between checks of its cancellation.
+constexpr std::size_t CANCELLATION_CHECK_INTERVAL = 4096;
+
+Status MemoryStore::addNode(NodeId nodeId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
+    if (lookupNode(nodeId)) {
+        return StatusCode::NO_ACTION;
+    }
+
+    willModify(nodeId);
     auto inserted = _nodes.emplace(std::piecewise_construct, std::forward_as_tuple(nodeId),
                                    std::forward_as_tuple(stdx::make_unique<Node>(nodeId)));
     return inserted.second ? StatusCode::SUCCESS : StatusCode::NO_ACTION;
 }
 
-Status MemoryStore::removeNode(NodeId nodeId) {
+Status MemoryStore::removeNode(NodeId nodeId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
-    auto it = _nodes.find(nodeId);
-    Node *node = nullptr;
-    if (it == _nodes.end()) {
+    Node *node = lookupNode(nodeId);
+    if (!node) {
         return StatusCode::DOES_NOT_EXIST;
     }
 
-    node = it->second.get();
+    willModify(nodeId);
 
     // Clean up edges
     for (const auto& neighborId : node->edges()) {
-        auto neighbor = _nodes.find(neighborId);
-        invariant(neighbor != _nodes.end());
-        neighbor->second->removeEdge(nodeId);
+        Node *neighbor = lookupNode(neighborId);
+        invariant(neighbor);
+        willModify(neighborId);
+        neighbor->removeEdge(nodeId);
     }
 
-    _nodes.erase(it);
+    eraseNode(nodeId);
     return StatusCode::SUCCESS;
 }
 
 StatusWith<Node*> MemoryStore::findNode(NodeId nodeId) const {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
-    auto it = _nodes.find(nodeId);
-    if (it == _nodes.end()) {
+    Node *node = lookupNode(nodeId);
+    if (!node) {
         return StatusCode::DOES_NOT_EXIST;
     }
 
-    return it->second.get();
+    return node;
 }
 
 StatusWith<std::pair<Node*, Node*>> MemoryStore::getEdge(NodeId nodeAId, NodeId nodeBId) const {
@@ -82,7 +96,7 @@ StatusWith<std::pair<Node*, Node*>> MemoryStore::getEdge(NodeId nodeAId, NodeId
     return StatusCode::DOES_NOT_EXIST;
 }
 
-Status MemoryStore::addEdge(NodeId nodeAId, NodeId nodeBId) {
+Status MemoryStore::addEdge(NodeId nodeAId, NodeId nodeBId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     Node* nodeA = nullptr;
@@ -104,17 +118,21 @@ Status MemoryStore::addEdge(NodeId nodeAId, NodeId nodeBId) {
         return status.getCode();
     }
 
-    if (!nodeA->addEdge(nodeBId)) {
-        invariant(!nodeB->addEdge(nodeAId));
+    if (nodeA->hasEdge(nodeBId)) {
+        invariant(nodeB->hasEdge(nodeAId));
         return StatusCode::NO_ACTION;
     }
 
+    willModify(nodeAId);
+    willModify(nodeBId);
+    invariant(nodeA->addEdge(nodeBId));
+
     invariant(nodeB->addEdge(nodeAId));
 
     return StatusCode::SUCCESS;
 }
 
-Status MemoryStore::removeEdge(NodeId nodeAId, NodeId nodeBId) {
+Status MemoryStore::removeEdge(NodeId nodeAId, NodeId nodeBId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     auto status = getEdge(nodeAId, nodeBId);
@@ -125,6 +143,8 @@ Status MemoryStore::removeEdge(NodeId nodeAId, NodeId nodeBId) {
     Node* nodeA = status->first;
     Node* nodeB = status->second;
 
+    willModify(nodeAId);
+    willModify(nodeBId);
     if (!nodeA->removeEdge(nodeBId)) {
         invariant(!nodeB->removeEdge(nodeAId));
         return StatusCode::DOES_NOT_EXIST;
@@ -135,7 +155,7 @@ Status MemoryStore::removeEdge(NodeId nodeAId, NodeId nodeBId) {
     return StatusCode::SUCCESS;
 }
 
-Status MemoryStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
+Status MemoryStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     Node* nodeLocal = nullptr;
@@ -149,14 +169,17 @@ Status MemoryStore::addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
         return status.getCode();
     }
 
-    if (!nodeLocal->addEdge(nodeRemoteId)) {
+    if (nodeLocal->hasEdge(nodeRemoteId)) {
         return StatusCode::NO_ACTION;
     }
 
+    willModify(nodeLocalId);
+    invariant(nodeLocal->addEdge(nodeRemoteId));
+
     return StatusCode::SUCCESS;
 }
 
-Status MemoryStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
+Status MemoryStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId, Durability) {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     auto status = getEdgePart(nodeLocalId, nodeRemoteId);
@@ -171,6 +194,7 @@ Status MemoryStore::removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) {
        return status.getCode();
     }
 
+    willModify(nodeLocalId);
     if (!nodeLocal->removeEdge(nodeRemoteId)) {
         return StatusCode::DOES_NOT_EXIST;
     }
@@ -195,25 +219,85 @@ Status MemoryStore::getEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) const {
     }
 }
 
-StatusWith<NodeIdList> MemoryStore::getNeighbors(NodeId nodeId) const {
-    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+template <typename Visit>
+bool MemoryStore::visitEdges(NodeId nodeId, Visit visit) const {
+    auto it = _nodes.find(nodeId);
+    if (it != _nodes.end()) {
+        it->second->visitEdges(visit);
+        return true;
+    }
 
-    auto status_with_node = findNode(nodeId);
-    if (!status_with_node) {
-        return status_with_node.getCode();
+    if (!_baseImage || _removedBaseNodes.find(nodeId) != _removedBaseNodes.end()) {
+        return false;
     }
 
-    const Node* node = *status_with_node;
+    std::size_t index = _baseImage->find(nodeId);
+    if (index == CsrImage::npos) {
+        return false;
+    }
+
+    auto edges = _baseImage->getEdges(index);
+    for (const NodeId* edge = edges.first; edge != edges.second; edge++) {
+        visit(*edge);
+    }
+
+    return true;
+}
+
+StatusWith<NodeIdList> MemoryStore::getNeighbors(NodeId nodeId) const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     NodeIdList result;
-    for (const NodeId& nId : node->edges()) {
-        result.push_back(nId);
+    if (!visitEdges(nodeId, [&](NodeId nId) { result.push_back(nId); })) {
+        return StatusCode::DOES_NOT_EXIST;
     }
 
     return result;
 }
 
-StatusWith<uint64_t> MemoryStore::shortestPath(NodeId nodeAId, NodeId nodeBId) const {
+StatusWith<uint64_t> MemoryStore::getDegree(NodeId nodeId) const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+
+    auto it = _nodes.find(nodeId);
+    if (it != _nodes.end()) {
+        return it->second->getEdgeCount();
+    }
+
+    if (!containsNode(nodeId)) {
+        return StatusCode::DOES_NOT_EXIST;
+    }
+
+    auto edges = _baseImage->getEdges(_baseImage->find(nodeId));
+    return static_cast<uint64_t>(edges.second - edges.first);
+}
+
+StatusWith<NodeIdList> MemoryStore::getNeighborPage(NodeId nodeId, NodeId from,
+                                                    std::size_t limit) const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+
+    auto it = _nodes.find(nodeId);
+    if (it != _nodes.end()) {
+        return it->second->getEdgePage(from, limit);
+    }
+
+    if (!containsNode(nodeId)) {
+        return StatusCode::DOES_NOT_EXIST;
+    }
+
+    // The edges of image nodes are in id order.
+    auto edges = _baseImage->getEdges(_baseImage->find(nodeId));
+    const NodeId* first = std::lower_bound(edges.first, edges.second, from);
+    std::size_t count = std::min<std::size_t>(limit, edges.second - first);
+    return NodeIdList(first, first + count);
+}
+
+Status MemoryStore::visitNeighbors(NodeId nodeId, const std::function<void(NodeId)>& visit) const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    return visitEdges(nodeId, visit) ? StatusCode::SUCCESS : StatusCode::DOES_NOT_EXIST;
+}
+
+StatusWith<uint64_t> MemoryStore::shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                               const Cancellation* cancellation) const {
     std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
 
     auto status_with_node = findNode(nodeAId);
@@ -229,32 +313,32 @@ StatusWith<uint64_t> MemoryStore::shortestPath(NodeId nodeAId, NodeId nodeBId) c
        return StatusCode::NO_ACTION;
     }
 
-    const Node* start = *status_with_node;
-
     // A depth first search.
     uint64_t distance = 0;
-    std::deque<const Node*> toSearch = {start};
-    std::deque<const Node*> nextSearch;
+    std::deque<NodeId> toSearch = {nodeAId};
+    std::deque<NodeId> nextSearch;
     std::unordered_set<NodeId> found;
+    std::size_t searched = 0;
 
     while (toSearch.size()) {
-        for (const Node* n : toSearch) {
+        for (const NodeId& n : toSearch) {
             // Check if we found our match.
-            if (n->getId() == nodeBId) {
+            if (n == nodeBId) {
                 return distance++;
             }
 
+            if (cancellation && ++searched % CANCELLATION_CHECK_INTERVAL == 0 &&
+                    cancellation->isCancelled()) {
+                return StatusCode::CANCELLED;
+            }
+
             // Add all the edges of n to nextSearch.
-            for (const NodeId& edgeId : n->edges()) {
-                if (!found.insert(edgeId).second) {
-                    continue;
+            bool exists = visitEdges(n, [&](NodeId edgeId) {
+                if (found.insert(edgeId).second) {
+                    nextSearch.push_back(edgeId);
                 }
-
-                auto edgeIt = _nodes.find(edgeId);
-                invariant(edgeIt != _nodes.end());
-                const Node *edge = edgeIt->second.get();
-                nextSearch.push_back(edge);
-            }
+            });
+            invariant(exists);
         }
 
         distance++;
@@ -264,3 +348,306 @@ StatusWith<uint64_t> MemoryStore::shortestPath(NodeId nodeAId, NodeId nodeBId) c
 
     return StatusCode::NO_ACTION;
 }
+
+std::vector<Status> MemoryStore::applyBatch(const std::vector<BatchOperation>& operations,
+                                            Durability) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+
+    std::vector<Status> result;
+    result.reserve(operations.size());
+    for (const BatchOperation& operation : operations) {
+        result.push_back(applyOperation(operation));
+    }
+
+    return result;
+}
+
+Status MemoryStore::applyOperation(const BatchOperation& operation) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+
+    NodeId nodeAId = operation.nodeAId;
+    NodeId nodeBId = operation.nodeBId;
+    switch (operation.type) {
+        case BatchOperation::Type::ADD_NODE:
+            return addNode(nodeAId);
+        case BatchOperation::Type::REMOVE_NODE:
+            return removeNode(nodeAId);
+        case BatchOperation::Type::GET_NODE:
+            return containsNode(nodeAId) ? StatusCode::SUCCESS : StatusCode::DOES_NOT_EXIST;
+        case BatchOperation::Type::ADD_EDGE:
+            return addEdge(nodeAId, nodeBId);
+        case BatchOperation::Type::REMOVE_EDGE:
+            return removeEdge(nodeAId, nodeBId);
+        case BatchOperation::Type::GET_EDGE:
+            if (nodeAId == nodeBId) {
+                return StatusCode::INVALID;
+            }
+
+            return containsEdge(nodeAId, nodeBId) ? StatusCode::SUCCESS
+                                                  : StatusCode::DOES_NOT_EXIST;
+    }
+
+    return StatusCode::INVALID;
+}
+
+void MemoryStore::beginSnapshot(bool incremental) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    invariant(!_snapshotActive);
+    invariant(!incremental || _trackDirtyNodes);
+
+    _snapshotActive = true;
+    _snapshotIncremental = incremental;
+    _snapshotDone = false;
+    _snapshotNext = std::numeric_limits<NodeId>::min();
+    _snapshotNodeCount = getNodeCount();
+
+    // Later modifications count towards the next snapshot.
+    _snapshotDirtyNodes.assign(_dirtyNodes.begin(), _dirtyNodes.end());
+    std::sort(_snapshotDirtyNodes.begin(), _snapshotDirtyNodes.end());
+    _dirtyNodes.clear();
+}
+
+MemoryStore::SnapshotBatch MemoryStore::readSnapshot(std::size_t limit) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    invariant(_snapshotActive);
+
+    SnapshotBatch batch;
+    std::size_t baseIndex = _baseImage ? _baseImage->lowerBound(_snapshotNext) : 0;
+    std::size_t baseCount = _baseImage ? _baseImage->getNodeCount() : 0;
+    auto nodeIt = _nodes.lower_bound(_snapshotNext);
+    auto snapshotIt = _snapshotNodes.lower_bound(_snapshotNext);
+    auto dirtyIt = std::lower_bound(_snapshotDirtyNodes.begin(),
+                                    _snapshotDirtyNodes.end(), _snapshotNext);
+
+    while (!_snapshotDone && batch.nodes.size() + batch.removed.size() < limit) {
+        NodeId nodeId;
+        if (_snapshotIncremental) {
+            // Visit only the modified nodes, preferring a preserved copy.
+            if (dirtyIt == _snapshotDirtyNodes.end()) {
+                _snapshotDone = true;
+                break;
+            }
+
+            nodeId = *dirtyIt++;
+            const Node* node = nullptr;
+            auto preserved = _snapshotNodes.find(nodeId);
+            if (preserved != _snapshotNodes.end()) {
+                node = preserved->second.get();
+            } else {
+                auto live = _nodes.find(nodeId);
+                if (live != _nodes.end()) {
+                    node = live->second.get();
+                }
+            }
+
+            if (node) {
+                batch.nodes.push_back(*node);
+            } else {
+                batch.removed.push_back(nodeId);
+            }
+
+            if (preserved != _snapshotNodes.end()) {
+                _snapshotNodes.erase(preserved);
+            }
+        } else {
+            // Merge the live nodes, the base image nodes not copied out,
+            // and the preserved snapshot copies.  A preserved copy takes the
+            // place of the live node with the same id.
+            while (baseIndex < baseCount) {
+                NodeId baseId = _baseImage->getNodeId(baseIndex);
+                if (_nodes.find(baseId) == _nodes.end() &&
+                        _removedBaseNodes.find(baseId) == _removedBaseNodes.end()) {
+                    break;
+                }
+
+                baseIndex++;
+            }
+
+            bool nodesLeft = nodeIt != _nodes.end();
+            bool snapshotNodesLeft = snapshotIt != _snapshotNodes.end();
+            bool baseNodesLeft = baseIndex < baseCount;
+            if (!nodesLeft && !snapshotNodesLeft && !baseNodesLeft) {
+                _snapshotDone = true;
+                break;
+            }
+
+            NodeId liveId = nodesLeft ? nodeIt->first : std::numeric_limits<NodeId>::max();
+            NodeId baseId = baseNodesLeft ? _baseImage->getNodeId(baseIndex) :
+                                            std::numeric_limits<NodeId>::max();
+            if (snapshotNodesLeft && (!nodesLeft || snapshotIt->first <= liveId) &&
+                    (!baseNodesLeft || snapshotIt->first <= baseId)) {
+                nodeId = snapshotIt->first;
+                if (snapshotIt->second) {
+                    batch.nodes.push_back(*snapshotIt->second);
+                }
+
+                if (nodesLeft && liveId == nodeId) {
+                    nodeIt++;
+                }
+
+                // Read nodes are never preserved again, so the copy can go.
+                snapshotIt = _snapshotNodes.erase(snapshotIt);
+            } else if (nodesLeft && (!baseNodesLeft || liveId < baseId)) {
+                nodeId = liveId;
+                batch.nodes.push_back(*nodeIt->second);
+                nodeIt++;
+            } else {
+                nodeId = baseId;
+                batch.nodes.push_back(*_baseImage->buildNode(baseIndex));
+                baseIndex++;
+            }
+        }
+
+        if (nodeId == std::numeric_limits<NodeId>::max()) {
+            _snapshotDone = true;
+        } else {
+            _snapshotNext = nodeId + 1;
+        }
+    }
+
+    return batch;
+}
+
+void MemoryStore::endSnapshot(bool persisted) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    invariant(_snapshotActive);
+
+    if (!persisted && _trackDirtyNodes) {
+        _dirtyNodes.insert(_snapshotDirtyNodes.begin(), _snapshotDirtyNodes.end());
+    }
+
+    _snapshotActive = false;
+    _snapshotNodes.clear();
+    _snapshotDirtyNodes.clear();
+}
+
+std::size_t MemoryStore::getSnapshotNodeCount() const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    invariant(_snapshotActive && !_snapshotIncremental);
+    return _snapshotNodeCount;
+}
+
+std::size_t MemoryStore::getNodeCount() const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    return _nodes.size() + _baseNodesRemaining;
+}
+
+void MemoryStore::setBaseImage(std::unique_ptr<CsrImage> image) {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    invariant(_nodes.empty() && !_baseImage);
+
+    _baseNodesRemaining = image->getNodeCount();
+    _baseImage = std::move(image);
+}
+
+bool MemoryStore::hasBaseImage() const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    return _baseImage != nullptr;
+}
+
+void MemoryStore::releaseBaseImage() {
+    for (std::size_t index = 0;; index += RELEASE_BATCH_SIZE) {
+        std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+        if (!_baseImage) {
+            return;
+        }
+
+        std::size_t count = _baseImage->getNodeCount();
+        if (index >= count) {
+            invariant(_baseNodesRemaining == 0);
+            _baseImage.reset();
+            _removedBaseNodes.clear();
+            return;
+        }
+
+        for (std::size_t i = index; i < std::min(index + RELEASE_BATCH_SIZE, count); i++) {
+            lookupNode(_baseImage->getNodeId(i));
+        }
+    }
+}
+
+std::size_t MemoryStore::getDirtyNodeCount() const {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    return _dirtyNodes.size();
+}
+
+void MemoryStore::clearDirtyNodes() {
+    std::lock_guard<std::recursive_mutex> lock(_memoryStoreMutex);
+    _dirtyNodes.clear();
+}
+
+void MemoryStore::willModify(NodeId nodeId) {
+    if (_trackDirtyNodes) {
+        _dirtyNodes.insert(nodeId);
+    }
+
+    // Nodes the snapshot reader has already passed need no copy.
+    if (!_snapshotActive || _snapshotDone || nodeId < _snapshotNext) {
+        return;
+    }
+
+    if (_snapshotIncremental && !std::binary_search(_snapshotDirtyNodes.begin(),
+                                                    _snapshotDirtyNodes.end(), nodeId)) {
+        return;
+    }
+
+    if (_snapshotNodes.find(nodeId) != _snapshotNodes.end()) {
+        return;
+    }
+
+    auto it = _nodes.find(nodeId);
+    if (it == _nodes.end()) {
+        _snapshotNodes.emplace(nodeId, nullptr);
+    } else {
+        _snapshotNodes.emplace(nodeId, stdx::make_unique<Node>(*it->second));
+    }
+}
+
+bool MemoryStore::containsNode(NodeId nodeId) const {
+    if (_nodes.find(nodeId) != _nodes.end()) {
+        return true;
+    }
+
+    return _baseImage && _removedBaseNodes.find(nodeId) == _removedBaseNodes.end() &&
+        _baseImage->find(nodeId) != CsrImage::npos;
+}
+
+bool MemoryStore::containsEdge(NodeId nodeAId, NodeId nodeBId) const {
+    auto it = _nodes.find(nodeAId);
+    if (it != _nodes.end()) {
+        return it->second->hasEdge(nodeBId) && containsNode(nodeBId);
+    }
+
+    bool found = false;
+    bool exists = visitEdges(nodeAId, [&](NodeId edgeId) {
+        found = found || edgeId == nodeBId;
+    });
+
+    return exists && found && containsNode(nodeBId);
+}
+
+Node* MemoryStore::lookupNode(NodeId nodeId) const {
+    auto it = _nodes.find(nodeId);
+    if (it != _nodes.end()) {
+        return it->second.get();
+    }
+
+    if (!_baseImage || _removedBaseNodes.find(nodeId) != _removedBaseNodes.end()) {
+        return nullptr;
+    }
+
+    std::size_t index = _baseImage->find(nodeId);
+    if (index == CsrImage::npos) {
+        return nullptr;
+    }
+
+    _baseNodesRemaining--;
+    return _nodes.emplace(nodeId, _baseImage->buildNode(index)).first->second.get();
+}
+
+void MemoryStore::eraseNode(NodeId nodeId) {
+    _nodes.erase(nodeId);
+    if (_baseImage && _baseImage->find(nodeId) != CsrImage::npos) {
+        _removedBaseNodes.insert(nodeId);
+    }
+}
@@ -4,11 +4,15 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include "db/csr_image.h"
 #include "db/graph_store.h"
 #include "db/types.h"
 #include "util/status.h"
@@ -20,17 +24,40 @@
 class MemoryStore : public GraphStore {
     DISALLOW_COPY(MemoryStore);
 public:
-    MemoryStore() = default;
+    /**
+     * A batch of nodes read from a snapshot.
+     */
+    struct SnapshotBatch {
+        // Nodes present in the snapshot.
+        std::vector<Node> nodes;
+        // Nodes removed since the previous snapshot.  Only incremental
+        // snapshots report removals.
+        NodeIdList removed;
+
+        bool empty() const {
+            return nodes.empty() && removed.empty();
+        }
+    };
+
+    /**
+     * Create a memory store.  If 'trackDirtyNodes' is set, the store tracks
+     * the nodes modified since the previous snapshot, which allows for
+     * incremental snapshots.
+     */
+    explicit MemoryStore(bool trackDirtyNodes = false)
+        : _trackDirtyNodes(trackDirtyNodes) {};
 
     /**
      * Add a node with id `node_id` to the store.
      */
-    virtual Status addNode(NodeId nodeId) override;
+    virtual Status addNode(NodeId nodeId,
+                           Durability durability = Durability::SYNC) override;
 
     /**
      * Remove a node from the store.
      */
-    virtual Status removeNode(NodeId nodeId) override;
+    virtual Status removeNode(NodeId nodeId,
+                              Durability durability = Durability::SYNC) override;
 
     /**
      * Find a node in the store.
@@ -46,12 +73,14 @@ public:
     /**
      * Adds an edge between `nodeAId` and `nodeBId`.
      */
-    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId) override;
+    virtual Status addEdge(NodeId nodeAId, NodeId nodeBId,
+                           Durability durability = Durability::SYNC) override;
 
     /**
      * Remove an edge between 'nodeAId' and 'nodeBId'.
      */
-    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId) override;
+    virtual Status removeEdge(NodeId nodeAId, NodeId nodeBId,
+                              Durability durability = Durability::SYNC) override;
 
     /**
      * Get an edge part between 'nodeLocalId' and 'nodeRemoteId'.
@@ -61,32 +90,192 @@ public:
     /**
      * Adds an edge part between `nodeLocalId` and `nodeRemoteId`.
      */
-    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) override;
+    virtual Status addEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                               Durability durability = Durability::SYNC) override;
 
     /**
      * Remove an edge part between 'nodeLocalId' and 'nodeRemoteId'.
      *
      * Precondition: 'nodeLocalId' is on this partition.
      */
-    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId) override;
+    virtual Status removeEdgePart(NodeId nodeLocalId, NodeId nodeRemoteId,
+                                  Durability durability = Durability::SYNC) override;
 
     /**
      * Find the neighbors of 'nodeId'.
      */
     virtual StatusWith<NodeIdList> getNeighbors(NodeId nodeId) const override;
 
+    /**
+     * Find the number of neighbors of 'nodeId'.
+     */
+    virtual StatusWith<uint64_t> getDegree(NodeId nodeId) const override;
+
+    /**
+     * Find a page of the neighbors of 'nodeId', in id order.  Takes time
+     * logarithmic in the degree, plus 'limit', for nodes of high degree, and
+     * space linear in 'limit'.
+     */
+    virtual StatusWith<NodeIdList> getNeighborPage(NodeId nodeId, NodeId from,
+                                                   std::size_t limit) const override;
+
+    /**
+     * Call 'visit' with each neighbor of 'nodeId'.
+     */
+    virtual Status visitNeighbors(NodeId nodeId,
+                                  const std::function<void(NodeId)>& visit) const override;
+
     /**
      * Find the length of the shortest path between 'nodeAId' and 'nodeBId'.
      *
      * Note, since there is no maximum distance, this implementation is
-     * unbounded in its time and memory usage.
+     * unbounded in its time and memory usage.  'cancellation' is checked
+     * every few thousand nodes searched, and the store lock released once
+     * it is cancelled.
      */
-    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId,
-                                              NodeId nodeBId) const override;
+    virtual StatusWith<uint64_t> shortestPath(NodeId nodeAId, NodeId nodeBId,
+                                              const Cancellation* cancellation = nullptr) const override;
+
+    /**
+     * Apply a batch of operations under one acquisition of the store lock.
+     * Gets are answered without copying nodes out of the base image.
+     */
+    virtual std::vector<Status> applyBatch(const std::vector<BatchOperation>& operations,
+                                           Durability durability = Durability::SYNC) override;
+
+    /**
+     * Apply a single operation of a batch.
+     */
+    Status applyOperation(const BatchOperation& operation);
+
+    /**
+     * Get the number of nodes in the store.
+     */
+    std::size_t getNodeCount() const;
+
+    /**
+     * Serve the nodes of 'image' from it, rather than loading them all.  A
+     * node is copied out of the image the first time it is accessed as a
+     * `Node`, and kept in memory from then on.
+     *
+     * Precondition: the store is empty.
+     */
+    void setBaseImage(std::unique_ptr<CsrImage> image);
+
+    /**
+     * Whether nodes are served from a base image.
+     */
+    bool hasBaseImage() const;
+
+    /**
+     * Copy the nodes still served from the base image into memory, and
+     * release the image.  Writers are only blocked for a batch of nodes at
+     * a time.
+     */
+    void releaseBaseImage();
+
+    /**
+     * Take a point-in-time snapshot of the store.
+     *
+     * While the snapshot is active, mutations preserve a copy of each node
+     * they touch, so the snapshot can be read with 'readSnapshot' without
+     * blocking writers.  Only one snapshot may be active at a time.
+     *
+     * An incremental snapshot only holds the nodes modified since the
+     * previous snapshot, and requires dirty node tracking.
+     */
+    void beginSnapshot(bool incremental = false);
+
+    /**
+     * Read up to 'limit' nodes of the active snapshot, in node id order,
+     * continuing from where the previous call left off.
+     *
+     * Returns an empty batch once the whole snapshot has been read.
+     */
+    SnapshotBatch readSnapshot(std::size_t limit);
+
+    /**
+     * Get the number of nodes in the active snapshot.  Only valid for full
+     * snapshots.
+     */
+    std::size_t getSnapshotNodeCount() const;
+
+    /**
+     * Release the active snapshot.
+     *
+     * If the snapshot was not 'persisted', its modified nodes are tracked
+     * as dirty again, so the next incremental snapshot includes them.
+     */
+    void endSnapshot(bool persisted = true);
+
+    /**
+     * Get the number of nodes modified since the previous snapshot.
+     */
+    std::size_t getDirtyNodeCount() const;
+
+    /**
+     * Forget the modified nodes, after the store has been restored to a
+     * state that is already persisted.
+     */
+    void clearDirtyNodes();
 
     friend class CheckpointManager;
+    friend class LogReplayer;
 private:
-    std::map<NodeId, std::unique_ptr<Node>> _nodes;
+    // Track that 'nodeId' is about to be modified.
+    void willModify(NodeId nodeId);
+
+    // Get the node 'nodeId', copying it out of the base image if needed.
+    // Returns null if the node does not exist.
+    Node* lookupNode(NodeId nodeId) const;
+
+    // Call 'visit' with each edge of 'nodeId', without copying the node out
+    // of the base image.  Returns false if the node does not exist.
+    template <typename Visit>
+    bool visitEdges(NodeId nodeId, Visit visit) const;
+
+    // Whether 'nodeId' exists, without copying it out of the base image.
+    bool containsNode(NodeId nodeId) const;
+
+    // Whether the edge exists, without copying its nodes out of the base
+    // image.
+    bool containsEdge(NodeId nodeAId, NodeId nodeBId) const;
+
+    // Remove 'nodeId' from the in memory nodes, and from the base image.
+    void eraseNode(NodeId nodeId);
+
+    // Nodes are copied out of the base image on first access, even by const
+    // operations.
+    mutable std::map<NodeId, std::unique_ptr<Node>> _nodes;
+
+    // The image nodes not in '_nodes' are served from, if any.
+    std::unique_ptr<CsrImage> _baseImage;
+    // Nodes of the base image which have been removed.
+    std::unordered_set<NodeId> _removedBaseNodes;
+    // The number of base image nodes neither copied out nor removed.
+    mutable std::size_t _baseNodesRemaining = 0;
+
+    // Whether modified nodes are tracked.
+    const bool _trackDirtyNodes;
+    // Nodes modified since the previous snapshot.
+    std::unordered_set<NodeId> _dirtyNodes;
+
+    // Whether a snapshot is active.
+    bool _snapshotActive = false;
+    // Whether the active snapshot is incremental.
+    bool _snapshotIncremental = false;
+    // The sorted nodes modified before the active snapshot was taken.
+    NodeIdList _snapshotDirtyNodes;
+    // The number of nodes when the active snapshot was taken.
+    std::size_t _snapshotNodeCount = 0;
+    // Whether every node of the snapshot has been read.
+    bool _snapshotDone = false;
+    // The lowest node id not yet returned by 'readSnapshot'.
+    NodeId _snapshotNext = 0;
+    // Snapshot copies of nodes modified since the snapshot was taken, which
+    // have not been read yet.  A null entry marks a node that did not exist
+    // when the snapshot was taken.
+    std::map<NodeId, std::unique_ptr<Node>> _snapshotNodes;
 
     mutable std::recursive_mutex _memoryStoreMutex;
 };
@@ -1,10 +1,15 @@
 #include "util/testing.h"
 
 #include <algorithm>
+#include <limits>
+#include <vector>
 
+#include "db/csr_image.h"
 #include "db/memory_store.h"
 #include "db/types.h"
+#include "util/cancellation.h"
 #include "util/status.h"
+#include "util/stdx/memory.h"
 
 TEST(MemoryStoreAddNode) {
     MemoryStore store;
@@ -157,6 +162,260 @@ TEST(MemoryStoreShortestPath) {
     END;
 }
 
+TEST(MemoryStoreCancelShortestPath) {
+    MemoryStore store;
+
+    const NodeId length = 10000;
+    for (NodeId nodeId = 0; nodeId <= length; nodeId++) {
+        EXPECT_TRUE(store.addNode(nodeId));
+    }
+    for (NodeId nodeId = 0; nodeId < length; nodeId++) {
+        EXPECT_TRUE(store.addEdge(nodeId, nodeId + 1));
+    }
+
+    Cancellation cancellation;
+    auto status_with_len = store.shortestPath(0, length, &cancellation);
+    EXPECT_TRUE(status_with_len);
+    EXPECT_EQ(*status_with_len, length);
+
+    cancellation.setDeadline(Cancellation::Clock::now());
+    EXPECT_TRUE(store.shortestPath(0, length, &cancellation) == StatusCode::CANCELLED);
+
+    Cancellation cancelled;
+    cancelled.cancel();
+    EXPECT_TRUE(store.shortestPath(0, length, &cancelled) == StatusCode::CANCELLED);
+
+    // Short searches finish before checking.
+    EXPECT_TRUE(store.shortestPath(0, 2, &cancelled));
+
+    END;
+}
+
+TEST(MemoryStoreSnapshot) {
+    MemoryStore store;
+
+    EXPECT_TRUE(store.addNode(1));
+    EXPECT_TRUE(store.addNode(2));
+    EXPECT_TRUE(store.addNode(3));
+    EXPECT_TRUE(store.addEdge(1, 2));
+
+    store.beginSnapshot();
+
+    // Mutations after the snapshot must not be visible in it.
+    EXPECT_TRUE(store.addNode(4));
+    EXPECT_TRUE(store.addEdge(2, 3));
+    EXPECT_TRUE(store.removeNode(1));
+
+    std::vector<Node> nodes = store.readSnapshot(2).nodes;
+    EXPECT_EQ(nodes.size(), 2);
+
+    // Changes to nodes not yet read are still hidden.
+    EXPECT_TRUE(store.addEdge(3, 4));
+
+    std::vector<Node> batch = store.readSnapshot(2).nodes;
+    nodes.insert(nodes.end(), batch.begin(), batch.end());
+    EXPECT_TRUE(store.readSnapshot(2).empty());
+
+    store.endSnapshot();
+
+    EXPECT_EQ(nodes.size(), 3);
+    EXPECT_EQ(nodes[0].getId(), 1);
+    EXPECT_TRUE(nodes[0].hasEdge(2));
+    EXPECT_EQ(nodes[1].getId(), 2);
+    EXPECT_TRUE(nodes[1].hasEdge(1));
+    EXPECT_FALSE(nodes[1].hasEdge(3));
+    EXPECT_EQ(nodes[2].getId(), 3);
+    EXPECT_EQ(nodes[2].edges().size(), 0);
+
+    EXPECT_FALSE(store.findNode(1));
+    EXPECT_TRUE(store.getEdge(2, 3));
+
+    END;
+}
+
+TEST(MemoryStoreIncrementalSnapshot) {
+    MemoryStore store(true);
+
+    EXPECT_TRUE(store.addNode(1));
+    EXPECT_TRUE(store.addNode(2));
+    EXPECT_TRUE(store.addNode(3));
+    store.clearDirtyNodes();
+
+    EXPECT_TRUE(store.addEdge(1, 2));
+    EXPECT_TRUE(store.removeNode(3));
+    EXPECT_EQ(store.getDirtyNodeCount(), 3);
+
+    // A failed checkpoint keeps the nodes dirty.
+    store.beginSnapshot(true);
+    EXPECT_EQ(store.getDirtyNodeCount(), 0);
+    store.endSnapshot(false);
+    EXPECT_EQ(store.getDirtyNodeCount(), 3);
+
+    store.beginSnapshot(true);
+
+    // Nodes modified after the snapshot are left for the next one.
+    EXPECT_TRUE(store.addNode(4));
+    EXPECT_TRUE(store.removeEdge(1, 2));
+
+    auto batch = store.readSnapshot(10);
+    EXPECT_EQ(batch.nodes.size(), 2);
+    EXPECT_EQ(batch.nodes[0].getId(), 1);
+    EXPECT_TRUE(batch.nodes[0].hasEdge(2));
+    EXPECT_EQ(batch.nodes[1].getId(), 2);
+    EXPECT_EQ(batch.removed.size(), 1);
+    EXPECT_EQ(batch.removed[0], 3);
+    EXPECT_TRUE(store.readSnapshot(10).empty());
+
+    store.endSnapshot(true);
+    EXPECT_EQ(store.getDirtyNodeCount(), 3);
+
+    END;
+}
+
+TEST(MemoryStoreBaseImage) {
+    // Nodes 1, 2 and 5, with edges 1-2 and 2-5, in 64 byte blocks.
+    std::vector<uint64_t> data = {
+        1, 2, 5, 0, 0, 0, 0, 0,
+        0, 1, 3, 4, 0, 0, 0, 0,
+        2, 1, 5, 2, 0, 0, 0, 0
+    };
+    MemoryStore store;
+    store.setBaseImage(stdx::make_unique<CsrImage>(std::move(data), 3, 64));
+
+    EXPECT_EQ(store.getNodeCount(), 3);
+    EXPECT_EQ(store.getNeighbors(2)->size(), 2);
+    EXPECT_FALSE(store.findNode(3));
+    EXPECT_TRUE(store.getEdge(1, 2));
+
+    EXPECT_TRUE(store.removeNode(5));
+    EXPECT_FALSE(store.findNode(5));
+    EXPECT_EQ(store.getNeighbors(2)->size(), 1);
+    EXPECT_TRUE(store.addNode(5));
+    EXPECT_EQ(store.getNeighbors(5)->size(), 0);
+    EXPECT_EQ(store.getNodeCount(), 3);
+
+    store.beginSnapshot();
+    EXPECT_EQ(store.getSnapshotNodeCount(), 3);
+    auto nodes = store.readSnapshot(10).nodes;
+    store.endSnapshot();
+    EXPECT_EQ(nodes.size(), 3);
+    EXPECT_EQ(nodes[2].getId(), 5);
+
+    store.releaseBaseImage();
+    EXPECT_FALSE(store.hasBaseImage());
+    EXPECT_TRUE(store.getEdge(1, 2));
+    EXPECT_EQ(store.getNodeCount(), 3);
+
+    END;
+}
+
+TEST(MemoryStoreApplyBatch) {
+    // Nodes 1, 2 and 5, with edges 1-2 and 2-5, in 64 byte blocks.
+    std::vector<uint64_t> data = {
+        1, 2, 5, 0, 0, 0, 0, 0,
+        0, 1, 3, 4, 0, 0, 0, 0,
+        2, 1, 5, 2, 0, 0, 0, 0
+    };
+    MemoryStore store;
+    store.setBaseImage(stdx::make_unique<CsrImage>(std::move(data), 3, 64));
+
+    using Type = BatchOperation::Type;
+    std::vector<BatchOperation> operations = {
+        {Type::GET_NODE, 1},
+        {Type::GET_EDGE, 2, 5},
+        {Type::ADD_NODE, 7},
+        {Type::ADD_NODE, 7},
+        {Type::ADD_EDGE, 7, 1},
+        {Type::GET_EDGE, 1, 7},
+        {Type::REMOVE_EDGE, 1, 5},
+        {Type::GET_NODE, 3},
+    };
+    auto statuses = store.applyBatch(operations);
+
+    EXPECT_EQ(statuses.size(), operations.size());
+    EXPECT_TRUE(statuses[0]);
+    EXPECT_TRUE(statuses[1]);
+    EXPECT_TRUE(statuses[2]);
+    EXPECT_TRUE(statuses[3] == StatusCode::NO_ACTION);
+    EXPECT_TRUE(statuses[4]);
+    EXPECT_TRUE(statuses[5]);
+    EXPECT_FALSE(statuses[6]);
+    EXPECT_TRUE(statuses[7] == StatusCode::DOES_NOT_EXIST);
+
+    END;
+}
+
+TEST(MemoryStoreNeighborPages) {
+    // Nodes 1, 2 and 5, with edges 1-2 and 2-5, in 64 byte blocks.
+    std::vector<uint64_t> data = {
+        1, 2, 5, 0, 0, 0, 0, 0,
+        0, 1, 3, 4, 0, 0, 0, 0,
+        2, 1, 5, 2, 0, 0, 0, 0
+    };
+    MemoryStore store;
+    store.setBaseImage(stdx::make_unique<CsrImage>(std::move(data), 3, 64));
+
+    EXPECT_EQ(*store.getDegree(2), 2);
+    EXPECT_TRUE(store.getDegree(3) == StatusCode::DOES_NOT_EXIST);
+    EXPECT_TRUE(store.hasBaseImage());
+
+    // Pages of image nodes are found in the image.
+    EXPECT_TRUE(*store.getNeighborPage(2, 2, 3) == NodeIdList({5}));
+
+    for (NodeId nodeId = 10; nodeId > 5; nodeId--) {
+        EXPECT_TRUE(store.addNode(nodeId));
+        EXPECT_TRUE(store.addEdge(2, nodeId));
+    }
+    EXPECT_EQ(*store.getDegree(2), 7);
+
+    auto page = store.getNeighborPage(2, std::numeric_limits<NodeId>::min(), 3);
+    EXPECT_TRUE(page);
+    EXPECT_TRUE(*page == NodeIdList({1, 5, 6}));
+
+    page = store.getNeighborPage(2, 7, 3);
+    EXPECT_TRUE(*page == NodeIdList({7, 8, 9}));
+
+    page = store.getNeighborPage(2, 10, 3);
+    EXPECT_TRUE(*page == NodeIdList({10}));
+
+    std::size_t visited = 0;
+    EXPECT_TRUE(store.visitNeighbors(2, [&](NodeId) { visited++; }));
+    EXPECT_EQ(visited, 7);
+    EXPECT_FALSE(store.getNeighborPage(3, 0, 3));
+
+    END;
+}
+
+TEST(MemoryStoreLargeNeighborPage) {
+    MemoryStore store;
+    const NodeId count = Node::ORDERED_EDGES_MIN + 100;
+    for (NodeId nodeId = 0; nodeId <= count; nodeId++) {
+        EXPECT_TRUE(store.addNode(nodeId));
+    }
+
+    for (NodeId nodeId = count; nodeId > 0; nodeId--) {
+        EXPECT_TRUE(store.addEdge(0, nodeId));
+    }
+
+    auto page = store.getNeighborPage(0, 1000, 3);
+    EXPECT_TRUE(*page == NodeIdList({1000, 1001, 1002}));
+    page = store.getNeighborPage(0, count - 1, 3);
+    EXPECT_TRUE(*page == NodeIdList({count - 1, count}));
+
+    EXPECT_TRUE(store.removeEdge(0, 1001));
+    page = store.getNeighborPage(0, 1000, 3);
+    EXPECT_TRUE(*page == NodeIdList({1000, 1002, 1003}));
+
+    // Pages stay in order once the node is small again.
+    for (NodeId nodeId = count; nodeId > 10; nodeId--) {
+        store.removeEdge(0, nodeId);
+    }
+    page = store.getNeighborPage(0, 5, 10);
+    EXPECT_TRUE(*page == NodeIdList({5, 6, 7, 8, 9, 10}));
+
+    END;
+}
+
 int main() {
     MemoryStoreAddNode();
     MemoryStoreRemoveNode();
@@ -165,4 +424,11 @@ int main() {
     MemoryStoreRemoveEdge();
     MemoryStoreGetNeighbors();
     MemoryStoreShortestPath();
+    MemoryStoreCancelShortestPath();
+    MemoryStoreSnapshot();
+    MemoryStoreIncrementalSnapshot();
+    MemoryStoreBaseImage();
+    MemoryStoreApplyBatch();
+    MemoryStoreNeighborPages();
+    MemoryStoreLargeNeighborPage();
 }
@@ -1,7 +1,19 @@
 #include "db/types.h"
 
+#include <algorithm>
 #include <unordered_set>
 
+#include "util/stdx/memory.h"
+
+const std::size_t Node::ORDERED_EDGES_MIN;
+
+Node& Node::operator=(const Node& other) {
+    _id = other._id;
+    _edges = other._edges;
+    _orderedEdges.reset();
+    return *this;
+}
+
 NodeId Node::getId() const {
     return _id;
 }
@@ -11,7 +23,17 @@ std::unordered_set<NodeId> Node::edges() const {
 }
 
 bool Node::addEdge(NodeId node) {
-    return _edges.insert(node).second;
+    if (!_edges.insert(node).second) {
+        return false;
+    }
+
+    if (_orderedEdges) {
+        _orderedEdges->insert(node);
+    } else if (_edges.size() >= ORDERED_EDGES_MIN) {
+        _orderedEdges = stdx::make_unique<std::set<NodeId>>(_edges.begin(), _edges.end());
+    }
+
+    return true;
 }
 
 bool Node::removeEdge(NodeId node) {
@@ -21,9 +43,55 @@ bool Node::removeEdge(NodeId node) {
     }
 
     _edges.erase(it);
+    if (_orderedEdges) {
+        _orderedEdges->erase(node);
+        if (_edges.size() < ORDERED_EDGES_MIN / 2) {
+            _orderedEdges.reset();
+        }
+    }
+
     return true;
 }
 
 bool Node::hasEdge(NodeId node) const {
     return _edges.find(node) != _edges.end();
 }
+
+void Node::reserveEdges(std::size_t count) {
+    _edges.reserve(count);
+}
+
+std::size_t Node::getEdgeCount() const {
+    return _edges.size();
+}
+
+NodeIdList Node::getEdgePage(NodeId from, std::size_t limit) const {
+    NodeIdList page;
+    if (_orderedEdges) {
+        for (auto it = _orderedEdges->lower_bound(from);
+                it != _orderedEdges->end() && page.size() < limit; ++it) {
+            page.push_back(*it);
+        }
+
+        return page;
+    }
+
+    // Keep the lowest 'limit' ids seen in a max heap.
+    for (NodeId edgeId : _edges) {
+        if (edgeId < from || limit == 0) {
+            continue;
+        }
+
+        if (page.size() < limit) {
+            page.push_back(edgeId);
+            std::push_heap(page.begin(), page.end());
+        } else if (edgeId < page.front()) {
+            std::pop_heap(page.begin(), page.end());
+            page.back() = edgeId;
+            std::push_heap(page.begin(), page.end());
+        }
+    }
+
+    std::sort_heap(page.begin(), page.end());
+    return page;
+}
@@ -2,15 +2,30 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <set>
 #include <unordered_set>
 #include <vector>
 
 using NodeId = int64_t;
 
+using NodeIdList = std::vector<NodeId>;
+
 class Node {
 public:
+    // The number of edges from which a node also keeps them in id order.
+    static const std::size_t ORDERED_EDGES_MIN = 4096;
+
     Node(NodeId id) : _id(id) {};
+
+    // Copies leave out the edges in id order, which are rebuilt as needed.
+    Node(const Node& other) : _id(other._id), _edges(other._edges) {}
+    Node& operator=(const Node& other);
+    Node(Node&& other) = default;
+    Node& operator=(Node&& other) = default;
+
     NodeId getId() const;
 
     std::unordered_set<NodeId> edges() const;
@@ -29,6 +44,34 @@ public:
      * Return true if there is an edge to 'node'.
      */
     bool hasEdge(NodeId node) const;
+
+    /**
+     * Reserve space for 'count' edges.
+     */
+    void reserveEdges(std::size_t count);
+
+    /**
+     * Return the number of edges.
+     */
+    std::size_t getEdgeCount() const;
+
+    /**
+     * Find up to 'limit' edges of at least 'from', in id order.  Takes time
+     * logarithmic in the number of edges, plus 'limit', for nodes with at
+     * least `ORDERED_EDGES_MIN` of them, and linear for smaller ones.
+     */
+    NodeIdList getEdgePage(NodeId from, std::size_t limit) const;
+
+    /**
+     * Call 'visit' with each edge, without copying them.  'visit' may not
+     * modify this node.
+     */
+    template <typename Visit>
+    void visitEdges(Visit visit) const {
+        for (const NodeId& edgeId : _edges) {
+            visit(edgeId);
+        }
+    }
 private:
     NodeId _id;
 
@@ -39,6 +82,10 @@ private:
      * The lifetime of the edges must extend that of this node.
      */
     std::unordered_set<NodeId> _edges;
-};
 
-using NodeIdList = std::vector<NodeId>;
+    /**
+     * The edges again, in id order, for nodes with many of them, or null.
+     * Dropped once fewer than half of `ORDERED_EDGES_MIN` are left.
+     */
+    std::unique_ptr<std::set<NodeId>> _orderedEdges;
+};
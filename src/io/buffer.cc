@@ -1,37 +1,37 @@
 #include "io/buffer.h"
 
-#include <sys/mman.h>
+#include <cstring>
 
+#include "io/buffer_allocator.h"
+#include "io/buffer_manager.h"
 #include "util/assert.h"
 
-#if defined(__APPLE__) && defined(__MACH__)
-#define _MAP_ANONYMOUS MAP_ANON
-#else
-#define _MAP_ANONYMOUS MAP_ANONYMOUS
-#endif
-
 Buffer::Buffer(std::size_t size, uint64_t blockNum) :
         _data(nullptr), _size(size), _blockNum(blockNum) {
-    _data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
-                 MAP_PRIVATE | _MAP_ANONYMOUS, 0, 0);
-    if (_data == MAP_FAILED) {
-        check_errno(-1);
-    }
+    _data = BufferAllocator::allocate(size);
+    std::memset(_data, 0, size);
 }
 
+Buffer::Buffer(const BufferManager* manager, std::size_t frame, void* data,
+               std::size_t size, uint64_t blockNum) :
+        _data(data), _size(size), _blockNum(blockNum), _manager(manager),
+        _frame(frame) {}
+
 Buffer::Buffer(Buffer&& other) : _data(other._data), _size(other._size),
-                                       _blockNum(other._blockNum) {
+                                       _blockNum(other._blockNum),
+                                       _manager(other._manager),
+                                       _frame(other._frame) {
     other._data = nullptr;
 }
 
 Buffer& Buffer::operator=(Buffer&& other) {
-    if (_data) {
-        check_errno(munmap(_data, _size));
-    }
+    release();
 
     _data = other._data;
     _size = other._size;
     _blockNum = other._blockNum;
+    _manager = other._manager;
+    _frame = other._frame;
 
     other._data = nullptr;
 
@@ -39,9 +39,21 @@ Buffer& Buffer::operator=(Buffer&& other) {
 }
 
 Buffer::~Buffer() {
-    if (_data) {
-        check_errno(munmap(_data, _size));
+    release();
+}
+
+void Buffer::release() {
+    if (!_data) {
+        return;
+    }
+
+    if (_manager) {
+        _manager->unpin(_frame);
+    } else {
+        BufferAllocator::release(_data, _size);
     }
+
+    _data = nullptr;
 }
 
 void * Buffer::getRaw() const {
@@ -5,8 +5,13 @@
 
 #include "util/nocopy.h"
 
+class BufferManager;
+
 /**
  * Represents a region of disk space.  Obtainable through the `BufferManager`.
+ *
+ * A buffer either pins a frame of the `BufferManager`'s pool, which is
+ * shared by all buffers of the same block, or owns its memory.
  */
 class Buffer {
     DISALLOW_COPY(Buffer);
@@ -28,9 +33,21 @@ public:
 
     friend class BufferManager;
 private:
+    // Create a buffer owning its memory.
     Buffer(std::size_t size, uint64_t blockNum);
 
+    // Create a buffer pinning frame 'frame' of 'manager', at 'data'.
+    Buffer(const BufferManager* manager, std::size_t frame, void* data,
+           std::size_t size, uint64_t blockNum);
+
+    // Release the memory or frame of the buffer.
+    void release();
+
     void *_data;
     std::size_t _size;
     uint64_t _blockNum;
+
+    // The manager whose frame is pinned, or null if the memory is owned.
+    const BufferManager* _manager = nullptr;
+    std::size_t _frame = 0;
 };
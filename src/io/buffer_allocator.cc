@@ -0,0 +1,151 @@
+#include "io/buffer_allocator.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "util/assert.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#define _MAP_ANONYMOUS MAP_ANON
+#else
+#define _MAP_ANONYMOUS MAP_ANONYMOUS
+#endif
+
+const std::size_t BufferAllocator::ALIGNMENT;
+const std::size_t BufferAllocator::HUGE_PAGE_SIZE;
+
+namespace {
+
+// The most free allocations of a size kept by a thread.
+const std::size_t THREAD_CACHE_MAX = 64;
+
+// The number of allocations moved between a thread and the shared lists at
+// once.
+const std::size_t TRANSFER_BATCH = THREAD_CACHE_MAX / 2;
+
+typedef std::unordered_map<std::size_t, std::vector<void*>> FreeLists;
+
+/**
+ * Free allocations shared between threads.
+ */
+struct SharedLists {
+    std::mutex mutex;
+    FreeLists lists;
+};
+
+SharedLists& sharedLists() {
+    // Never destroyed, since threads return their lists when they exit,
+    // which may be after static destruction.
+    static SharedLists* shared = new SharedLists();
+    return *shared;
+}
+
+// Move up to 'count' allocations from the back of 'from' to 'to'.
+void transfer(std::vector<void*>& from, std::vector<void*>& to, std::size_t count) {
+    count = std::min(count, from.size());
+    to.insert(to.end(), from.end() - count, from.end());
+    from.resize(from.size() - count);
+}
+
+/**
+ * The free allocations of a thread.
+ */
+struct ThreadCache {
+    ~ThreadCache() {
+        SharedLists& shared = sharedLists();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (auto& list : lists) {
+            transfer(list.second, shared.lists[list.first], list.second.size());
+        }
+    }
+
+    FreeLists lists;
+};
+
+thread_local ThreadCache threadCache;
+
+// The length of the mapping of an allocation of 'size' bytes.  Huge page
+// mappings must be unmapped in whole huge pages, so all are rounded up to
+// them.
+std::size_t mappedSize(std::size_t size) {
+    const std::size_t pageSize = BufferAllocator::HUGE_PAGE_SIZE;
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+void* mapHuge(std::size_t size) {
+    size = mappedSize(size);
+
+    void* data = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | _MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (data == MAP_FAILED) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | _MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            check_errno(-1);
+        }
+#ifdef MADV_HUGEPAGE
+        // Transparent huge pages are only a hint.
+        madvise(data, size, MADV_HUGEPAGE);
+#endif
+    }
+
+    return data;
+}
+
+} // namespace
+
+void* BufferAllocator::allocate(std::size_t size) {
+    if (size >= HUGE_PAGE_SIZE) {
+        return mapHuge(size);
+    }
+
+    std::vector<void*>& list = threadCache.lists[size];
+    if (list.empty()) {
+        SharedLists& shared = sharedLists();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        auto sharedList = shared.lists.find(size);
+        if (sharedList != shared.lists.end()) {
+            transfer(sharedList->second, list, TRANSFER_BATCH);
+        }
+    }
+
+    if (!list.empty()) {
+        void* data = list.back();
+        list.pop_back();
+        return data;
+    }
+
+    void* data = nullptr;
+    int error = posix_memalign(&data, ALIGNMENT, size);
+    if (error) {
+        errno = error;
+        check_errno(-1);
+    }
+
+    return data;
+}
+
+void BufferAllocator::release(void* data, std::size_t size) {
+    if (size >= HUGE_PAGE_SIZE) {
+        check_errno(munmap(data, mappedSize(size)));
+        return;
+    }
+
+    std::vector<void*>& list = threadCache.lists[size];
+    list.push_back(data);
+
+    if (list.size() > THREAD_CACHE_MAX) {
+        SharedLists& shared = sharedLists();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        transfer(list, shared.lists[size], TRANSFER_BATCH);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Allocates the memory of buffers, aligned for direct I/O.
+ *
+ * Freed memory is kept on per-thread free lists, by size, and reused by
+ * later allocations instead of being returned to the system.  Threads with
+ * too much free memory hand some of it to a shared list, where other threads
+ * pick it up.
+ *
+ * Allocations of at least `HUGE_PAGE_SIZE` are mapped directly, backed by
+ * huge pages where the system allows it, and are not recycled.
+ *
+ * Memory returned by `allocate` is not zeroed.  The allocator is thread-safe.
+ */
+class BufferAllocator {
+public:
+    // The alignment of all allocations.
+    static const std::size_t ALIGNMENT = 4096;
+
+    // The smallest allocation which is backed by huge pages.
+    static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /**
+     * Allocate `size` bytes, aligned to `ALIGNMENT`.
+     */
+    static void* allocate(std::size_t size);
+
+    /**
+     * Release `data`, which must have been returned by `allocate` for
+     * `size` bytes.
+     */
+    static void release(void* data, std::size_t size);
+};
@@ -0,0 +1,54 @@
+#include "util/testing.h"
+
+#include <cstdint>
+#include <thread>
+
+#include "io/buffer_allocator.h"
+
+TEST(BufferAllocatorReuse) {
+    void* first = BufferAllocator::allocate(4096);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % BufferAllocator::ALIGNMENT, 0);
+    BufferAllocator::release(first, 4096);
+
+    // Freed memory of the same size is reused by the thread.
+    void* second = BufferAllocator::allocate(4096);
+    EXPECT_EQ(second, first);
+
+    // Memory freed by an exiting thread is picked up by others.
+    void* other = nullptr;
+    std::thread thread([&other] {
+        other = BufferAllocator::allocate(8192);
+        BufferAllocator::release(other, 8192);
+    });
+    thread.join();
+    void* third = BufferAllocator::allocate(8192);
+    EXPECT_EQ(third, other);
+
+    void* huge = BufferAllocator::allocate(BufferAllocator::HUGE_PAGE_SIZE);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(huge) % BufferAllocator::ALIGNMENT, 0);
+    static_cast<char*>(huge)[BufferAllocator::HUGE_PAGE_SIZE - 1] = 1;
+
+    BufferAllocator::release(second, 4096);
+    BufferAllocator::release(third, 8192);
+    BufferAllocator::release(huge, BufferAllocator::HUGE_PAGE_SIZE);
+
+    END;
+}
+
+TEST(BufferAllocatorHugeUnaligned) {
+    // Sizes between whole huge pages, as of a pool of 600 frames.
+    const std::size_t sizes[] = {BufferAllocator::HUGE_PAGE_SIZE + 4096, 600 * 4096};
+    for (std::size_t size : sizes) {
+        void* data = BufferAllocator::allocate(size);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % BufferAllocator::ALIGNMENT, 0);
+        static_cast<char*>(data)[size - 1] = 1;
+        BufferAllocator::release(data, size);
+    }
+
+    END;
+}
+
+int main() {
+    BufferAllocatorReuse();
+    BufferAllocatorHugeUnaligned();
+}
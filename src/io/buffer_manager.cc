@@ -2,6 +2,11 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 
 #if defined(__APPLE__) && defined(__MACH__)
 #include <sys/disk.h>
@@ -10,37 +15,105 @@
 #endif
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "io/buffer_allocator.h"
+#include "io/io_queue.h"
 #include "platform_params.h"
 #include "util/assert.h"
 #include "util/status.h"
 
-BufferManager::BufferManager(const char* devicePath)
-        : _devFd(0), _blockSize(Platform::BUFFER_BLOCK_SIZE) {
+namespace {
+
+// Describe the memory of the first `count` of `buffers`.
+std::vector<iovec> regions(const std::vector<Buffer>& buffers, std::size_t count) {
+    std::vector<iovec> iov(count);
+    for (std::size_t i = 0; i < count; i++) {
+        iov[i].iov_base = buffers[i].getRaw();
+        iov[i].iov_len = buffers[i].size();
+    }
+
+    return iov;
+}
+
+BufferManager::Options withPoolFrames(std::size_t poolFrames) {
+    BufferManager::Options options;
+    options.poolFrames = poolFrames;
+    return options;
+}
+
+std::future<Status> ready(Status status) {
+    std::promise<Status> promise;
+    promise.set_value(status);
+    return promise.get_future();
+}
+
+} // namespace
+
+const std::size_t BufferManager::DEFAULT_POOL_FRAMES;
+const std::size_t BufferManager::NO_FRAME;
+
+BufferManager::BufferManager(const char* devicePath, std::size_t poolFrames)
+        : BufferManager(devicePath, withPoolFrames(poolFrames)) {}
+
+BufferManager::BufferManager(const char* devicePath, const Options& options)
+        : _devFd(0), _blockSize(Platform::BUFFER_BLOCK_SIZE),
+          _syncPolicy(options.syncPolicy), _frames(options.poolFrames) {
+    int flags = O_RDWR;
+    if (options.fileBlocks) {
+        flags |= O_CREAT;
+    }
+    if (_syncPolicy == SyncPolicy::SYNC) {
+        flags |= O_DSYNC;
+    }
+
 #if defined(__APPLE__) && defined(__MACH__)
-    _devFd = open(devicePath, O_SYNC | O_RDWR);
+    _devFd = open(devicePath, flags, 0644);
     check_errno(_devFd);
     check_errno(fcntl(_devFd, F_NOCACHE, 1));
 #else
+    _devFd = open(devicePath, flags | O_DIRECT, 0644);
+    if (_devFd == -1 && errno == EINVAL) {
+        // Some file systems, such as tmpfs, do not support direct I/O.
+        _devFd = open(devicePath, flags, 0644);
+    }
     check_errno(_devFd);
-    _devFd = open(devicePath, O_DIRECT | O_SYNC | O_RDWR);
 #endif
 
+    struct stat st;
+    check_errno(fstat(_devFd, &st));
+
+    if (S_ISREG(st.st_mode)) {
+        off_t size = options.fileBlocks * _blockSize;
+        if (size > st.st_size) {
+            preallocate(size);
+            st.st_size = size;
+        }
 
+        _deviceSize = st.st_size / _blockSize;
+    } else {
 #if defined(__APPLE__) && defined(__MACH__)
-    uint64_t numBlocks;
-    uint64_t blockSize;
-    check_errno(ioctl(_devFd, DKIOCGETBLOCKCOUNT, &numBlocks));
-    check_errno(ioctl(_devFd, DKIOCGETBLOCKSIZE, &blockSize));
-    _deviceSize = numBlocks * blockSize / _blockSize;
+        uint64_t numBlocks;
+        uint64_t blockSize;
+        check_errno(ioctl(_devFd, DKIOCGETBLOCKCOUNT, &numBlocks));
+        check_errno(ioctl(_devFd, DKIOCGETBLOCKSIZE, &blockSize));
+        _deviceSize = numBlocks * blockSize / _blockSize;
 #else
-    uint64_t byteSize;
-    check_errno(ioctl(_devFd, BLKGETSIZE64, &byteSize));
-    _deviceSize = byteSize / _blockSize;
+        uint64_t byteSize;
+        check_errno(ioctl(_devFd, BLKGETSIZE64, &byteSize));
+        _deviceSize = byteSize / _blockSize;
 #endif
+    }
+
+    _pool = BufferAllocator::allocate(std::max<std::size_t>(_frames.size(), 1) * _blockSize);
+    _ioQueue = IoQueue::create(_devFd);
 }
 
 BufferManager::~BufferManager() {
+    // Wait for the requests in flight before closing the device.
+    _ioQueue.reset();
+    BufferAllocator::release(_pool, std::max<std::size_t>(_frames.size(), 1) * _blockSize);
     check_errno(close(_devFd));
 }
 
@@ -49,18 +122,73 @@ StatusWith<Buffer> BufferManager::get(std::size_t blockNum, bool zeroed) const {
         return StatusCode::NO_SPACE;
     }
 
-    Buffer buf(_blockSize, blockNum);
-    if (!zeroed) {
+    // Frames only hold blocks as they are on disk, read or written, so gets
+    // of the block by others never see zeros which were not written.
+    if (zeroed) {
+        return Buffer(_blockSize, blockNum);
+    }
+
+    std::unique_lock<std::mutex> lock(_poolMutex);
+
+    auto cached = _frameTable.find(blockNum);
+    while (cached != _frameTable.end() && _frames[cached->second].loading) {
+        // Wait for the read in flight rather than reading the block again.
+        _frameLoaded.wait(lock);
+        cached = _frameTable.find(blockNum);
+    }
+
+    if (cached != _frameTable.end()) {
+        Frame& frame = _frames[cached->second];
+        frame.pins++;
+        frame.referenced = true;
+
+        return Buffer(this, cached->second, frameData(cached->second), _blockSize, blockNum);
+    }
+
+    std::size_t index = evict();
+    if (index == NO_FRAME) {
+        lock.unlock();
+
+        Buffer buf(_blockSize, blockNum);
         std::size_t read = pread(
             _devFd, buf.getRaw(), _blockSize, _blockSize * blockNum);
 
         check_errno((int)read);
         invariant(read == _blockSize);
+
+        return std::move(buf);
     }
 
+    Frame& frame = _frames[index];
+    frame.blockNum = blockNum;
+    frame.valid = true;
+    frame.pins = 1;
+    frame.referenced = true;
+    _frameTable[blockNum] = index;
+
+    Buffer buf(this, index, frameData(index), _blockSize, blockNum);
+
+    // Read without the pool locked, so gets of other blocks go on meanwhile.
+    frame.loading = true;
+    lock.unlock();
+
+    std::size_t read = pread(
+        _devFd, buf.getRaw(), _blockSize, _blockSize * blockNum);
+
+    check_errno((int)read);
+    invariant(read == _blockSize);
+
+    lock.lock();
+    frame.loading = false;
+    _frameLoaded.notify_all();
+
     return std::move(buf);
 }
 
+Buffer BufferManager::allocate(std::size_t count) const {
+    return Buffer(_blockSize * count, 0);
+}
+
 Status BufferManager::write(const Buffer& buffer) const {
     std::size_t written = pwrite(_devFd, buffer.getRaw(), _blockSize,
                                  _blockSize * buffer._blockNum);
@@ -68,9 +196,135 @@ Status BufferManager::write(const Buffer& buffer) const {
     check_errno((int)written);
     invariant(written == _blockSize);
 
+    if (!buffer._manager) {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        updateCached(buffer._blockNum, buffer.getRaw());
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+Status BufferManager::sync() const {
+    if (_syncPolicy == SyncPolicy::BATCHED) {
+        check_errno(fdatasync(_devFd));
+    }
+
     return StatusCode::SUCCESS;
 }
 
+Status BufferManager::readBlocks(std::size_t blockNum, std::vector<Buffer>& buffers,
+                                 std::size_t count) const {
+    invariant(count <= buffers.size());
+    if (blockNum + count > _deviceSize) {
+        return StatusCode::NO_SPACE;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+        invariant(buffers[i].size() == _blockSize);
+        buffers[i]._blockNum = blockNum + i;
+    }
+
+    auto iov = regions(buffers, count);
+    IoQueue::transfer(_devFd, false, iov.data(), count, _blockSize * blockNum);
+    return StatusCode::SUCCESS;
+}
+
+Status BufferManager::writeBlocks(std::size_t blockNum, const std::vector<Buffer>& buffers,
+                                  std::size_t count) const {
+    invariant(count <= buffers.size());
+    if (blockNum + count > _deviceSize) {
+        return StatusCode::NO_SPACE;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+        invariant(buffers[i].size() == _blockSize);
+    }
+
+    auto iov = regions(buffers, count);
+    IoQueue::transfer(_devFd, true, iov.data(), count, _blockSize * blockNum);
+
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    for (std::size_t i = 0; i < count; i++) {
+        updateCached(blockNum + i, buffers[i].getRaw());
+    }
+
+    return StatusCode::SUCCESS;
+}
+
+StatusWith<Buffer> BufferManager::getRange(std::size_t blockNum,
+                                           std::size_t count) const {
+    if (blockNum + count > _deviceSize) {
+        return StatusCode::NO_SPACE;
+    }
+
+    Buffer buffer(_blockSize * count, blockNum);
+    iovec iov = {buffer.getRaw(), buffer.size()};
+    IoQueue::transfer(_devFd, false, &iov, 1, _blockSize * blockNum);
+
+    return std::move(buffer);
+}
+
+Status BufferManager::writeRange(const Buffer& buffer) const {
+    invariant(buffer.size() % _blockSize == 0);
+    std::size_t count = buffer.size() / _blockSize;
+    if (buffer._blockNum + count > _deviceSize) {
+        return StatusCode::NO_SPACE;
+    }
+
+    iovec iov = {buffer.getRaw(), buffer.size()};
+    IoQueue::transfer(_devFd, true, &iov, 1, _blockSize * buffer._blockNum);
+
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    updateCachedRange(buffer._blockNum, buffer.getRaw(), count);
+
+    return StatusCode::SUCCESS;
+}
+
+std::future<Status> BufferManager::readRangeAsync(std::size_t blockNum, Buffer& buffer,
+                                                  std::size_t count) const {
+    invariant(count * _blockSize <= buffer.size());
+    if (blockNum + count > _deviceSize) {
+        return ready(StatusCode::NO_SPACE);
+    }
+
+    buffer._blockNum = blockNum;
+    return _ioQueue->submit(false, {{buffer.getRaw(), count * _blockSize}},
+                            _blockSize * blockNum);
+}
+
+std::future<Status> BufferManager::writeRangeAsync(std::size_t blockNum,
+                                                   const Buffer& buffer,
+                                                   std::size_t count) const {
+    invariant(count * _blockSize <= buffer.size());
+    if (blockNum + count > _deviceSize) {
+        return ready(StatusCode::NO_SPACE);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_poolMutex);
+        updateCachedRange(blockNum, buffer.getRaw(), count);
+    }
+
+    return _ioQueue->submit(true, {{buffer.getRaw(), count * _blockSize}},
+                            _blockSize * blockNum);
+}
+
+StatusWith<Mapping> BufferManager::map(std::size_t blockNum, std::size_t count) const {
+    invariant(count > 0);
+    if (blockNum + count > _deviceSize) {
+        return StatusCode::NO_SPACE;
+    }
+
+    void* data = mmap(nullptr, _blockSize * count, PROT_READ, MAP_SHARED,
+                      _devFd, _blockSize * blockNum);
+    if (data == MAP_FAILED) {
+        // Character devices, like raw disks, can not be mapped.
+        return StatusCode::INVALID;
+    }
+
+    return Mapping(data, _blockSize * count);
+}
+
 uint64_t BufferManager::getBlockSize() const {
     return _blockSize;
 }
@@ -78,3 +332,83 @@ uint64_t BufferManager::getBlockSize() const {
 uint64_t BufferManager::getDeviceSize() const {
     return _deviceSize;
 }
+
+void BufferManager::preallocate(off_t size) {
+#ifdef __linux__
+    if (fallocate(_devFd, 0, 0, size) == 0) {
+        // Make the new size durable, so synced writes need not update it.
+        check_errno(fsync(_devFd));
+        return;
+    }
+
+    // Not every file system can allocate space ahead.
+    if (errno != EOPNOTSUPP) {
+        check_errno(-1);
+    }
+#endif
+
+    check_errno(ftruncate(_devFd, size));
+    check_errno(fsync(_devFd));
+}
+
+std::size_t BufferManager::evict() const {
+    // Two sweeps clear every reference bit, so any unpinned frame is found.
+    for (std::size_t scanned = 0; scanned < 2 * _frames.size(); scanned++) {
+        std::size_t index = _clockHand;
+        _clockHand = (_clockHand + 1) % _frames.size();
+
+        Frame& frame = _frames[index];
+        if (frame.pins) {
+            continue;
+        }
+
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+
+        if (frame.valid) {
+            _frameTable.erase(frame.blockNum);
+            frame.valid = false;
+        }
+
+        return index;
+    }
+
+    return NO_FRAME;
+}
+
+void BufferManager::unpin(std::size_t frame) const {
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    invariant(_frames[frame].pins > 0);
+    _frames[frame].pins--;
+}
+
+void BufferManager::updateCached(std::size_t blockNum, const void* data) const {
+    auto cached = _frameTable.find(blockNum);
+    if (cached == _frameTable.end()) {
+        return;
+    }
+
+    Frame& frame = _frames[cached->second];
+    if (frame.loading) {
+        // The read in flight may return the block from before the write, so
+        // the frame is dropped, and the next get reads the block again.
+        _frameTable.erase(cached);
+        frame.valid = false;
+        return;
+    }
+
+    std::memcpy(frameData(cached->second), data, _blockSize);
+}
+
+void BufferManager::updateCachedRange(std::size_t blockNum, const void* data,
+                                      std::size_t count) const {
+    for (std::size_t i = 0; i < count; i++) {
+        updateCached(blockNum + i, static_cast<const char*>(data) + i * _blockSize);
+    }
+}
+
+void* BufferManager::frameData(std::size_t frame) const {
+    return static_cast<char*>(_pool) + frame * _blockSize;
+}
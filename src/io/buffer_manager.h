@@ -1,32 +1,95 @@
 #pragma once
 
+#include <sys/types.h>
+
 #include <cstddef>
 #include <cstdint>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "io/buffer.h"
+#include "io/io_queue.h"
+#include "io/mapping.h"
 #include "util/nocopy.h"
 #include "util/status.h"
 
 /**
- * The `BufferManager` is a class that manages access to a disk device.
+ * The `BufferManager` is a class that manages access to a disk device, or
+ * to a regular file standing in for one.
  *
  * The disk device is block addressed.  Buffers are accessed via the `get`
- * call.
+ * call, which serves them from a pool of frames.  A frame stays pinned while
+ * a buffer refers to it, and unpinned frames are reused by CLOCK eviction.
+ * Writes go straight through to the device, so frames are never dirty.
+ *
+ * Runs of blocks can be transferred at once, into a contiguous buffer or a
+ * vector of buffers, and asynchronously, with many requests in flight,
+ * through an `IoQueue`.
  *
- * The `BufferManager` is not thread-safe.  Only one `BufferManager` may be
- * present for a given block device.
+ * Buffers of the same block share a frame, and must not be modified from
+ * several threads at once.  Only one `BufferManager` may be present for a
+ * given block device or file.
  */
 class BufferManager {
     DISALLOW_COPY(BufferManager);
 public:
+    // The default number of frames in the pool.
+    static const std::size_t DEFAULT_POOL_FRAMES = 1024;
+
     /**
-     * Create a BufferManager for the device as `devicePath`.
+     * When writes become durable.
      */
-    BufferManager(const char* devicePath);
+    enum class SyncPolicy {
+        // Every write is durable when it returns.
+        SYNC,
+        // Writes are durable after the next call to `sync`.
+        BATCHED,
+        // Writes are never synced.  For benchmarks only.
+        NONE
+    };
+
+    /**
+     * Options for opening a device or file.
+     */
+    struct Options {
+        std::size_t poolFrames = DEFAULT_POOL_FRAMES;
+        SyncPolicy syncPolicy = SyncPolicy::SYNC;
+
+        // The size in blocks to create or grow a regular file to.  Zero
+        // requires an existing file, and keeps its size.
+        std::size_t fileBlocks = 0;
+    };
+
+    /**
+     * Create a BufferManager for the device as `devicePath`, caching up to
+     * `poolFrames` blocks.
+     */
+    BufferManager(const char* devicePath,
+                  std::size_t poolFrames = DEFAULT_POOL_FRAMES);
+
+    /**
+     * Create a BufferManager for the block device or regular file at
+     * `devicePath`.
+     *
+     * Regular files are created if needed, and preallocated, when
+     * `options.fileBlocks` is set.  Direct I/O is used where the file system
+     * supports it.
+     */
+    BufferManager(const char* devicePath, const Options& options);
     ~BufferManager();
 
     /**
-     * Get the buffer addressed at `blockNum`, reading it from disk.
+     * Get the buffer addressed at `blockNum`, reading it from disk unless it
+     * is cached.  If `zeroed` is set, the buffer is zeroed instead, and gets
+     * memory of its own, outside the pool, until it is written.
+     *
+     * Gets of a block being read wait for that read, and gets of other blocks
+     * go on meanwhile.  If every frame is pinned, the buffer gets memory of
+     * its own.
      *
      * Returns: A successful status if the buffer was available, or a
      * NO_SPACE error if the block requested is outside the range of the
@@ -34,6 +97,12 @@ public:
      */
     StatusWith<Buffer> get(std::size_t blockNum, bool zeroed = false) const;
 
+    /**
+     * Get a zeroed buffer spanning `count` blocks, with memory of its own
+     * outside the pool, for use with the transfers of several blocks.
+     */
+    Buffer allocate(std::size_t count = 1) const;
+
     /**
      * Write the buffer back to disk.
      *
@@ -42,13 +111,141 @@ public:
      */
     Status write(const Buffer& buffer) const;
 
+    /**
+     * Make every completed write durable.  Writes are only reordered
+     * across calls to `sync` under the BATCHED and NONE policies, so callers
+     * call it before writing anything that references earlier writes.
+     */
+    Status sync() const;
+
+    /**
+     * Read the `count` consecutive blocks starting at `blockNum` into the
+     * first `count` of `buffers`, using vectored reads.
+     *
+     * The buffers must have been obtained from this BufferManager, and are
+     * readdressed to the blocks read.
+     *
+     * Returns: A successful status, or a NO_SPACE error if any of the blocks
+     * is outside the range of the device.
+     */
+    Status readBlocks(std::size_t blockNum, std::vector<Buffer>& buffers,
+                      std::size_t count) const;
+
+    /**
+     * Write the first `count` of `buffers` to the consecutive blocks starting
+     * at `blockNum`, using vectored writes.
+     *
+     * The buffers must have been obtained from this BufferManager, and are
+     * written regardless of the blocks they address.
+     *
+     * Returns: A successful status, or a NO_SPACE error if any of the blocks
+     * is outside the range of the device.
+     */
+    Status writeBlocks(std::size_t blockNum, const std::vector<Buffer>& buffers,
+                       std::size_t count) const;
+
+    /**
+     * Get a buffer spanning the `count` consecutive blocks starting at
+     * `blockNum`, read with a single transfer.  The buffer has memory of its
+     * own, outside the pool.
+     *
+     * Returns: A successful status, or a NO_SPACE error if any of the blocks
+     * is outside the range of the device.
+     */
+    StatusWith<Buffer> getRange(std::size_t blockNum, std::size_t count) const;
+
+    /**
+     * Write all the blocks of `buffer` back to disk with a single transfer.
+     * The buffer may span several blocks, as from `getRange`.
+     *
+     * Returns: A successful status, or a NO_SPACE error if any of the blocks
+     * is outside the range of the device.
+     */
+    Status writeRange(const Buffer& buffer) const;
+
+    /**
+     * Start reading the `count` consecutive blocks starting at `blockNum`
+     * into the first `count` blocks of `buffer`, which is readdressed to
+     * them.  The buffer must not be used until the returned future is ready.
+     *
+     * Returns: A future of a successful status, or of a NO_SPACE error if
+     * any of the blocks is outside the range of the device.
+     */
+    std::future<Status> readRangeAsync(std::size_t blockNum, Buffer& buffer,
+                                       std::size_t count) const;
+
+    /**
+     * Start writing the first `count` blocks of `buffer` to the consecutive
+     * blocks starting at `blockNum`, regardless of the blocks the buffer
+     * addresses.  The buffer must not be modified until the returned future
+     * is ready.
+     *
+     * Returns: A future of a successful status, or of a NO_SPACE error if
+     * any of the blocks is outside the range of the device.
+     */
+    std::future<Status> writeRangeAsync(std::size_t blockNum, const Buffer& buffer,
+                                        std::size_t count) const;
+
+    /**
+     * Map the `count` consecutive blocks starting at `blockNum` into memory,
+     * read-only.
+     *
+     * Blocks must not be written while they are mapped.
+     *
+     * Returns: The mapping, a NO_SPACE error if any of the blocks is outside
+     * the range of the device, or an INVALID error if the device can not be
+     * mapped.
+     */
+    StatusWith<Mapping> map(std::size_t blockNum, std::size_t count) const;
+
     // Get the block size in bytes.
     uint64_t getBlockSize() const;
 
     // Get the device size in blocks.
     uint64_t getDeviceSize() const;
 
+    friend class Buffer;
 private:
+    /**
+     * A frame of the pool.
+     */
+    struct Frame {
+        // The block held, if 'valid'.
+        std::size_t blockNum = 0;
+        bool valid = false;
+        // The number of buffers referring to the frame.
+        uint32_t pins = 0;
+        // Set on access, and cleared as the clock hand passes.
+        bool referenced = false;
+        // Set while the block is read into the frame, without the pool
+        // locked.
+        bool loading = false;
+    };
+
+    // The marker for no frame.
+    static const std::size_t NO_FRAME = SIZE_MAX;
+
+    // Grow the regular file being managed to 'size' bytes, allocating its
+    // space up front where possible.
+    void preallocate(off_t size);
+
+    // Find an unpinned frame to reuse, or NO_FRAME.  Called with '_poolMutex'.
+    std::size_t evict() const;
+
+    // Release a pin of 'frame', from a `Buffer`.
+    void unpin(std::size_t frame) const;
+
+    // Copy 'data' into the frame holding 'blockNum', if it is cached.
+    // Called with '_poolMutex'.
+    void updateCached(std::size_t blockNum, const void* data) const;
+
+    // Copy the `count` blocks of 'data' into the frames of the blocks
+    // starting at 'blockNum' which are cached.  Called with '_poolMutex'.
+    void updateCachedRange(std::size_t blockNum, const void* data,
+                           std::size_t count) const;
+
+    void* frameData(std::size_t frame) const;
+
     // The file descriptor for the device.
     int _devFd;
 
@@ -57,4 +254,20 @@ private:
 
     // The number of blocks available on the device.
     std::size_t _deviceSize;
+
+    SyncPolicy _syncPolicy;
+
+    // Performs the asynchronous transfers.
+    std::unique_ptr<IoQueue> _ioQueue;
+
+    // The memory of the frames, a block per frame.
+    void* _pool;
+    // The pool is shared by all users of the `BufferManager`, including
+    // const ones.
+    mutable std::vector<Frame> _frames;
+    mutable std::unordered_map<std::size_t, std::size_t> _frameTable;
+    mutable std::size_t _clockHand = 0;
+    mutable std::mutex _poolMutex;
+    // Notified when a frame has been read.
+    mutable std::condition_variable _frameLoaded;
 };
@@ -1,5 +1,10 @@
 #include "util/testing.h"
 
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
 #include "io/buffer_manager.h"
 #include "io/buffer.h"
 
@@ -42,7 +47,190 @@ TEST(BufferManagerSize) {
     END;
 }
 
+TEST(BufferManagerReadWriteBlocks) {
+    BufferManager manager("/dev/sdb");
+
+    std::vector<Buffer> buffers;
+    for (int i = 0; i < 4; i++) {
+        buffers.push_back(manager.allocate());
+        *static_cast<int*>(buffers[i].getRaw()) = i + 1;
+    }
+
+    EXPECT_TRUE(manager.writeBlocks(10, buffers, 3));
+    EXPECT_FALSE(manager.writeBlocks(2621438, buffers, 3));
+
+    std::vector<Buffer> read;
+    for (int i = 0; i < 4; i++) {
+        read.push_back(manager.allocate());
+    }
+
+    EXPECT_TRUE(manager.readBlocks(10, read, 3));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(*static_cast<int*>(read[i].getRaw()), i + 1);
+    }
+
+    EXPECT_EQ(*static_cast<int*>((*manager.get(12)).getRaw()), 3);
+
+    END;
+}
+
+TEST(BufferManagerPool) {
+    BufferManager manager("/dev/sdb", 2);
+
+    {
+        // Zeroed buffers are not cached until they are written.
+        Buffer buf = std::move(*manager.get(20, true));
+        *static_cast<int*>(buf.getRaw()) = 4;
+        manager.write(buf);
+        *static_cast<int*>(buf.getRaw()) = 5;
+        Buffer unwritten = std::move(*manager.get(20));
+        EXPECT_TRUE(unwritten.getRaw() != buf.getRaw());
+        EXPECT_EQ(*static_cast<int*>(unwritten.getRaw()), 4);
+        manager.write(buf);
+        EXPECT_EQ(*static_cast<int*>(unwritten.getRaw()), 5);
+
+        // Buffers of the same block share a frame.
+        Buffer same = std::move(*manager.get(20));
+        EXPECT_EQ(same.getRaw(), unwritten.getRaw());
+
+        // Zeroing a cached block leaves the shared frame alone.
+        Buffer zeroed = std::move(*manager.get(20, true));
+        EXPECT_TRUE(zeroed.getRaw() != same.getRaw());
+        EXPECT_EQ(*static_cast<int*>(zeroed.getRaw()), 0);
+        EXPECT_EQ(*static_cast<int*>(same.getRaw()), 5);
+
+        // With every frame pinned, buffers own their memory.
+        Buffer other = std::move(*manager.get(21));
+        Buffer unpooled = std::move(*manager.get(22));
+        EXPECT_TRUE(unpooled.getRaw() != same.getRaw());
+        EXPECT_TRUE(unpooled.getRaw() != other.getRaw());
+
+        // Writing an unpooled buffer updates the cached block.
+        std::vector<Buffer> buffers;
+        buffers.push_back(manager.allocate());
+        *static_cast<int*>(buffers[0].getRaw()) = 6;
+        manager.writeBlocks(21, buffers, 1);
+        EXPECT_EQ(*static_cast<int*>(other.getRaw()), 6);
+    }
+
+    // Unpinned frames are evicted for other blocks.
+    for (int i = 30; i < 40; i++) {
+        EXPECT_TRUE(manager.get(i));
+    }
+    EXPECT_EQ(*static_cast<int*>((*manager.get(20)).getRaw()), 5);
+
+    END;
+}
+
+TEST(BufferManagerRange) {
+    BufferManager manager("/dev/sdb");
+
+    {
+        Buffer cached = std::move(*manager.get(51));
+
+        Buffer range = std::move(*manager.getRange(50, 4));
+        EXPECT_EQ(range.size(), 4 * manager.getBlockSize());
+        for (int i = 0; i < 4; i++) {
+            static_cast<int*>(range.getRaw())[i * manager.getBlockSize() / sizeof(int)] = i + 10;
+        }
+        EXPECT_TRUE(manager.writeRange(range));
+
+        // Cached blocks see the write.
+        EXPECT_EQ(*static_cast<int*>(cached.getRaw()), 11);
+    }
+
+    EXPECT_EQ(*static_cast<int*>((*manager.get(53)).getRaw()), 13);
+    EXPECT_EQ(*static_cast<int*>((*manager.getRange(52, 1)).getRaw()), 12);
+    EXPECT_FALSE(manager.getRange(2621438, 3));
+
+    Buffer buffer = manager.allocate(3);
+    EXPECT_TRUE(manager.readRangeAsync(50, buffer, 2).get());
+    EXPECT_EQ(static_cast<int*>(buffer.getRaw())[manager.getBlockSize() / sizeof(int)], 11);
+    EXPECT_TRUE(manager.writeRangeAsync(60, buffer, 2).get());
+    EXPECT_EQ(*static_cast<int*>((*manager.get(60)).getRaw()), 10);
+    EXPECT_FALSE(manager.writeRangeAsync(2621439, buffer, 2).get());
+
+    END;
+}
+
+TEST(BufferManagerFile) {
+    const char* path = "/tmp/buffer_manager_test_file";
+    unlink(path);
+
+    BufferManager::Options options;
+    options.syncPolicy = BufferManager::SyncPolicy::BATCHED;
+    options.fileBlocks = 64;
+
+    {
+        BufferManager manager(path, options);
+        EXPECT_EQ(manager.getDeviceSize(), 64);
+        EXPECT_FALSE(manager.get(64));
+
+        Buffer buf = std::move(*manager.get(63, true));
+        *static_cast<int*>(buf.getRaw()) = 42;
+        EXPECT_TRUE(manager.write(buf));
+        EXPECT_TRUE(manager.sync());
+    }
+
+    // An existing file keeps its size and contents.
+    {
+        BufferManager manager(path, BufferManager::Options());
+        EXPECT_EQ(manager.getDeviceSize(), 64);
+        EXPECT_EQ(*static_cast<int*>((*manager.get(63)).getRaw()), 42);
+    }
+
+    unlink(path);
+
+    END;
+}
+
+TEST(BufferManagerConcurrentGet) {
+    const char* path = "/tmp/buffer_manager_test_concurrent";
+    unlink(path);
+
+    BufferManager::Options options;
+    options.poolFrames = 4;
+    options.fileBlocks = 64;
+    BufferManager manager(path, options);
+
+    {
+        Buffer buf = manager.allocate();
+        *static_cast<int*>(buf.getRaw()) = 7;
+        EXPECT_TRUE(manager.writeRange(buf));
+    }
+
+    // Gets racing to read a block share the one frame read.
+    std::vector<void*> data(8);
+    std::vector<int> values(data.size());
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < data.size(); i++) {
+        threads.emplace_back([&, i]() {
+            Buffer buf = std::move(*manager.get(0));
+            data[i] = buf.getRaw();
+            values[i] = *static_cast<int*>(buf.getRaw());
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (std::size_t i = 0; i < data.size(); i++) {
+        EXPECT_EQ(data[i], data[0]);
+        EXPECT_EQ(values[i], 7);
+    }
+
+    unlink(path);
+
+    END;
+}
+
 int main() {
     BufferManagerReadWrite();
     BufferManagerSize();
+    BufferManagerReadWriteBlocks();
+    BufferManagerPool();
+    BufferManagerRange();
+    BufferManagerFile();
+    BufferManagerConcurrentGet();
 }
@@ -0,0 +1,449 @@
+#include "io/io_queue.h"
+
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "util/assert.h"
+#include "util/stdx/memory.h"
+
+const std::size_t IoQueue::DEFAULT_DEPTH;
+
+namespace {
+
+// The most threads performing requests without io_uring.
+const std::size_t MAX_WORKER_THREADS = 4;
+
+/**
+ * The completion of a request, which may be split into several operations.
+ */
+struct Completion {
+    std::promise<Status> promise;
+    std::atomic<std::size_t> remaining;
+};
+
+/**
+ * A transfer of at most IOV_MAX regions, part of a request.
+ */
+struct Operation {
+    std::shared_ptr<Completion> completion;
+    bool write;
+    std::vector<iovec> iov;
+    off_t offset;
+
+    // Finish the part of the transfer after the first 'transferred' bytes,
+    // and complete the request if this was its last operation.
+    void finish(int fd, std::size_t transferred) {
+        std::size_t first = 0;
+        while (first < iov.size() && transferred >= iov[first].iov_len) {
+            transferred -= iov[first].iov_len;
+            offset += iov[first].iov_len;
+            first++;
+        }
+
+        if (first < iov.size()) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + transferred;
+            iov[first].iov_len -= transferred;
+            offset += transferred;
+            IoQueue::transfer(fd, write, &iov[first], iov.size() - first, offset);
+        }
+
+        if (--completion->remaining == 0) {
+            completion->promise.set_value(StatusCode::SUCCESS);
+        }
+    }
+};
+
+// Split a request into operations of at most IOV_MAX regions, and return
+// the future of its completion.
+std::future<Status> split(bool write, std::vector<iovec> iov, off_t offset,
+                          std::vector<std::unique_ptr<Operation>>& operations) {
+    auto completion = std::make_shared<Completion>();
+    auto future = completion->promise.get_future();
+    for (std::size_t start = 0; start < iov.size(); start += IOV_MAX) {
+        std::size_t end = std::min<std::size_t>(iov.size(), start + IOV_MAX);
+
+        auto operation = stdx::make_unique<Operation>();
+        operation->completion = completion;
+        operation->write = write;
+        operation->iov.assign(iov.begin() + start, iov.begin() + end);
+        operation->offset = offset;
+        for (const iovec& region : operation->iov) {
+            offset += region.iov_len;
+        }
+
+        operations.push_back(std::move(operation));
+    }
+
+    completion->remaining = operations.size();
+    if (operations.empty()) {
+        completion->promise.set_value(StatusCode::SUCCESS);
+    }
+
+    return future;
+}
+
+/**
+ * Performs requests on a pool of threads, with blocking system calls.
+ */
+class ThreadQueue : public IoQueue {
+public:
+    ThreadQueue(int fd, std::size_t depth) : _fd(fd) {
+        std::size_t threads = std::max<std::size_t>(1, std::min(depth, MAX_WORKER_THREADS));
+        for (std::size_t i = 0; i < threads; i++) {
+            _workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadQueue() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _available.notify_all();
+
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    std::future<Status> submit(bool write, std::vector<iovec> iov, off_t offset) override {
+        std::vector<std::unique_ptr<Operation>> operations;
+        auto future = split(write, std::move(iov), offset, operations);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto& operation : operations) {
+                _operations.push_back(std::move(operation));
+            }
+        }
+        _available.notify_all();
+
+        return future;
+    }
+
+    bool usesUring() const override {
+        return false;
+    }
+
+private:
+    void work() {
+        while (true) {
+            std::unique_ptr<Operation> operation;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _available.wait(lock, [this] {
+                    return _stopping || !_operations.empty();
+                });
+
+                // Requests queued before stopping are still performed.
+                if (_operations.empty()) {
+                    return;
+                }
+
+                operation = std::move(_operations.front());
+                _operations.pop_front();
+            }
+
+            operation->finish(_fd, 0);
+        }
+    }
+
+    int _fd;
+
+    std::mutex _mutex;
+    std::condition_variable _available;
+    std::deque<std::unique_ptr<Operation>> _operations;
+    bool _stopping = false;
+
+    std::vector<std::thread> _workers;
+};
+
+#ifdef __linux__
+
+int uringSetup(unsigned entries, io_uring_params* params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags,
+                   nullptr, 0);
+}
+
+int uringRegister(int ringFd, unsigned opcode, const void* arg, unsigned count) {
+    return syscall(__NR_io_uring_register, ringFd, opcode, arg, count);
+}
+
+/**
+ * Submits requests to an io_uring, and completes them on a reaper thread.
+ *
+ * Short or failed transfers are finished with blocking system calls, which
+ * retry and report errors the same way as synchronous I/O.
+ */
+class UringQueue : public IoQueue {
+public:
+    /**
+     * Create a queue for 'fd', or return null if io_uring is unavailable.
+     */
+    static std::unique_ptr<IoQueue> create(int fd, std::size_t depth) {
+        std::unique_ptr<UringQueue> queue(new UringQueue(fd));
+        if (!queue->init(depth)) {
+            return nullptr;
+        }
+
+        queue->_reaper = std::thread(&UringQueue::reap, queue.get());
+        return std::move(queue);
+    }
+
+    ~UringQueue() {
+        if (_reaper.joinable()) {
+            // Completions may arrive out of order, so only stop the reaper
+            // once every request is complete.
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _changed.wait(lock, [this] { return _inFlight == 0; });
+            }
+
+            push(nullptr);
+            _reaper.join();
+        }
+
+        if (_sqes) {
+            munmap(_sqes, _sqesSize);
+        }
+        if (_cqRing && _cqRing != _sqRing) {
+            munmap(_cqRing, _cqRingSize);
+        }
+        if (_sqRing) {
+            munmap(_sqRing, _sqRingSize);
+        }
+        if (_ringFd >= 0) {
+            close(_ringFd);
+        }
+    }
+
+    std::future<Status> submit(bool write, std::vector<iovec> iov, off_t offset) override {
+        std::vector<std::unique_ptr<Operation>> operations;
+        auto future = split(write, std::move(iov), offset, operations);
+        for (auto& operation : operations) {
+            push(operation.release());
+        }
+
+        return future;
+    }
+
+    bool usesUring() const override {
+        return true;
+    }
+
+private:
+    UringQueue(int fd) : _fd(fd) {}
+
+    bool init(std::size_t depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        _ringFd = uringSetup(depth, &params);
+        if (_ringFd < 0) {
+            return false;
+        }
+
+        _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+        }
+
+        _sqRing = mapRing(_sqRingSize, IORING_OFF_SQ_RING);
+        if (!_sqRing) {
+            return false;
+        }
+
+        _cqRing = singleMap ? _sqRing : mapRing(_cqRingSize, IORING_OFF_CQ_RING);
+        if (!_cqRing) {
+            return false;
+        }
+
+        _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(mapRing(_sqesSize, IORING_OFF_SQES));
+        if (!_sqes) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(_sqRing);
+        _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(_cqRing);
+        _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        _entries = params.sq_entries;
+
+        // A registered file saves a lookup per request, but is optional.
+        _fixedFile = uringRegister(_ringFd, IORING_REGISTER_FILES, &_fd, 1) == 0;
+
+        return true;
+    }
+
+    void* mapRing(std::size_t size, off_t offset) {
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, _ringFd, offset);
+        return data == MAP_FAILED ? nullptr : data;
+    }
+
+    // Submit 'operation', or a no-op which stops the reaper if it is null.
+    void push(Operation* operation) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _changed.wait(lock, [this] { return _inFlight < _entries; });
+
+        unsigned tail = *_sqTail;
+        unsigned index = tail & _sqMask;
+
+        io_uring_sqe& sqe = _sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        if (operation) {
+            sqe.opcode = operation->write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.fd = _fixedFile ? 0 : _fd;
+            sqe.flags = _fixedFile ? IOSQE_FIXED_FILE : 0;
+            sqe.addr = reinterpret_cast<uint64_t>(operation->iov.data());
+            sqe.len = operation->iov.size();
+            sqe.off = operation->offset;
+        } else {
+            sqe.opcode = IORING_OP_NOP;
+        }
+        sqe.user_data = reinterpret_cast<uint64_t>(operation);
+
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+        _inFlight++;
+
+        while (uringEnter(_ringFd, 1, 0, 0) < 0) {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                check_errno(-1);
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void reap() {
+        while (true) {
+            unsigned head = *_cqHead;
+            if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+                if (uringEnter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+                        errno != EINTR) {
+                    check_errno(-1);
+                }
+                continue;
+            }
+
+            const io_uring_cqe& cqe = _cqes[head & _cqMask];
+            Operation* operation = reinterpret_cast<Operation*>(cqe.user_data);
+            int result = cqe.res;
+            __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+
+            if (operation) {
+                std::unique_ptr<Operation> owned(operation);
+                owned->finish(_fd, std::max(result, 0));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _inFlight--;
+            }
+            _changed.notify_all();
+
+            if (!operation) {
+                return;
+            }
+        }
+    }
+
+    int _fd;
+    int _ringFd = -1;
+    bool _fixedFile = false;
+
+    void* _sqRing = nullptr;
+    std::size_t _sqRingSize = 0;
+    void* _cqRing = nullptr;
+    std::size_t _cqRingSize = 0;
+    io_uring_sqe* _sqes = nullptr;
+    std::size_t _sqesSize = 0;
+
+    unsigned* _sqTail = nullptr;
+    unsigned _sqMask = 0;
+    unsigned* _sqArray = nullptr;
+    unsigned* _cqHead = nullptr;
+    unsigned* _cqTail = nullptr;
+    unsigned _cqMask = 0;
+    io_uring_cqe* _cqes = nullptr;
+
+    // The number of submission entries, which bounds the requests in flight.
+    std::size_t _entries = 0;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::size_t _inFlight = 0;
+
+    std::thread _reaper;
+};
+
+#endif
+
+} // namespace
+
+std::unique_ptr<IoQueue> IoQueue::create(int fd, std::size_t depth, bool useUring) {
+#ifdef __linux__
+    if (useUring) {
+        auto queue = UringQueue::create(fd, depth);
+        if (queue) {
+            return queue;
+        }
+    }
+#endif
+
+    return stdx::make_unique<ThreadQueue>(fd, depth);
+}
+
+void IoQueue::transfer(int fd, bool write, iovec* iov, std::size_t count,
+                       off_t offset) {
+    std::size_t done = 0;
+    while (done < count) {
+        int iovcnt = std::min<std::size_t>(count - done, IOV_MAX);
+        ssize_t transferred = write ?
+            pwritev(fd, &iov[done], iovcnt, offset) :
+            preadv(fd, &iov[done], iovcnt, offset);
+
+        check_errno((int)transferred);
+        invariant(transferred > 0);
+        offset += transferred;
+
+        // Skip past the regions transferred, and the transferred part of a
+        // partially transferred one.
+        while (transferred > 0) {
+            std::size_t length = std::min<std::size_t>(transferred, iov[done].iov_len);
+            iov[done].iov_base = static_cast<char*>(iov[done].iov_base) + length;
+            iov[done].iov_len -= length;
+            transferred -= length;
+            if (iov[done].iov_len == 0) {
+                done++;
+            }
+        }
+    }
+}
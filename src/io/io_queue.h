@@ -0,0 +1,62 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "util/nocopy.h"
+#include "util/status.h"
+
+/**
+ * Performs reads and writes of a file asynchronously, keeping several of
+ * them in flight at once.
+ *
+ * On Linux, requests are submitted to an io_uring with the file registered.
+ * Where io_uring is unavailable, a pool of threads performs them with
+ * blocking system calls instead.
+ *
+ * The memory of a request must stay valid until its future is ready.  The
+ * queue is thread-safe, and waits for requests in flight when destroyed.
+ */
+class IoQueue {
+    DISALLOW_COPY(IoQueue);
+public:
+    // The default number of requests in flight.
+    static const std::size_t DEFAULT_DEPTH = 64;
+
+    /**
+     * Create a queue for requests to `fd`, with up to `depth` of them in
+     * flight.  Unless `useUring` is false, io_uring is used if available.
+     */
+    static std::unique_ptr<IoQueue> create(int fd, std::size_t depth = DEFAULT_DEPTH,
+                                           bool useUring = true);
+
+    virtual ~IoQueue() {}
+
+    /**
+     * Start reading into, or writing from, the memory described by `iov` at
+     * `offset` of the file.
+     *
+     * Returns: A future of the status of the transfer.
+     */
+    virtual std::future<Status> submit(bool write, std::vector<iovec> iov,
+                                       off_t offset) = 0;
+
+    // Whether requests are submitted to an io_uring.
+    virtual bool usesUring() const = 0;
+
+    /**
+     * Read into, or write from, the `count` regions of `iov` at `offset` of
+     * `fd`, blocking until all of it is done.  The regions are updated to
+     * describe the untransferred part.
+     */
+    static void transfer(int fd, bool write, iovec* iov, std::size_t count,
+                         off_t offset);
+
+protected:
+    IoQueue() {}
+};
@@ -0,0 +1,74 @@
+#include "util/testing.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <future>
+#include <vector>
+
+#include "io/io_queue.h"
+
+namespace {
+
+// Write and read back many requests at once through a queue.
+void checkQueue(IoQueue& queue, int fd) {
+    const std::size_t requests = 32;
+    const std::size_t regions = 3;
+    const std::size_t size = 4096;
+
+    std::vector<std::vector<char>> data(requests * regions, std::vector<char>(size));
+    std::vector<std::future<Status>> futures;
+    for (std::size_t i = 0; i < requests; i++) {
+        std::vector<iovec> iov;
+        for (std::size_t j = 0; j < regions; j++) {
+            std::vector<char>& region = data[i * regions + j];
+            std::memset(region.data(), 'a' + (i * regions + j) % 26, size);
+            iov.push_back({region.data(), size});
+        }
+        futures.push_back(queue.submit(true, iov, i * regions * size));
+    }
+
+    for (auto& future : futures) {
+        EXPECT_TRUE(future.get());
+    }
+    futures.clear();
+
+    std::vector<std::vector<char>> read(requests, std::vector<char>(regions * size));
+    for (std::size_t i = 0; i < requests; i++) {
+        futures.push_back(queue.submit(false, {{read[i].data(), regions * size}},
+                                       i * regions * size));
+    }
+
+    for (std::size_t i = 0; i < requests; i++) {
+        EXPECT_TRUE(futures[i].get());
+        for (std::size_t j = 0; j < regions; j++) {
+            EXPECT_EQ(std::memcmp(read[i].data() + j * size,
+                                  data[i * regions + j].data(), size), 0);
+        }
+    }
+
+    // Requests with no regions complete immediately.
+    EXPECT_TRUE(queue.submit(false, {}, 0).get());
+}
+
+} // namespace
+
+TEST(IoQueueReadWrite) {
+    char path[] = "/tmp/io_queue_testXXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_TRUE(fd >= 0);
+    unlink(path);
+
+    checkQueue(*IoQueue::create(fd, 8), fd);
+    checkQueue(*IoQueue::create(fd, 8, false), fd);
+
+    close(fd);
+
+    END;
+}
+
+int main() {
+    IoQueueReadWrite();
+}
@@ -0,0 +1,38 @@
+#include "io/mapping.h"
+
+#include <sys/mman.h>
+
+#include "util/assert.h"
+
+Mapping::Mapping(void* data, std::size_t size) : _data(data), _size(size) {}
+
+Mapping::Mapping(Mapping&& other) : _data(other._data), _size(other._size) {
+    other._data = nullptr;
+}
+
+Mapping& Mapping::operator=(Mapping&& other) {
+    if (_data) {
+        check_errno(munmap(_data, _size));
+    }
+
+    _data = other._data;
+    _size = other._size;
+
+    other._data = nullptr;
+
+    return *this;
+}
+
+Mapping::~Mapping() {
+    if (_data) {
+        check_errno(munmap(_data, _size));
+    }
+}
+
+const void* Mapping::getRaw() const {
+    return _data;
+}
+
+std::size_t Mapping::size() const {
+    return _size;
+}
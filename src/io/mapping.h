@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#include "util/nocopy.h"
+
+/**
+ * A read-only memory mapping of a range of blocks of a device.  Obtainable
+ * through the `BufferManager`.
+ */
+class Mapping {
+    DISALLOW_COPY(Mapping);
+public:
+    ~Mapping();
+    Mapping(Mapping&& other);
+
+    Mapping& operator=(Mapping&& other);
+
+    /**
+     * Get access to the mapped memory region.
+     */
+    const void* getRaw() const;
+
+    /**
+     * Get the size of the mapping.
+     */
+    std::size_t size() const;
+
+    friend class BufferManager;
+private:
+    Mapping(void* data, std::size_t size);
+
+    void *_data;
+    std::size_t _size;
+};
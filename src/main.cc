@@ -4,8 +4,7 @@
 #include <unistd.h>
 #include <thread>
 
-#include "mongoose/Server.h"
-
+#include "db/caching_store.h"
 #include "db/graph_store.h"
 #include "db/logged_store.h"
 #include "db/memory_store.h"
@@ -15,10 +14,13 @@
 #include "db/partition/partition_manager.h"
 #include "net/partition_server.h"
 
+#include "net/binary_server.h"
 #include "net/http_controller.h"
+#include "net/http_server.h"
 #include "net/replication_server.h"
 #include "net/replication_outbound.h"
 
+#include "util/parallel.h"
 #include "util/stdx/memory.h"
 
 volatile static bool running = true;
@@ -32,9 +34,12 @@ void handle_signal(int sig)
 }
 
 static const char *USAGE =
-    "cs426_graph_server: [-f] [-c] [-b ipaddress] portnum [devfile]\n"
+    "cs426_graph_server: [-f] [-c] [-b ipaddress] [-w workers] [-n binaryport] [-k cachemb] portnum [devfile]\n"
     "Options:\n"
     "\t-f:\tFormat the <devfile> if provided on startup.\n"
+    "\t-w workers:\tThe number of threads handling HTTP requests.\n"
+    "\t-n binaryport:\tAlso accept commands over the binary protocol on binaryport.  Not with -b, -c or -p.\n"
+    "\t-k cachemb:\tThe megabytes of neighbor lists cached, or 0 for none.  64 by default.\n"
     "\t-b ipaddress:\tThe ipaddress of the next successor in the replication chain.\n"
     "\t-c: This is a chain replica (not the head), and should not accept write commands over portnum.\n\n"
     "Arguments:\n"
@@ -55,6 +60,9 @@ int main(int argc, char* argv[])
     char *replicationSuccessorIp = nullptr;
 
     int partNumber = -1;
+    std::size_t workerCount = parallel::threadCount();
+    int binaryPort = 0;
+    std::size_t cacheMegabytes = 64;
     std::vector<std::string> addresses;
 
     int port = std::atoi(argv[optind++]);
@@ -64,7 +72,7 @@ int main(int argc, char* argv[])
     }
 
     int opt;
-    while ((opt = getopt(argc, argv, "fcb:p:l")) != -1) {
+    while ((opt = getopt(argc, argv, "fcb:p:lw:n:k:")) != -1) {
         switch (opt) {
             case 'f':
                 format = true;
@@ -84,6 +92,27 @@ int main(int argc, char* argv[])
                 break;
             case 'l':
                 break;
+            case 'w':
+                if (std::atoi(optarg) <= 0) {
+                    std::cerr << "Invalid worker count." << std::endl;
+                    die_with_usage();
+                }
+                workerCount = std::atoi(optarg);
+                break;
+            case 'n':
+                binaryPort = std::atoi(optarg);
+                if (binaryPort == 0) {
+                    std::cerr << "Invalid binary port number." << std::endl;
+                    die_with_usage();
+                }
+                break;
+            case 'k':
+                if (std::atoi(optarg) < 0) {
+                    std::cerr << "Invalid cache size." << std::endl;
+                    die_with_usage();
+                }
+                cacheMegabytes = std::atoi(optarg);
+                break;
             case '?':
             default:
                 die_with_usage();
@@ -98,12 +127,25 @@ int main(int argc, char* argv[])
         std::cerr << addr << std::endl;
     }
 
+    // Binary requests are applied to the store directly.
+    if (binaryPort && (replicationSuccessorIp || isChainReplica || partNumber != -1)) {
+        die_with_usage();
+    }
+
     srand(time(NULL));
     signal(SIGINT, handle_signal);
 
     std::unique_ptr<GraphStore> store;
     store = stdx::make_unique<MemoryStore>();
 
+    // All writes go through the cache, which drops the lists they change.
+    std::unique_ptr<CachingStore> cachingStore = nullptr;
+    GraphStore* servedStore = store.get();
+    if (cacheMegabytes) {
+        cachingStore = stdx::make_unique<CachingStore>(store.get(), cacheMegabytes << 20);
+        servedStore = cachingStore.get();
+    }
+
     std::unique_ptr<ReplicationManager> replManager = nullptr;
     ReplicationManager::NodeType type;
     std::unique_ptr<ReplicationOutbound> replicationOutbound = nullptr;
@@ -120,26 +162,36 @@ int main(int argc, char* argv[])
             type = ReplicationManager::NodeType::TAIL;
         }
         replManager = stdx::make_unique<ReplicationManager>(
-                type, store.get(), replicationOutbound.get());
+                type, servedStore, replicationOutbound.get());
     }
 
     PartitionConfig config(addresses, partNumber);
     PartitionManager partitionManager(config);
 
-    Mongoose::Server server(port);
-    HTTPController controller(store.get(), replManager.get(), config, &partitionManager, false);
+    HTTPServer server(port, workerCount);
+    HTTPController controller(servedStore, replManager.get(), config, &partitionManager, nullptr,
+                              cachingStore.get());
     server.registerController(&controller);
     server.setOption("enable_directory_listing", "false");
 
     // TODO there is probably something wrong here.
     server.start();
 
+    std::unique_ptr<BinaryServer> binaryServer = nullptr;
+    if (binaryPort) {
+        binaryServer = stdx::make_unique<BinaryServer>(binaryPort, servedStore, workerCount);
+        if (!binaryServer->start()) {
+            std::cerr << "Could not listen on binary port " << binaryPort << "." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     std::unique_ptr<ReplicationServer> replServer = nullptr;
     std::thread replServerThread;
     if (replManager) {
         replServer = stdx::make_unique<ReplicationServer>(
-                RPC_PORT, store.get(), replManager.get(),
-                false);
+                RPC_PORT, servedStore, replManager.get(),
+                nullptr);
 
         if (type != ReplicationManager::NodeType::HEAD) {
             replServerThread = std::thread([&]{
@@ -158,7 +210,7 @@ int main(int argc, char* argv[])
         }
 
         partServer = stdx::make_unique<PartitionServer>(ip.substr(0, pos),
-                std::atoi(ip.substr(pos + 1).c_str()), store.get());
+                std::atoi(ip.substr(pos + 1).c_str()), servedStore);
         partitionServerThread = std::thread([&]{
             partServer->start();
         });
@@ -172,6 +224,10 @@ int main(int argc, char* argv[])
     }
 
     server.stop();
+    if (binaryServer) {
+        binaryServer->stop();
+    }
+
     if (replServer) {
         replServer->stop();
         replServerThread.join();
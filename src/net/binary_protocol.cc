@@ -0,0 +1,118 @@
+#include "net/binary_protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace binary {
+
+namespace {
+    uint32_t readUInt32(const char* data) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        uint32_t value = 0;
+        for (int i = 3; i >= 0; i--) {
+            value = (value << 8) | bytes[i];
+        }
+
+        return value;
+    }
+
+    uint64_t readUInt64(const char* data) {
+        return readUInt32(data) | static_cast<uint64_t>(readUInt32(data + 4)) << 32;
+    }
+
+    void appendUInt32(uint32_t value, std::string* out) {
+        for (int i = 0; i < 4; i++) {
+            out->push_back(static_cast<char>(value >> (8 * i)));
+        }
+    }
+
+    void appendUInt64(uint64_t value, std::string* out) {
+        appendUInt32(static_cast<uint32_t>(value), out);
+        appendUInt32(static_cast<uint32_t>(value >> 32), out);
+    }
+
+    bool isKnown(OpCode opcode) {
+        switch (opcode) {
+            case OpCode::ADD_NODE:
+            case OpCode::ADD_EDGE:
+            case OpCode::REMOVE_NODE:
+            case OpCode::REMOVE_EDGE:
+            case OpCode::GET_NODE:
+            case OpCode::GET_EDGE:
+            case OpCode::GET_NEIGHBORS:
+            case OpCode::SHORTEST_PATH:
+                return true;
+        }
+
+        return false;
+    }
+
+    // Append the request id and status of a response, after a length of
+    // 'payloadSize' more bytes.
+    void appendResponseHeader(uint64_t requestId, StatusCode status, std::size_t payloadSize,
+                              std::string* out) {
+        appendUInt32(static_cast<uint32_t>(12 + payloadSize), out);
+        appendUInt64(requestId, out);
+        appendUInt32(static_cast<uint32_t>(status), out);
+    }
+}
+
+StatusWith<std::size_t> decodeRequests(const char* data, std::size_t size,
+                                       std::vector<Request>* requests) {
+    std::size_t position = 0;
+    while (size - position >= 4) {
+        const char* frame = data + position;
+        if (readUInt32(frame) != REQUEST_SIZE - 4) {
+            return StatusCode::INVALID;
+        }
+
+        if (size - position < REQUEST_SIZE) {
+            break;
+        }
+
+        Request request;
+        request.requestId = readUInt64(frame + 4);
+        request.opcode = static_cast<OpCode>(readUInt32(frame + 12));
+        uint32_t durability = readUInt32(frame + 16);
+        request.durability = static_cast<Durability>(durability);
+        request.nodeAId = static_cast<NodeId>(readUInt64(frame + 20));
+        request.nodeBId = static_cast<NodeId>(readUInt64(frame + 28));
+        request.valid = isKnown(request.opcode) &&
+                        durability <= static_cast<uint32_t>(Durability::ASYNC);
+        requests->push_back(request);
+
+        position += REQUEST_SIZE;
+    }
+
+    return position;
+}
+
+void encodeRequest(const Request& request, std::string* out) {
+    appendUInt32(static_cast<uint32_t>(REQUEST_SIZE - 4), out);
+    appendUInt64(request.requestId, out);
+    appendUInt32(static_cast<uint32_t>(request.opcode), out);
+    appendUInt32(static_cast<uint32_t>(request.durability), out);
+    appendUInt64(static_cast<uint64_t>(request.nodeAId), out);
+    appendUInt64(static_cast<uint64_t>(request.nodeBId), out);
+}
+
+void encodeResponse(uint64_t requestId, StatusCode status, std::string* out) {
+    appendResponseHeader(requestId, status, 0, out);
+}
+
+void encodeNeighbors(uint64_t requestId, const NodeIdList& neighbors, std::string* out) {
+    appendResponseHeader(requestId, StatusCode::SUCCESS, 4 + 8 * neighbors.size(), out);
+    appendUInt32(static_cast<uint32_t>(neighbors.size()), out);
+    for (NodeId neighbor : neighbors) {
+        appendUInt64(static_cast<uint64_t>(neighbor), out);
+    }
+}
+
+void encodeDistance(uint64_t requestId, uint64_t distance, std::string* out) {
+    appendResponseHeader(requestId, StatusCode::SUCCESS, 8, out);
+    appendUInt64(distance, out);
+}
+
+}
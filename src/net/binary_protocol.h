@@ -0,0 +1,98 @@
+// The binary protocol, a compact alternative to the HTTP API.
+//
+// Every message is a frame: a 32 bit length, followed by that many bytes.
+// All integers are little endian.
+//
+// A request frame holds:
+//
+//     uint64 request id
+//     uint32 opcode
+//     uint32 durability   (0: sync, 1: group, 2: async; ignored by reads)
+//     int64  node a id    (the node id, for node operations)
+//     int64  node b id    (0, for node operations)
+//
+// A response frame holds:
+//
+//     uint64 request id
+//     uint32 status       (a StatusCode)
+//     ...    payload      (only on success, and only for some opcodes)
+//
+// A client may send any number of requests before reading the responses.
+// The requests of a connection are applied in order, and answered in order.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "db/graph_store.h"
+#include "db/log_manager.h"
+#include "db/types.h"
+#include "util/status.h"
+
+namespace binary {
+
+/**
+ * The operations of a request.  Writes share their codes with the log.
+ */
+enum class OpCode : uint32_t {
+    ADD_NODE = static_cast<uint32_t>(LogManager::OpCode::ADD_NODE),
+    ADD_EDGE = static_cast<uint32_t>(LogManager::OpCode::ADD_EDGE),
+    REMOVE_NODE = static_cast<uint32_t>(LogManager::OpCode::REMOVE_NODE),
+    REMOVE_EDGE = static_cast<uint32_t>(LogManager::OpCode::REMOVE_EDGE),
+
+    GET_NODE = 16,
+    GET_EDGE,
+    // Payload: uint32 count, then count int64 node ids.
+    GET_NEIGHBORS,
+    // Payload: uint64 distance.
+    SHORTEST_PATH
+};
+
+// The size of a request frame, including its length.
+const std::size_t REQUEST_SIZE = 4 + 32;
+
+struct Request {
+    uint64_t requestId;
+    OpCode opcode;
+    Durability durability;
+    NodeId nodeAId;
+    NodeId nodeBId;
+
+    // Unset if the opcode or durability is unknown.
+    bool valid;
+};
+
+/**
+ * Decode the complete request frames at the start of 'data', appending them
+ * to 'requests'.
+ *
+ * Returns: The number of bytes decoded, or INVALID if a frame is malformed,
+ * after which the stream cannot be read further.
+ */
+StatusWith<std::size_t> decodeRequests(const char* data, std::size_t size,
+                                       std::vector<Request>* requests);
+
+/**
+ * Append a request frame to 'out'.
+ */
+void encodeRequest(const Request& request, std::string* out);
+
+/**
+ * Append a response frame without a payload to 'out'.
+ */
+void encodeResponse(uint64_t requestId, StatusCode status, std::string* out);
+
+/**
+ * Append a successful GET_NEIGHBORS response frame to 'out'.
+ */
+void encodeNeighbors(uint64_t requestId, const NodeIdList& neighbors, std::string* out);
+
+/**
+ * Append a successful SHORTEST_PATH response frame to 'out'.
+ */
+void encodeDistance(uint64_t requestId, uint64_t distance, std::string* out);
+
+}
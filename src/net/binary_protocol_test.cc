@@ -0,0 +1,73 @@
+#include "net/binary_protocol.h"
+
+#include <string>
+#include <vector>
+
+#include "util/testing.h"
+
+TEST(BinaryProtocolDecodeRequests) {
+    std::string data;
+    binary::encodeRequest({7, binary::OpCode::ADD_EDGE, Durability::GROUP, 1, -2, true}, &data);
+    binary::encodeRequest({8, binary::OpCode::GET_NODE, Durability::SYNC, 3, 0, true}, &data);
+
+    // Only complete frames are decoded.
+    std::vector<binary::Request> requests;
+    auto decoded = binary::decodeRequests(data.data(), data.size() - 1, &requests);
+    EXPECT_TRUE(decoded);
+    EXPECT_EQ(*decoded, binary::REQUEST_SIZE);
+    EXPECT_EQ(requests.size(), 1);
+
+    decoded = binary::decodeRequests(data.data() + *decoded, data.size() - *decoded, &requests);
+    EXPECT_EQ(*decoded, binary::REQUEST_SIZE);
+    EXPECT_EQ(requests.size(), 2);
+
+    EXPECT_EQ(requests[0].requestId, 7);
+    EXPECT_TRUE(requests[0].opcode == binary::OpCode::ADD_EDGE);
+    EXPECT_TRUE(requests[0].durability == Durability::GROUP);
+    EXPECT_EQ(requests[0].nodeAId, 1);
+    EXPECT_EQ(requests[0].nodeBId, -2);
+    EXPECT_TRUE(requests[0].valid);
+    EXPECT_TRUE(requests[1].opcode == binary::OpCode::GET_NODE);
+    EXPECT_EQ(requests[1].nodeAId, 3);
+
+    END;
+}
+
+TEST(BinaryProtocolInvalidRequests) {
+    // Unknown opcodes are answered, but frames of the wrong size end the
+    // stream.
+    std::string data;
+    binary::encodeRequest({1, static_cast<binary::OpCode>(99), Durability::SYNC, 1, 0, true}, &data);
+    std::vector<binary::Request> requests;
+    auto decoded = binary::decodeRequests(data.data(), data.size(), &requests);
+    EXPECT_EQ(*decoded, binary::REQUEST_SIZE);
+    EXPECT_FALSE(requests[0].valid);
+
+    data[0] = 31;
+    EXPECT_FALSE(binary::decodeRequests(data.data(), data.size(), &requests));
+
+    END;
+}
+
+TEST(BinaryProtocolEncodeResponses) {
+    std::string data;
+    binary::encodeResponse(5, StatusCode::NO_ACTION, &data);
+    EXPECT_EQ(data.size(), 4 + 12);
+    EXPECT_EQ(data[0], 12);
+    EXPECT_EQ(data[4], 5);
+    EXPECT_EQ(data[12], static_cast<char>(StatusCode::NO_ACTION));
+
+    data.clear();
+    binary::encodeNeighbors(6, {1, 2, 3}, &data);
+    EXPECT_EQ(data.size(), 4 + 12 + 4 + 3 * 8);
+    EXPECT_EQ(data[16], 3);
+    EXPECT_EQ(data[28], 2);
+
+    END;
+}
+
+int main() {
+    BinaryProtocolDecodeRequests();
+    BinaryProtocolInvalidRequests();
+    BinaryProtocolEncodeResponses();
+}
@@ -0,0 +1,441 @@
+#include "net/binary_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "util/assert.h"
+
+namespace {
+
+// How many events the event loop takes at a time.
+constexpr int MAX_EVENTS = 64;
+
+// How much the event loop reads from a connection at a time.
+constexpr std::size_t READ_SIZE = 64 * 1024;
+
+// Get the batch operation of a node or edge request, or return false if it
+// is not one.
+bool toBatchOperation(const binary::Request& request, BatchOperation::Type* type) {
+    switch (request.opcode) {
+        case binary::OpCode::ADD_NODE:
+            *type = BatchOperation::Type::ADD_NODE;
+            return true;
+        case binary::OpCode::REMOVE_NODE:
+            *type = BatchOperation::Type::REMOVE_NODE;
+            return true;
+        case binary::OpCode::GET_NODE:
+            *type = BatchOperation::Type::GET_NODE;
+            return true;
+        case binary::OpCode::ADD_EDGE:
+            *type = BatchOperation::Type::ADD_EDGE;
+            return true;
+        case binary::OpCode::REMOVE_EDGE:
+            *type = BatchOperation::Type::REMOVE_EDGE;
+            return true;
+        case binary::OpCode::GET_EDGE:
+            *type = BatchOperation::Type::GET_EDGE;
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+BinaryServer::BinaryServer(int port, GraphStore* store, std::size_t workerCount)
+        : _port(port), _store(store), _workers(workerCount) {}
+
+BinaryServer::~BinaryServer() {
+    stop();
+}
+
+Status BinaryServer::start() {
+    invariant(_listenFd == -1);
+
+    _listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    check_errno(_listenFd);
+
+    int reuse = 1;
+    check_errno(setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(_port);
+    if (bind(_listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1 ||
+            listen(_listenFd, SOMAXCONN) == -1) {
+        ::close(_listenFd);
+        _listenFd = -1;
+        return StatusCode::ERROR;
+    }
+
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    check_errno(_epollFd);
+    _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    check_errno(_wakeFd);
+
+    for (int fd : {_listenFd, _wakeFd}) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        check_errno(epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event));
+    }
+
+    _loop = std::thread(&BinaryServer::run, this);
+    return StatusCode::SUCCESS;
+}
+
+void BinaryServer::stop() {
+    if (!_loop.joinable()) {
+        return;
+    }
+
+    _stopping = true;
+    uint64_t one = 1;
+    check_errno(::write(_wakeFd, &one, sizeof(one)));
+    _loop.join();
+
+    // The workers may still hand responses to the connections, which are
+    // closed once they are done.
+    _workers.stop();
+    for (const auto& entry : _connections) {
+        ::close(entry.first);
+    }
+    _connections.clear();
+    _woken.clear();
+
+    ::close(_listenFd);
+    ::close(_epollFd);
+    ::close(_wakeFd);
+    _listenFd = _epollFd = _wakeFd = -1;
+}
+
+void BinaryServer::run() {
+    struct epoll_event events[MAX_EVENTS];
+    while (!_stopping) {
+        int count = epoll_wait(_epollFd, events, MAX_EVENTS, -1);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        check_errno(count);
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _listenFd) {
+                accept();
+                continue;
+            } else if (fd == _wakeFd) {
+                collect();
+                continue;
+            }
+
+            auto it = _connections.find(fd);
+            if (it == _connections.end()) {
+                continue;
+            }
+
+            // Hold on to the connection, which may be closed below.
+            std::shared_ptr<Connection> connection = it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close(connection);
+                continue;
+            }
+
+            if (events[i].events & EPOLLOUT) {
+                write(connection);
+            }
+
+            if (events[i].events & EPOLLIN && _connections.count(fd)) {
+                read(connection);
+            }
+        }
+    }
+}
+
+void BinaryServer::accept() {
+    for (;;) {
+        int fd = accept4(_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            // Out of connections or descriptors for now.  Any error on the
+            // socket itself is left to its client.
+            return;
+        }
+
+        // Responses are written as soon as they are ready.
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        auto connection = std::make_shared<Connection>(fd);
+        _connections.emplace(fd, connection);
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        check_errno(epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event));
+    }
+}
+
+void BinaryServer::read(const std::shared_ptr<Connection>& connection) {
+    char buffer[READ_SIZE];
+    bool ended = false;
+    for (;;) {
+        ssize_t size = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (size == 0) {
+            // The requests already sent are still answered.
+            ended = true;
+            break;
+        } else if (size == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            close(connection);
+            return;
+        } else if (size == -1 && errno == EINTR) {
+            continue;
+        } else if (size == -1) {
+            break;
+        }
+
+        connection->input.append(buffer, size);
+        if (static_cast<std::size_t>(size) < sizeof(buffer)) {
+            break;
+        }
+    }
+
+    std::vector<binary::Request> requests;
+    auto decoded = binary::decodeRequests(connection->input.data(), connection->input.size(),
+                                          &requests);
+    if (!decoded) {
+        close(connection);
+        return;
+    }
+    connection->input.erase(0, *decoded);
+
+    bool submit = false;
+    std::size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->queued.insert(connection->queued.end(), requests.begin(), requests.end());
+        queued = connection->queued.size();
+        if (!connection->applying && !requests.empty()) {
+            connection->applying = submit = true;
+        }
+        connection->ended = connection->ended || ended;
+    }
+
+    if (submit) {
+        _workers.submit([this, connection] { apply(connection); });
+    }
+
+    if (ended) {
+        // Stops reading, and closes the connection if nothing is left to
+        // answer.
+        write(connection);
+    } else if (queued >= MAX_QUEUED) {
+        watch(connection, false, connection->writing);
+    }
+}
+
+void BinaryServer::write(const std::shared_ptr<Connection>& connection) {
+    while (connection->written < connection->output.size()) {
+        ssize_t size = send(connection->fd, connection->output.data() + connection->written,
+                            connection->output.size() - connection->written, MSG_NOSIGNAL);
+        if (size == -1 && errno == EINTR) {
+            continue;
+        } else if (size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (size == -1) {
+            close(connection);
+            return;
+        }
+
+        connection->written += size;
+    }
+
+    bool writing = connection->written < connection->output.size();
+    if (!writing) {
+        connection->output.clear();
+        connection->written = 0;
+    }
+
+    std::size_t queued;
+    bool ended;
+    bool answered;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        queued = connection->queued.size();
+        ended = connection->ended;
+        answered = queued == 0 && !connection->applying && connection->responses.empty();
+    }
+
+    if (ended && answered && !writing) {
+        close(connection);
+        return;
+    }
+
+    bool reading = !ended && queued < MAX_QUEUED &&
+                   connection->output.size() - connection->written < MAX_UNWRITTEN;
+    watch(connection, reading, writing);
+}
+
+void BinaryServer::close(const std::shared_ptr<Connection>& connection) {
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->closed = true;
+        connection->queued.clear();
+    }
+
+    // Closing the descriptor also removes it from the epoll set.
+    _connections.erase(connection->fd);
+    ::close(connection->fd);
+}
+
+void BinaryServer::collect() {
+    uint64_t count;
+    while (::read(_wakeFd, &count, sizeof(count)) == -1 && errno == EINTR) {}
+
+    std::vector<std::shared_ptr<Connection>> woken;
+    {
+        std::lock_guard<std::mutex> lock(_wokenMutex);
+        woken.swap(_woken);
+    }
+
+    for (const auto& connection : woken) {
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (connection->closed) {
+                continue;
+            }
+
+            connection->output.append(connection->responses);
+            connection->responses.clear();
+        }
+
+        write(connection);
+    }
+}
+
+void BinaryServer::watch(const std::shared_ptr<Connection>& connection, bool reading, bool writing) {
+    if (connection->reading == reading && connection->writing == writing) {
+        return;
+    }
+
+    struct epoll_event event = {};
+    event.events = (reading ? EPOLLIN : 0) | (writing ? EPOLLOUT : 0);
+    event.data.fd = connection->fd;
+    check_errno(epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection->fd, &event));
+
+    connection->reading = reading;
+    connection->writing = writing;
+}
+
+void BinaryServer::apply(const std::shared_ptr<Connection>& connection) {
+    for (;;) {
+        std::vector<binary::Request> requests;
+        bool ended = false;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (connection->closed || connection->queued.empty()) {
+                connection->applying = false;
+                ended = connection->ended && !connection->closed;
+            } else {
+                requests.swap(connection->queued);
+            }
+        }
+
+        if (requests.empty()) {
+            // The event loop closes an ended connection once it sees the
+            // last responses are written.
+            if (ended) {
+                wake(connection);
+            }
+            return;
+        }
+
+        std::string responses;
+        apply(requests, &responses);
+
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (connection->closed) {
+                connection->applying = false;
+                return;
+            }
+
+            connection->responses.append(responses);
+        }
+
+        wake(connection);
+    }
+}
+
+void BinaryServer::apply(const std::vector<binary::Request>& requests, std::string* out) {
+    std::size_t i = 0;
+    while (i < requests.size()) {
+        const binary::Request& request = requests[i];
+        if (!request.valid) {
+            binary::encodeResponse(request.requestId, StatusCode::INVALID, out);
+            i++;
+            continue;
+        }
+
+        // A run of node and edge operations is applied as one batch, at the
+        // strongest durability any of its writes asks for.  Reads ignore
+        // their durability field.
+        BatchOperation::Type type;
+        std::vector<BatchOperation> operations;
+        Durability durability = Durability::ASYNC;
+        std::size_t end = i;
+        while (end < requests.size() && requests[end].valid && toBatchOperation(requests[end], &type)) {
+            operations.emplace_back(type, requests[end].nodeAId, requests[end].nodeBId);
+            if (type != BatchOperation::Type::GET_NODE && type != BatchOperation::Type::GET_EDGE) {
+                durability = std::min(durability, requests[end].durability);
+            }
+            end++;
+        }
+
+        if (!operations.empty()) {
+            std::vector<Status> statuses = _store->applyBatch(operations, durability);
+            for (std::size_t j = 0; j < statuses.size(); j++) {
+                binary::encodeResponse(requests[i + j].requestId, statuses[j].getCode(), out);
+            }
+
+            i = end;
+            continue;
+        }
+
+        if (request.opcode == binary::OpCode::GET_NEIGHBORS) {
+            auto neighbors = _store->getNeighbors(request.nodeAId);
+            if (neighbors) {
+                binary::encodeNeighbors(request.requestId, *neighbors, out);
+            } else {
+                binary::encodeResponse(request.requestId, neighbors.getCode(), out);
+            }
+        } else {
+            auto distance = _store->shortestPath(request.nodeAId, request.nodeBId);
+            if (distance) {
+                binary::encodeDistance(request.requestId, *distance, out);
+            } else {
+                binary::encodeResponse(request.requestId, distance.getCode(), out);
+            }
+        }
+
+        i++;
+    }
+}
+
+void BinaryServer::wake(const std::shared_ptr<Connection>& connection) {
+    {
+        std::lock_guard<std::mutex> lock(_wokenMutex);
+        _woken.push_back(connection);
+    }
+
+    uint64_t one = 1;
+    while (::write(_wakeFd, &one, sizeof(one)) == -1 && errno == EINTR) {}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "db/graph_store.h"
+#include "net/binary_protocol.h"
+#include "net/worker_pool.h"
+#include "util/nocopy.h"
+#include "util/status.h"
+
+/**
+ * A server for the binary protocol (see net/binary_protocol.h).
+ *
+ * Connections are served by an epoll event loop thread, which reads and
+ * decodes requests and writes responses.  The decoded requests of a
+ * connection are applied by one worker at a time, in order, so a connection
+ * may have many requests outstanding while its writes stay ordered.  Runs of
+ * node and edge operations are applied as one batch.  A client may shut down
+ * its side once it has sent its requests: the connection is closed once
+ * their responses have been written.
+ *
+ * Writes go straight to the store, so the server may not be used with
+ * replication or partitioning.
+ */
+class BinaryServer {
+    DISALLOW_COPY(BinaryServer);
+public:
+    BinaryServer(int port, GraphStore* store, std::size_t workerCount);
+
+    ~BinaryServer();
+
+    /**
+     * Listen on the port, and start the event loop thread.
+     */
+    Status start();
+
+    /**
+     * Stop the event loop, once the requests being applied have finished.
+     */
+    void stop();
+
+private:
+    // Stop reading from a connection with this many requests queued, or this
+    // many bytes of responses unwritten, until its client catches up.
+    static const std::size_t MAX_QUEUED = 4096;
+    static const std::size_t MAX_UNWRITTEN = 4 << 20;
+
+    struct Connection {
+        explicit Connection(int fd) : fd(fd) {}
+
+        const int fd;
+
+        // Only used on the event loop.
+        std::string input;
+        std::string output;
+        std::size_t written = 0;
+        bool reading = true;
+        bool writing = false;
+
+        // Shared with the workers.
+        std::mutex mutex;
+        std::vector<binary::Request> queued;
+        std::string responses;
+        bool applying = false;
+        bool closed = false;
+        // Set once the client has shut down its side of the connection.
+        bool ended = false;
+    };
+
+    // Run the event loop until stopped.
+    void run();
+
+    void accept();
+    void read(const std::shared_ptr<Connection>& connection);
+    // Write what output can be written, and close the connection if its
+    // client has ended it and every response has been written.
+    void write(const std::shared_ptr<Connection>& connection);
+    void close(const std::shared_ptr<Connection>& connection);
+
+    // Move the responses of the connections woken by workers to their
+    // output, and write it.
+    void collect();
+
+    // Register for the events the connection is waiting on.
+    void watch(const std::shared_ptr<Connection>& connection, bool reading, bool writing);
+
+    // Apply the queued requests of a connection until there are none left.
+    // Run on a worker.
+    void apply(const std::shared_ptr<Connection>& connection);
+
+    // Apply 'requests' in order, appending their responses to 'out'.
+    void apply(const std::vector<binary::Request>& requests, std::string* out);
+
+    // Hand a connection's new responses to the event loop.
+    void wake(const std::shared_ptr<Connection>& connection);
+
+    int _port;
+    GraphStore* _store;
+
+    int _listenFd = -1;
+    int _epollFd = -1;
+    int _wakeFd = -1;
+
+    // Only used on the event loop.
+    std::unordered_map<int, std::shared_ptr<Connection>> _connections;
+
+    std::mutex _wokenMutex;
+    std::vector<std::shared_ptr<Connection>> _woken;
+
+    std::atomic<bool> _stopping{false};
+    WorkerPool _workers;
+    std::thread _loop;
+};
@@ -1,13 +1,201 @@
 #include "net/hatch_response.h"
 
+#include <cstdio>
 #include <string>
+#include <utility>
+
+#include "util/assert.h"
+
+namespace {
+
+// Append 'chunk' to 'out', framed for chunked transfer encoding.
+void appendFramedChunk(std::string& out, const std::string& chunk) {
+    char size[24];
+    int length = std::snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+    out.append(size, length);
+    out += chunk;
+    out += "\r\n";
+}
+
+} // namespace
+
+void appendJsonNumber(std::string& out, int64_t value) {
+    // Written backwards from the last digit.
+    char digits[20];
+    char* start = digits + sizeof(digits);
+    uint64_t magnitude = value < 0 ? -static_cast<uint64_t>(value) : value;
+    do {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (value < 0) {
+        out += '-';
+    }
+    out.append(start, digits + sizeof(digits) - start);
+}
+
+void HatchResponse::setNumber(const char* name, int64_t value) {
+    setField(name, value, false);
+}
+
+void HatchResponse::setBool(const char* name, bool value) {
+    setField(name, value, true);
+}
+
+void HatchResponse::setField(const char* name, int64_t value, bool isBool) {
+    invariant(fieldCount < MAX_FIELDS);
+    fields[fieldCount++] = {name, value, isBool};
+}
+
+void HatchResponse::setBody(std::string body) {
+    hasBody = true;
+    this->body = std::move(body);
+}
+
+void HatchResponse::appendChunk(std::string chunk) {
+    if (chunk.empty()) {
+        return;
+    }
+
+    Stream* stream = Stream::current();
+    if (!stream) {
+        chunks.push_back(std::move(chunk));
+        return;
+    }
+
+    std::string data;
+    if (!streamed) {
+        data = getChunkedHead();
+        streamed = true;
+        streamedCode = code;
+    }
+
+    appendFramedChunk(data, chunk);
+    stream->write(std::move(data));
+}
 
 std::string HatchResponse::getBody() {
     if (code == 204) {
         return {};
     }
 
-    std::string body = JsonResponse::getBody();
+    if (hasBody) {
+        return body;
+    }
+
+    if (!chunks.empty()) {
+        std::string body;
+        for (const auto& chunk : chunks) {
+            body += chunk;
+        }
+
+        return body;
+    }
+
+    if (fieldCount == 0) {
+        std::string body = JsonResponse::getBody();
+        return body;
+    }
+
+    // Written as Json::FastWriter would.
+    std::string body;
+    body.reserve(64);
+    body += '{';
+    for (std::size_t i = 0; i < fieldCount; i++) {
+        if (i > 0) {
+            body += ',';
+        }
+
+        body += '"';
+        body += fields[i].name;
+        body += "\":";
+        if (fields[i].isBool) {
+            body += fields[i].value ? "true" : "false";
+        } else {
+            appendJsonNumber(body, fields[i].value);
+        }
+    }
+    body += "}\n";
+
     return body;
 }
 
+std::string HatchResponse::getData() {
+    if (streamed && code != streamedCode) {
+        return {};
+    }
+
+    if (streamed || (!chunks.empty() && code != 204)) {
+        return getChunkedData();
+    }
+
+    std::string body = getBody();
+
+    std::string data;
+    data.reserve(128 + body.size());
+    data += "HTTP/1.0 ";
+    appendJsonNumber(data, code);
+    data += "\r\n";
+
+    if (!hasHeader("Content-Length")) {
+        data += "Content-Length: ";
+        appendJsonNumber(data, body.size());
+        data += "\r\n";
+    }
+
+    for (const auto& header : headers) {
+        data += header.first;
+        data += ": ";
+        data += header.second;
+        data += "\r\n";
+    }
+
+    data += "\r\n";
+    data += body;
+
+    return data;
+}
+
+std::string HatchResponse::getChunkedHead() {
+    // Chunked transfer encoding is only defined from HTTP/1.1 on.
+    std::string data;
+    data.reserve(128);
+    data += "HTTP/1.1 ";
+    appendJsonNumber(data, code);
+    data += "\r\nTransfer-Encoding: chunked\r\n";
+
+    for (const auto& header : headers) {
+        if (header.first != "Content-Length") {
+            data += header.first;
+            data += ": ";
+            data += header.second;
+            data += "\r\n";
+        }
+    }
+
+    data += "\r\n";
+    return data;
+}
+
+std::string HatchResponse::getChunkedData() {
+    std::size_t size = 0;
+    for (const auto& chunk : chunks) {
+        size += chunk.size() + 32;
+    }
+
+    std::string data;
+    if (!streamed) {
+        data = getChunkedHead();
+    }
+    data.reserve(data.size() + size + 8);
+
+    for (auto& chunk : chunks) {
+        appendFramedChunk(data, chunk);
+        std::string().swap(chunk);
+    }
+    chunks.clear();
+
+    data += "0\r\n\r\n";
+    return data;
+}
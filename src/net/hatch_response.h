@@ -1,12 +1,125 @@
 #include "mongoose/JsonResponse.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "util/nocopy.h"
 
 #pragma once
 
+/**
+ * Append 'value' to 'out', as Json::FastWriter writes it.
+ */
+void appendJsonNumber(std::string& out, int64_t value);
+
 class HatchResponse : public Mongoose::JsonResponse {
 public:
+    /**
+     * Where the chunks of a body are sent as they are appended, while their
+     * handler goes on.  Made current on a thread by a `Scope`.
+     */
+    class Stream {
+    public:
+        virtual ~Stream() = default;
+
+        /**
+         * Send the next part of the response, as written to the connection.
+         * Called on the handler's thread.
+         */
+        virtual void write(std::string data) = 0;
+
+        /**
+         * Get the stream of the request being handled by this thread, or
+         * null.
+         */
+        static Stream* current() {
+            return *currentSlot();
+        }
+
+        /**
+         * Makes a stream current on this thread while in scope.
+         */
+        class Scope {
+            DISALLOW_COPY(Scope);
+        public:
+            explicit Scope(Stream* stream) : _previous(current()) {
+                *currentSlot() = stream;
+            }
+
+            ~Scope() {
+                *currentSlot() = _previous;
+            }
+
+        private:
+            Stream* _previous;
+        };
+
+    private:
+        static Stream** currentSlot() {
+            static thread_local Stream* stream = nullptr;
+            return &stream;
+        }
+    };
+
     HatchResponse() = default;
 
+    /**
+     * Set a field of a flat response body, which is written directly rather
+     * than through a Json::Value.  Fields are written in the order they are
+     * set, and a response uses either these or the Json::Value, not both.
+     */
+    void setNumber(const char* name, int64_t value);
+    void setBool(const char* name, bool value);
+
+    /**
+     * Set the whole body, already serialized, in place of the fields or the
+     * Json::Value.
+     */
+    void setBody(std::string body);
+
+    /**
+     * Append a part of the body, in place of the fields or the Json::Value.
+     * A body given in chunks is sent with chunked transfer encoding.  With a
+     * `Stream` current, each chunk is sent as it is appended, after the code
+     * and headers, which must be set first.  A response whose code changes
+     * after that, as on failing partway, is cut off before its last chunk,
+     * so it can not be taken for complete.  Otherwise the chunks are kept
+     * until the response is written.
+     */
+    void appendChunk(std::string chunk);
+
     virtual std::string getBody();
+    virtual std::string getData();
+
+private:
+    static const std::size_t MAX_FIELDS = 4;
+
+    struct Field {
+        const char* name;
+        int64_t value;
+        bool isBool;
+    };
+
+    void setField(const char* name, int64_t value, bool isBool);
+
+    // Write the status line and headers of a chunked response.
+    std::string getChunkedHead();
+
+    // Frame the chunks of the body, releasing them, after those streamed.
+    std::string getChunkedData();
+
+    std::array<Field, MAX_FIELDS> fields;
+    std::size_t fieldCount = 0;
+
+    bool hasBody = false;
+    std::string body;
+
+    std::vector<std::string> chunks;
+    // Whether the head and chunks have been sent to a `Stream`, and the
+    // code sent.
+    bool streamed = false;
+    int streamedCode = 0;
 };
@@ -1,5 +1,12 @@
 #include "net/http_controller.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
 #include "json/json.h"
 #include "mongoose/JsonController.h"
 
@@ -7,12 +14,21 @@
 #include "db/logged_store.h"
 #include "db/memory_store.h"
 #include "db/types.h"
+#include "net/point_request.h"
+#include "util/cancellation.h"
 #include "util/status.h"
 #include "util/assert.h"
 
 using namespace Mongoose;
 
 namespace {
+    // The size of a page of neighbors, if none is given, and at most.
+    const uint64_t DEFAULT_PAGE_SIZE = 1000;
+    const uint64_t MAX_PAGE_SIZE = 1 << 20;
+
+    // The size of the chunks a stream of neighbors is sent in.
+    const std::size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
     void make400(JsonResponse& response) {
         response.setCode(400);
     }
@@ -29,24 +45,237 @@ namespace {
         response.setCode(501);
     }
 
+    void make504(JsonResponse& response) {
+        response.setCode(504);
+    }
+
     void make507(JsonResponse& response) {
         response.setCode(507);
     }
+
+    // Read a durability level by name.
+    bool parseDurabilityName(const char* name, std::size_t length, Durability* durability) {
+        static const struct {
+            const char* name;
+            Durability level;
+        } levels[] = {
+            {"sync", Durability::SYNC},
+            {"group", Durability::GROUP},
+            {"async", Durability::ASYNC},
+        };
+
+        for (const auto& level : levels) {
+            if (std::strlen(level.name) == length && std::memcmp(level.name, name, length) == 0) {
+                *durability = level.level;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Read the optional "durability" of a write request into 'durability'.
+    bool parseDurability(const Json::Value& value, Durability* durability) {
+        Json::Value level = value["durability"];
+        if (level.isNull() || !durability) {
+            return true;
+        }
+
+        if (!level.isString()) {
+            return false;
+        }
+
+        std::string name = level.asString();
+        return parseDurabilityName(name.data(), name.size(), durability);
+    }
+
+    bool parseDurability(const PointRequest& request, Durability* durability) {
+        if (!request.has(PointRequest::DURABILITY) || !durability) {
+            return true;
+        }
+
+        return parseDurabilityName(request.durability, request.durabilityLength, durability);
+    }
+
+    // Read one operation of a batch request.
+    StatusWith<BatchOperation> parseOperation(const Json::Value& value) {
+        if (!value.isObject() || !value["op"].isString()) {
+            return StatusCode::INVALID;
+        }
+
+        static const std::map<std::string, BatchOperation::Type> types = {
+            {"add_node", BatchOperation::Type::ADD_NODE},
+            {"remove_node", BatchOperation::Type::REMOVE_NODE},
+            {"get_node", BatchOperation::Type::GET_NODE},
+            {"add_edge", BatchOperation::Type::ADD_EDGE},
+            {"remove_edge", BatchOperation::Type::REMOVE_EDGE},
+            {"get_edge", BatchOperation::Type::GET_EDGE},
+        };
+
+        auto type = types.find(value["op"].asString());
+        if (type == types.end()) {
+            return StatusCode::INVALID;
+        }
+
+        switch (type->second) {
+            case BatchOperation::Type::ADD_NODE:
+            case BatchOperation::Type::REMOVE_NODE:
+            case BatchOperation::Type::GET_NODE:
+                if (!value["node_id"].isUInt64()) {
+                    return StatusCode::INVALID;
+                }
+
+                return BatchOperation(type->second, value["node_id"].asUInt64());
+            default:
+                if (!value["node_a_id"].isUInt64() || !value["node_b_id"].isUInt64()) {
+                    return StatusCode::INVALID;
+                }
+
+                return BatchOperation(type->second, value["node_a_id"].asUInt64(),
+                                      value["node_b_id"].asUInt64());
+        }
+    }
+
+    // Read the fields of a get_neighbors request which the scanner declined.
+    bool readNeighborsRequest(const Json::Value& value, PointRequest* request, bool* stream) {
+        if (!value.isObject() || !value["node_id"].isUInt64()) {
+            return false;
+        }
+
+        request->fields |= PointRequest::NODE_ID;
+        request->nodeId = value["node_id"].asUInt64();
+
+        if (!value["limit"].isNull()) {
+            if (!value["limit"].isUInt64()) {
+                return false;
+            }
+
+            request->fields |= PointRequest::LIMIT;
+            request->limit = value["limit"].asUInt64();
+        }
+
+        if (!value["after"].isNull()) {
+            if (!value["after"].isUInt64()) {
+                return false;
+            }
+
+            request->fields |= PointRequest::AFTER;
+            request->after = value["after"].asUInt64();
+        }
+
+        if (!value["stream"].isNull()) {
+            if (!value["stream"].isBool()) {
+                return false;
+            }
+
+            *stream = value["stream"].asBool();
+        }
+
+        return true;
+    }
+
+    // Serialize the response to a get_neighbors request, as Json::FastWriter
+    // would.  'next' is the cursor of the next page, if there is one.
+    std::string neighborsBody(NodeId nodeId, const NodeIdList& neighbors, const NodeId* next) {
+        std::string body;
+        body.reserve(32 + 8 * neighbors.size());
+        body += "{\"neighbors\":[";
+        for (std::size_t i = 0; i < neighbors.size(); i++) {
+            if (i > 0) {
+                body += ',';
+            }
+            appendJsonNumber(body, neighbors[i]);
+        }
+
+        body += ']';
+        if (next) {
+            body += ",\"next\":";
+            appendJsonNumber(body, *next);
+        }
+
+        body += ",\"node_id\":";
+        appendJsonNumber(body, nodeId);
+        body += "}\n";
+        return body;
+    }
+
+    bool isRead(const BatchOperation& operation) {
+        return operation.type == BatchOperation::Type::GET_NODE ||
+               operation.type == BatchOperation::Type::GET_EDGE;
+    }
+
+    // Send a write of a batch down the replication chain.
+    bool replicate(ReplicationManager& replManager, const BatchOperation& operation) {
+        switch (operation.type) {
+            case BatchOperation::Type::ADD_NODE:
+                return replManager.replicateAddNode(operation.nodeAId);
+            case BatchOperation::Type::REMOVE_NODE:
+                return replManager.replicateRemoveNode(operation.nodeAId);
+            case BatchOperation::Type::ADD_EDGE:
+                return replManager.replicateAddEdge(operation.nodeAId, operation.nodeBId);
+            case BatchOperation::Type::REMOVE_EDGE:
+                return replManager.replicateRemoveEdge(operation.nodeAId, operation.nodeBId);
+            default:
+                return true;
+        }
+    }
+
+    // Get the result of an operation of a batch, with the response code its
+    // single request would get.
+    Json::Value batchResult(const BatchOperation& operation, const Status& status) {
+        Json::Value result(Json::ValueType::objectValue);
+        if (isRead(operation)) {
+            result["code"] = 200;
+            result["in_graph"] = status.getCode() == StatusCode::SUCCESS;
+        } else if (status.getCode() == StatusCode::NO_ACTION) {
+            result["code"] = 204;
+        } else if (status.getCode() == StatusCode::NO_SPACE) {
+            result["code"] = 507;
+        } else if (!status) {
+            result["code"] = 400;
+        } else {
+            result["code"] = 200;
+        }
+
+        return result;
+    }
 }
 
 
-StatusWith<Json::Value> HTTPController::getJSON(Request& request) {
+std::unique_lock<std::mutex> HTTPController::lockForwarding() {
+    if (!replManager && !partManager) {
+        return {};
+    }
+
+    return std::unique_lock<std::mutex>(forwardingMutex);
+}
+
+StatusWith<Json::Value> HTTPController::getJSON(const std::string& data) {
     Json::Reader r;
     Json::Value v;
-    if (!r.parse(request.getData(), v)) {
+    if (!r.parse(data, v)) {
         return StatusCode::INVALID;
     }
 
     return v;
 }
 
-StatusWith<NodeId> HTTPController::getNodeId(Request &request, HatchResponse& response) {
-    auto status_with_json = getJSON(request);
+StatusWith<NodeId> HTTPController::getNodeId(Request &request, HatchResponse& response,
+                                             Durability* durability) {
+    std::string data = request.getData();
+
+    // Most requests are read by the scanner, and the rest in full by jsoncpp.
+    PointRequest point;
+    if (scanPointRequest(data, &point)) {
+        if (!point.has(PointRequest::NODE_ID) || !parseDurability(point, durability)) {
+            make400(response);
+            return StatusCode::INVALID;
+        }
+
+        return point.nodeId;
+    }
+
+    auto status_with_json = getJSON(data);
 
     if (!status_with_json) {
         make400(response);
@@ -55,7 +284,7 @@ StatusWith<NodeId> HTTPController::getNodeId(Request &request, HatchResponse& re
 
     Json::Value value = *status_with_json;
     Json::Value nodeId = value["node_id"];
-    if (!nodeId.isUInt64()) {
+    if (!nodeId.isUInt64() || !parseDurability(value, durability)) {
         make400(response);
         return StatusCode::INVALID;
     }
@@ -63,8 +292,22 @@ StatusWith<NodeId> HTTPController::getNodeId(Request &request, HatchResponse& re
     return nodeId.asUInt64();
 }
 
-StatusWith<std::pair<NodeId, NodeId>> HTTPController::getEdgeIds(Request &request, HatchResponse& response) {
-    auto status_with_json = getJSON(request);
+StatusWith<std::pair<NodeId, NodeId>> HTTPController::getEdgeIds(Request &request, HatchResponse& response,
+                                                                 Durability* durability) {
+    std::string data = request.getData();
+
+    PointRequest point;
+    if (scanPointRequest(data, &point)) {
+        if (!point.has(PointRequest::NODE_A_ID) || !point.has(PointRequest::NODE_B_ID) ||
+                !parseDurability(point, durability)) {
+            make400(response);
+            return StatusCode::INVALID;
+        }
+
+        return {{point.nodeAId, point.nodeBId}};
+    }
+
+    auto status_with_json = getJSON(data);
 
     if (!status_with_json) {
         make400(response);
@@ -79,7 +322,7 @@ StatusWith<std::pair<NodeId, NodeId>> HTTPController::getEdgeIds(Request &reques
     }
 
     Json::Value nodeBId = value["node_b_id"];
-    if (!nodeBId.isUInt64()) {
+    if (!nodeBId.isUInt64() || !parseDurability(value, durability)) {
         make400(response);
         return StatusCode::INVALID;
     }
@@ -88,7 +331,9 @@ StatusWith<std::pair<NodeId, NodeId>> HTTPController::getEdgeIds(Request &reques
 }
 
 void HTTPController::add_node(Request& request, HatchResponse& response) {
-    auto status_with_node_id  = getNodeId(request, response);
+    auto forwarding = lockForwarding();
+    Durability durability = Durability::SYNC;
+    auto status_with_node_id  = getNodeId(request, response, &durability);
     if (!status_with_node_id) {
         return;
     }
@@ -105,7 +350,7 @@ void HTTPController::add_node(Request& request, HatchResponse& response) {
         return;
     }
 
-    auto status = store->addNode(nodeId);
+    auto status = store->addNode(nodeId, durability);
     if (status == StatusCode::NO_ACTION) {
         make204(response);
         return;
@@ -117,12 +362,14 @@ void HTTPController::add_node(Request& request, HatchResponse& response) {
         return;
     }
 
-    response["node_id"] = nodeId;
+    response.setNumber("node_id", nodeId);
     return;
 }
 
 void HTTPController::remove_node(Request& request, HatchResponse& response) {
-    auto status_with_node_id = getNodeId(request, response);
+    auto forwarding = lockForwarding();
+    Durability durability = Durability::SYNC;
+    auto status_with_node_id = getNodeId(request, response, &durability);
     if (!status_with_node_id) {
         return;
     }
@@ -144,7 +391,7 @@ void HTTPController::remove_node(Request& request, HatchResponse& response) {
         return;
     }
 
-    auto status = store->removeNode(nodeId);
+    auto status = store->removeNode(nodeId, durability);
     if (status == StatusCode::NO_SPACE) {
         make507(response);
         return;
@@ -153,7 +400,7 @@ void HTTPController::remove_node(Request& request, HatchResponse& response) {
         return;
     }
 
-    response["node_id"] = nodeId;
+    response.setNumber("node_id", nodeId);
     return;
 }
 
@@ -171,7 +418,7 @@ void HTTPController::get_node(Request& request, HatchResponse& response) {
 
     auto status = store->findNode(nodeId);
 
-    response["in_graph"] = status.getCode() == StatusCode::SUCCESS;
+    response.setBool("in_graph", status.getCode() == StatusCode::SUCCESS);
     return;
 }
 
@@ -179,7 +426,8 @@ bool HTTPController::isPartitionedEdgeOp(NodeId nodeAId, NodeId nodeBId) const {
     return partConfig.target(nodeAId) != partConfig.us() || partConfig.target(nodeBId) != partConfig.us();
 }
 
-void HTTPController::add_edge_partition(NodeId nodeAId, NodeId nodeBId, HatchResponse &response) {
+void HTTPController::add_edge_partition(NodeId nodeAId, NodeId nodeBId, Durability durability,
+                                        HatchResponse &response) {
     StatusWith<std::pair<NodeId, NodeId>> edge = partManager->getEdgePart(nodeAId, nodeBId);
     if (!edge) {
         make400(response);
@@ -203,15 +451,17 @@ void HTTPController::add_edge_partition(NodeId nodeAId, NodeId nodeBId, HatchRes
         return;
     }
 
-    invariant(store->addEdgePart(edge->first, edge->second));
+    invariant(store->addEdgePart(edge->first, edge->second, durability));
 
-    response["node_a_id"] = nodeAId;
-    response["node_b_id"] = nodeBId;
+    response.setNumber("node_a_id", nodeAId);
+    response.setNumber("node_b_id", nodeBId);
     return;
 }
 
 void HTTPController::add_edge(Request& request, HatchResponse& response) {
-    auto status_with_node_ids  = getEdgeIds(request, response);
+    auto forwarding = lockForwarding();
+    Durability durability = Durability::SYNC;
+    auto status_with_node_ids  = getEdgeIds(request, response, &durability);
     if (!status_with_node_ids) {
         return;
     }
@@ -221,7 +471,7 @@ void HTTPController::add_edge(Request& request, HatchResponse& response) {
 
     // Handle partitioning logic
     if (partManager && isPartitionedEdgeOp(nodeAId, nodeBId)) {
-        add_edge_partition(nodeAId, nodeBId, response);
+        add_edge_partition(nodeAId, nodeBId, durability, response);
         return;
     }
 
@@ -240,7 +490,7 @@ void HTTPController::add_edge(Request& request, HatchResponse& response) {
         return;
     }
 
-    auto status = store->addEdge(nodeAId, nodeBId);
+    auto status = store->addEdge(nodeAId, nodeBId, durability);
     if (status == StatusCode::NO_ACTION) {
         make204(response);
         return;
@@ -252,12 +502,13 @@ void HTTPController::add_edge(Request& request, HatchResponse& response) {
         return;
     }
 
-    response["node_a_id"] = nodeAId;
-    response["node_b_id"] = nodeBId;
+    response.setNumber("node_a_id", nodeAId);
+    response.setNumber("node_b_id", nodeBId);
     return;
 }
 
-void HTTPController::remove_edge_partition(NodeId nodeAId, NodeId nodeBId, HatchResponse &response) {
+void HTTPController::remove_edge_partition(NodeId nodeAId, NodeId nodeBId, Durability durability,
+                                           HatchResponse &response) {
     StatusWith<std::pair<NodeId, NodeId>> edge = partManager->getEdgePart(nodeAId, nodeBId);
     if (!edge) {
         make400(response);
@@ -281,15 +532,17 @@ void HTTPController::remove_edge_partition(NodeId nodeAId, NodeId nodeBId, Hatch
         return;
     }
 
-    invariant(store->removeEdgePart(edge->first, edge->second));
+    invariant(store->removeEdgePart(edge->first, edge->second, durability));
 
-    response["node_a_id"] = nodeAId;
-    response["node_b_id"] = nodeBId;
+    response.setNumber("node_a_id", nodeAId);
+    response.setNumber("node_b_id", nodeBId);
     return;
 }
 
 void HTTPController::remove_edge(Request& request, HatchResponse& response) {
-    auto status_with_node_ids  = getEdgeIds(request, response);
+    auto forwarding = lockForwarding();
+    Durability durability = Durability::SYNC;
+    auto status_with_node_ids  = getEdgeIds(request, response, &durability);
     if (!status_with_node_ids) {
         return;
     }
@@ -299,7 +552,7 @@ void HTTPController::remove_edge(Request& request, HatchResponse& response) {
 
     // Handle partitioning logic
     if (partManager && isPartitionedEdgeOp(nodeAId, nodeBId)) {
-        remove_edge_partition(nodeAId, nodeBId, response);
+        remove_edge_partition(nodeAId, nodeBId, durability, response);
         return;
     }
 
@@ -318,7 +571,7 @@ void HTTPController::remove_edge(Request& request, HatchResponse& response) {
         return;
     }
 
-    auto status = store->removeEdge(nodeAId, nodeBId);
+    auto status = store->removeEdge(nodeAId, nodeBId, durability);
     if (status == StatusCode::NO_SPACE) {
         make507(response);
         return;
@@ -327,8 +580,8 @@ void HTTPController::remove_edge(Request& request, HatchResponse& response) {
         return;
     }
 
-    response["node_a_id"] = nodeAId;
-    response["node_b_id"] = nodeBId;
+    response.setNumber("node_a_id", nodeAId);
+    response.setNumber("node_b_id", nodeBId);
     return;
 }
 
@@ -354,37 +607,163 @@ void HTTPController::get_edge(Request& request, HatchResponse& response) {
         status = store->getEdge(nodeAId, nodeBId);
     }
 
-    response["in_graph"] = status.getCode() == StatusCode::SUCCESS;
+    response.setBool("in_graph", status.getCode() == StatusCode::SUCCESS);
 
     return;
 }
 
 void HTTPController::get_neighbors(Request& request, HatchResponse& response) {
-    auto status_with_node_id = getNodeId(request, response);
-    if (!status_with_node_id) {
-        return;
+    std::string data = request.getData();
+
+    PointRequest point;
+    bool stream = false;
+    if (!scanPointRequest(data, &point)) {
+        auto status_with_json = getJSON(data);
+        if (!status_with_json || !readNeighborsRequest(*status_with_json, &point, &stream)) {
+            make400(response);
+            return;
+        }
     }
 
-    NodeId nodeId = *status_with_node_id;
+    bool paged = point.has(PointRequest::LIMIT) || point.has(PointRequest::AFTER);
+    if (!point.has(PointRequest::NODE_ID) || (point.has(PointRequest::LIMIT) && point.limit == 0) ||
+            (paged && stream)) {
+        make400(response);
+        return;
+    }
 
+    NodeId nodeId = point.nodeId;
     if (partManager && partConfig.target(nodeId) != partConfig.us()) {
         make400(response);
         return;
     }
 
+    if (paged) {
+        get_neighbor_page(point, response);
+        return;
+    }
+
+    if (stream) {
+        // Serialized from the adjacency of the node, while the store is
+        // locked, rather than copied out first.
+        // Once nobody waits for the response, the rest of the neighbors
+        // are skipped, checking before each chunk.
+        const Cancellation* cancellation = Cancellation::current();
+        bool cancelled = false;
+        std::string chunk = "{\"neighbors\":[";
+        bool first = true;
+        auto status = store->visitNeighbors(nodeId, [&](NodeId neighbor) {
+            if (cancelled) {
+                return;
+            }
+
+            if (!first) {
+                chunk += ',';
+            }
+            first = false;
+            appendJsonNumber(chunk, neighbor);
+
+            if (chunk.size() >= STREAM_CHUNK_SIZE) {
+                cancelled = cancellation && cancellation->isCancelled();
+                if (!cancelled) {
+                    response.appendChunk(std::move(chunk));
+                    chunk.clear();
+                    chunk.reserve(STREAM_CHUNK_SIZE + 32);
+                }
+            }
+        });
+
+        if (!status) {
+            make400(response);
+            return;
+        }
+
+        if (cancelled) {
+            make504(response);
+            return;
+        }
+
+        chunk += "],\"node_id\":";
+        appendJsonNumber(chunk, nodeId);
+        chunk += "}\n";
+        response.appendChunk(std::move(chunk));
+        return;
+    }
+
+    if (neighborCache) {
+        auto cached = neighborCache->getSerializedNeighbors(nodeId, [](NodeId id, const NodeIdList& neighbors) {
+            return neighborsBody(id, neighbors, nullptr);
+        });
+        if (!cached) {
+            make400(response);
+            return;
+        }
+
+        response.setBody(**cached);
+        return;
+    }
+
     auto status = store->getNeighbors(nodeId);
     if (!status) {
         make400(response);
         return;
     }
 
-    Json::Value neighbors(Json::ValueType::arrayValue);
-    for (auto&& node : *status) {
-        neighbors.append(node);
+    response.setBody(neighborsBody(nodeId, *status, nullptr));
+    return;
+}
+
+void HTTPController::get_neighbor_page(const PointRequest& request, HatchResponse& response) {
+    std::size_t limit = std::min<uint64_t>(request.has(PointRequest::LIMIT) ? request.limit : DEFAULT_PAGE_SIZE,
+                                           MAX_PAGE_SIZE);
+
+    // Pages start after the last neighbor of the previous page.  One more
+    // neighbor than asked for is found, to tell if there are more.
+    NodeId from = std::numeric_limits<NodeId>::min();
+    std::size_t found = limit + 1;
+    if (request.has(PointRequest::AFTER)) {
+        if (request.after == std::numeric_limits<NodeId>::max()) {
+            found = 0;
+        } else {
+            from = request.after + 1;
+        }
     }
 
-    response["node_id"] = nodeId;
-    response["neighbors"] = neighbors;
+    auto status = store->getNeighborPage(request.nodeId, from, found);
+    if (!status) {
+        make400(response);
+        return;
+    }
+
+    NodeIdList& page = *status;
+    if (page.size() > limit) {
+        page.pop_back();
+        response.setBody(neighborsBody(request.nodeId, page, &page.back()));
+    } else {
+        response.setBody(neighborsBody(request.nodeId, page, nullptr));
+    }
+}
+
+void HTTPController::get_degree(Request& request, HatchResponse& response) {
+    auto status_with_node_id = getNodeId(request, response);
+    if (!status_with_node_id) {
+        return;
+    }
+
+    NodeId nodeId = *status_with_node_id;
+    if (partManager && partConfig.target(nodeId) != partConfig.us()) {
+        make400(response);
+        return;
+    }
+
+    auto status = store->getDegree(nodeId);
+    if (!status) {
+        make400(response);
+        return;
+    }
+
+    response.setNumber("degree", *status);
+    response.setNumber("node_id", nodeId);
     return;
 }
 
@@ -402,22 +781,43 @@ void HTTPController::shortest_path(Request& request, HatchResponse& response) {
         return;
     }
 
-    auto status = store->shortestPath(nodeAId, nodeBId);
+    // Stopped once the request is abandoned, or its deadline passes.
+    auto status = store->shortestPath(nodeAId, nodeBId, Cancellation::current());
     if (status == StatusCode::NO_ACTION) {
         make204(response);
         return;
+    } else if (status == StatusCode::CANCELLED) {
+        make504(response);
+        return;
     } else if (!status) {
         make400(response);
         return;
     }
 
-    response["distance"] = *status;
+    response.setNumber("distance", *status);
 
     return;
 }
 
+void HTTPController::cache_stats(Mongoose::Request &request, HatchResponse& response) {
+    if (!neighborCache) {
+        make501(response);
+        return;
+    }
+
+    auto stats = neighborCache->getStats();
+    uint64_t lookups = stats.hits + stats.misses;
+    response["hits"] = static_cast<Json::UInt64>(stats.hits);
+    response["misses"] = static_cast<Json::UInt64>(stats.misses);
+    response["hit_rate"] = lookups ? static_cast<double>(stats.hits) / lookups : 0.0;
+    response["entries"] = static_cast<Json::UInt64>(stats.entries);
+    response["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+    response["capacity"] = static_cast<Json::UInt64>(stats.capacity);
+}
+
 void HTTPController::checkpoint(Mongoose::Request &request, HatchResponse& response) {
-    if (!loggingEnabled) {
+    auto forwarding = lockForwarding();
+    if (!loggedStore) {
         make501(response);
         return;
     }
@@ -432,7 +832,6 @@ void HTTPController::checkpoint(Mongoose::Request &request, HatchResponse& respo
         return;
     }
 
-    auto *loggedStore = dynamic_cast<LoggedStore*>(store);
     auto status = loggedStore->checkpoint();
     if (status == StatusCode::NO_SPACE) {
         make507(response);
@@ -441,8 +840,67 @@ void HTTPController::checkpoint(Mongoose::Request &request, HatchResponse& respo
 
     invariant(status);
 
-    response["ok"] = 1;
+    response.setNumber("ok", 1);
+
+    return;
+}
+
+void HTTPController::batch(Request& request, HatchResponse& response) {
+    auto forwarding = lockForwarding();
+    auto status_with_json = getJSON(request.getData());
+    Durability durability = Durability::SYNC;
+    if (!status_with_json || !(*status_with_json)["operations"].isArray() ||
+            !parseDurability(*status_with_json, &durability)) {
+        make400(response);
+        return;
+    }
+
+    // Edges across partitions are each added on another server too.
+    if (partManager) {
+        make400(response);
+        return;
+    }
+
+    const Json::Value& items = (*status_with_json)["operations"];
+    std::vector<BatchOperation> operations;
+    operations.reserve(items.size());
+    for (const Json::Value& item : items) {
+        auto status_with_operation = parseOperation(item);
+        if (!status_with_operation) {
+            make400(response);
+            return;
+        }
+
+        operations.push_back(*status_with_operation);
+    }
+
+    // Writes are replicated before they are applied, and writes which fail
+    // to replicate are not applied.
+    std::vector<Json::Value> results(operations.size());
+    std::vector<std::size_t> applied;
+    std::vector<BatchOperation> toApply;
+    for (std::size_t i = 0; i < operations.size(); i++) {
+        if (replManager && !isRead(operations[i]) &&
+                (!replManager->writesAllowed() || !replicate(*replManager, operations[i]))) {
+            results[i]["code"] = 500;
+            continue;
+        }
+
+        applied.push_back(i);
+        toApply.push_back(operations[i]);
+    }
+
+    std::vector<Status> statuses = store->applyBatch(toApply, durability);
+    for (std::size_t i = 0; i < applied.size(); i++) {
+        results[applied[i]] = batchResult(toApply[i], statuses[i]);
+    }
+
+    Json::Value resultList(Json::ValueType::arrayValue);
+    for (const auto& result : results) {
+        resultList.append(result);
+    }
 
+    response["results"] = resultList;
     return;
 }
 
@@ -455,6 +913,9 @@ void HTTPController::setup() {
     addRouteResponse("POST", "/remove_edge", HTTPController, remove_edge, HatchResponse);
     addRouteResponse("POST", "/get_edge", HTTPController, get_edge, HatchResponse);
     addRouteResponse("POST", "/get_neighbors", HTTPController, get_neighbors, HatchResponse);
+    addRouteResponse("POST", "/get_degree", HTTPController, get_degree, HatchResponse);
     addRouteResponse("POST", "/shortest_path", HTTPController, shortest_path, HatchResponse);
     addRouteResponse("POST", "/checkpoint", HTTPController, checkpoint, HatchResponse);
+    addRouteResponse("GET", "/cache_stats", HTTPController, cache_stats, HatchResponse);
+    addRouteResponse("POST", "/batch", HTTPController, batch, HatchResponse);
 }
@@ -1,20 +1,30 @@
 #include "mongoose/JsonController.h"
 
+#include <mutex>
+#include <string>
 #include <utility>
 
+#include "db/caching_store.h"
 #include "db/graph_store.h"
+#include "db/logged_store.h"
 #include "db/replication_manager.h"
 #include "db/partition/partition_config.h"
 #include "db/partition/partition_manager.h"
 
 #include "net/hatch_response.h"
+#include "net/point_request.h"
 
 #pragma once
 
 class HTTPController : public Mongoose::JsonController {
 public:
-    HTTPController(GraphStore* store, ReplicationManager* replManager, PartitionConfig config, PartitionManager* manager, bool loggingEnabled) :
-        store(store), replManager(replManager), partConfig(config), partManager(manager), loggingEnabled(loggingEnabled) {};
+    // 'loggedStore' is checkpointed, or null if logging is disabled.  With
+    // 'neighborCache', lists of neighbors are answered from it.  Both must
+    // be 'store', or be wrapped by it.
+    HTTPController(GraphStore* store, ReplicationManager* replManager, PartitionConfig config, PartitionManager* manager, LoggedStore* loggedStore,
+                   CachingStore* neighborCache = nullptr) :
+        store(store), replManager(replManager), partConfig(config), partManager(manager), loggedStore(loggedStore),
+        neighborCache(neighborCache) {};
 
     void add_node(Mongoose::Request& request, HatchResponse& response);
     void remove_node(Mongoose::Request& request, HatchResponse& response);
@@ -24,24 +34,54 @@ public:
     void remove_edge(Mongoose::Request& request, HatchResponse& response);
     void get_edge(Mongoose::Request& request, HatchResponse& response);
 
+    // Find the neighbors of a node.  With "limit" and "after", finds one
+    // page of them, in id order, and the cursor of the next page as "next".
+    // With "stream", sends them in chunks as they are read, without copying
+    // them out of the store first.
     void get_neighbors(Mongoose::Request& request, HatchResponse& response);
+    // Find the number of neighbors of a node.
+    void get_degree(Mongoose::Request& request, HatchResponse& response);
     void shortest_path(Mongoose::Request& request, HatchResponse& response);
 
     void checkpoint(Mongoose::Request& request, HatchResponse& response);
 
+    // Report the hits, misses, hit rate and size of the neighbor cache.
+    void cache_stats(Mongoose::Request& request, HatchResponse& response);
+
+    // Apply a list of operations, under one acquisition of the store lock
+    // and one commit, and report the response code of each.
+    void batch(Mongoose::Request& request, HatchResponse& response);
+
     void setup();
 private:
-    StatusWith<Json::Value> getJSON(Mongoose::Request& request);
-    StatusWith<NodeId> getNodeId(Mongoose::Request &request, HatchResponse& response);
-    StatusWith<std::pair<NodeId, NodeId>> getEdgeIds(Mongoose::Request &request, HatchResponse& response);
+    // Handlers run concurrently.  Writes sent on to other servers are
+    // serialized, so the replication chain and partitions see them in the
+    // order they are applied here, and the connections to those servers are
+    // used by one request at a time.  Returns an unlocked lock if writes are
+    // not sent on.
+    std::unique_lock<std::mutex> lockForwarding();
+
+    StatusWith<Json::Value> getJSON(const std::string& data);
+    // Read the ids of a request, and its durability if 'durability' is set.
+    StatusWith<NodeId> getNodeId(Mongoose::Request &request, HatchResponse& response,
+                                 Durability* durability = nullptr);
+    StatusWith<std::pair<NodeId, NodeId>> getEdgeIds(Mongoose::Request &request, HatchResponse& response,
+                                                     Durability* durability = nullptr);
+    void get_neighbor_page(const PointRequest& request, HatchResponse& response);
+
     bool isPartitionedEdgeOp(NodeId nodeAId, NodeId nodeBId) const;
 
-    void add_edge_partition(NodeId nodeAId, NodeId nodeBId, HatchResponse& response);
-    void remove_edge_partition(NodeId nodeAId, NodeId nodeBId, HatchResponse &response);
+    void add_edge_partition(NodeId nodeAId, NodeId nodeBId, Durability durability,
+                            HatchResponse& response);
+    void remove_edge_partition(NodeId nodeAId, NodeId nodeBId, Durability durability,
+                               HatchResponse &response);
 
     GraphStore *store;
     ReplicationManager *replManager;
     PartitionConfig partConfig;
     PartitionManager *partManager;
-    bool loggingEnabled;
+    LoggedStore *loggedStore;
+    CachingStore *neighborCache;
+
+    std::mutex forwardingMutex;
 };
@@ -0,0 +1,327 @@
+#include "net/http_server.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "json/json.h"
+#include "mongoose.h"
+#include "mongoose/StreamResponse.h"
+
+namespace {
+
+// Mongoose closes connections idle for 30 seconds, even while their request
+// is being handled.  A request still running close to that is answered
+// before its connection can be freed.
+constexpr std::chrono::seconds REQUEST_TIMEOUT{25};
+
+// How long the event loop waits for network activity at a time.
+constexpr int POLL_MILLISECONDS = 1000;
+
+// The classes of requests, by cost.
+enum RequestClass {
+    POINT,
+    BULK,
+    TRAVERSAL
+};
+
+const char* const CLASS_NAMES[] = {"point", "bulk", "traversal"};
+
+// Requests not named here are point operations, and are not coalesced.
+const struct Kind {
+    const char* suffix;
+    RequestClass requestClass;
+    bool coalesced;
+} REQUEST_KINDS[] = {
+    {"/get_neighbors", BULK, true},
+    {"/batch", BULK, false},
+    {"/checkpoint", BULK, false},
+    {"/shortest_path", TRAVERSAL, true},
+};
+
+const Kind POINT_KIND = {"", POINT, false};
+
+const char* const QUEUES_URI = "/queues";
+
+// The milliseconds a client will wait for the response to a request.
+const char* const DEADLINE_HEADER = "X-Deadline";
+
+const Kind& classify(const char* uri) {
+    std::size_t length = std::strlen(uri);
+    for (const auto& kind : REQUEST_KINDS) {
+        std::size_t suffixLength = std::strlen(kind.suffix);
+        if (length >= suffixLength && std::strcmp(uri + length - suffixLength, kind.suffix) == 0) {
+            return kind;
+        }
+    }
+
+    return POINT_KIND;
+}
+
+// For every traversal, four bulk operations and sixteen point operations
+// are started while all three are waiting.  Bulk operations may use half
+// of the workers, and traversals a quarter.
+std::vector<WorkerPool::Class> getClasses(std::size_t workerCount) {
+    return {
+        WorkerPool::Class(16, 0, 0),
+        WorkerPool::Class(4, std::max<std::size_t>(workerCount / 2, 1), 1024),
+        WorkerPool::Class(1, std::max<std::size_t>(workerCount / 4, 1), 256),
+    };
+}
+
+} // namespace
+
+HTTPServer::HTTPServer(int port, std::size_t workerCount)
+        : Mongoose::Server(port), _workers(workerCount, getClasses(workerCount)),
+          _coalesced(getClasses(workerCount).size()) {}
+
+HTTPServer::~HTTPServer() {
+    stop();
+
+    // The base class waits for its own loop to have finished.
+    destroyed = true;
+}
+
+void HTTPServer::start() {
+    if (server != NULL) {
+        throw std::string("Server is already running");
+    }
+
+    server = mg_create_server(this);
+    for (const auto& option : optionsMap) {
+        mg_set_option(server, option.first.c_str(), option.second.c_str());
+    }
+
+    mg_add_uri_handler(server, "/", &HTTPServer::onRequest);
+    mg_server_do_i_handle(server, &HTTPServer::handlesRequest);
+
+    stopped = false;
+    destroyed = false;
+    _loop = std::thread(&HTTPServer::run, this);
+}
+
+void HTTPServer::stop() {
+    stopped = true;
+    if (_loop.joinable()) {
+        _loop.join();
+    }
+}
+
+int HTTPServer::onRequest(struct mg_connection* connection) {
+    return static_cast<HTTPServer*>(connection->server_param)->serve(connection);
+}
+
+int HTTPServer::handlesRequest(struct mg_connection* connection) {
+    auto* server = static_cast<HTTPServer*>(connection->server_param);
+    return std::strcmp(connection->uri, QUEUES_URI) == 0 ||
+           server->handles(connection->request_method, connection->uri);
+}
+
+int HTTPServer::onWake(struct mg_connection*) {
+    // Only wakes the loop, which then finishes the requests handled.
+    return 1;
+}
+
+std::string HTTPServer::getQueueStats() const {
+    auto stats = _workers.getStats();
+
+    Json::Value value;
+    for (std::size_t i = 0; i < stats.size(); i++) {
+        Json::Value& queue = value[CLASS_NAMES[i]];
+        queue["queued"] = static_cast<Json::UInt64>(stats[i].queued);
+        queue["running"] = static_cast<Json::UInt64>(stats[i].running);
+        queue["rejected"] = static_cast<Json::UInt64>(stats[i].rejected);
+        queue["coalesced"] = static_cast<Json::UInt64>(_coalesced[i]);
+    }
+
+    return Json::FastWriter().write(value);
+}
+
+int HTTPServer::serve(struct mg_connection* connection) {
+    auto it = _jobs.find(connection);
+    if (it == _jobs.end() && std::strcmp(connection->uri, QUEUES_URI) == 0) {
+        Mongoose::StreamResponse response;
+        response.setHeader("Content-Type", "application/json");
+        response << getQueueStats();
+
+        Mongoose::Request request(connection);
+        request.writeResponse(&response);
+        return 1;
+    }
+
+    if (it == _jobs.end()) {
+        if (startJob(connection)) {
+            return 0;
+        }
+
+        Mongoose::StreamResponse response;
+        response.setCode(503);
+        response.setHeader("Retry-After", "1");
+        Mongoose::Request(connection).writeResponse(&response);
+        return 1;
+    }
+
+    // The connection is closing, and the response has nowhere to go.
+    if (connection->wsbits) {
+        finishJob(it);
+        return 1;
+    }
+
+    // The parts streamed are all posted before the job is done.
+    Job& job = *it->second.job;
+    bool done = job.done;
+    writeStream(job);
+
+    // A job is only dropped without a response once its deadline passed.
+    if (done && job.response) {
+        if (job.data.empty()) {
+            job.data = job.response->getData();
+        }
+
+        mg_write(connection, job.data.data(), job.data.size());
+    } else if (job.streaming) {
+        return 0;
+    } else if (done || std::chrono::steady_clock::now() >= it->second.deadline) {
+        Mongoose::StreamResponse response;
+        response.setCode(done || it->second.clientDeadline ? 504 : 503);
+        Mongoose::Request(connection).writeResponse(&response);
+    } else {
+        return 0;
+    }
+
+    finishJob(it);
+    return 1;
+}
+
+void HTTPServer::writeStream(Job& job) {
+    std::string data;
+    {
+        std::lock_guard<std::mutex> lock(job.streamMutex);
+        data.swap(job.streamData);
+    }
+
+    if (data.empty()) {
+        return;
+    }
+
+    job.streaming = true;
+    for (struct mg_connection* connection : job.waiting) {
+        mg_write(connection, data.data(), data.size());
+    }
+}
+
+bool HTTPServer::startJob(struct mg_connection* connection) {
+    const Kind& kind = classify(connection->uri);
+
+    Waiter waiter;
+    waiter.deadline = std::chrono::steady_clock::now() + REQUEST_TIMEOUT;
+    waiter.clientDeadline = false;
+
+    const char* header = mg_get_header(connection, DEADLINE_HEADER);
+    char* headerEnd;
+    long long milliseconds = header ? std::strtoll(header, &headerEnd, 10) : -1;
+    if (header && headerEnd != header && milliseconds >= 0) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+        if (deadline < waiter.deadline) {
+            waiter.deadline = deadline;
+            waiter.clientDeadline = true;
+        }
+    }
+
+    // Requests are identical if their url and body are.  A request only
+    // joins one which has not started, so is answered by a read made after
+    // it arrived, which sees every write acknowledged before then.
+    std::string key;
+    if (kind.coalesced) {
+        key.assign(connection->uri);
+        key += '\0';
+        if (connection->content_len > 0) {
+            key.append(connection->content, connection->content_len);
+        }
+
+        // The job runs until the last of the deadlines of its waiters.
+        auto shared = _sharedJobs.find(key);
+        if (shared != _sharedJobs.end() && !shared->second->started) {
+            waiter.job = shared->second;
+            waiter.job->waiting.push_back(connection);
+            waiter.job->cancellation.extendDeadline(waiter.clientDeadline ?
+                    waiter.deadline : std::chrono::steady_clock::time_point::max());
+            _jobs.emplace(connection, std::move(waiter));
+            _coalesced[kind.requestClass]++;
+            return true;
+        }
+    }
+
+    auto job = std::make_shared<Job>(connection, server);
+    if (waiter.clientDeadline) {
+        job->cancellation.setDeadline(waiter.deadline);
+    }
+
+    // Jobs cancelled while queued are not handled.
+    bool queued = _workers.submit([this, job] {
+        job->started = true;
+        if (!job->cancellation.isCancelled()) {
+            Cancellation::Scope scope(&job->cancellation);
+            HatchResponse::Stream::Scope streamScope(job.get());
+            job->response.reset(handleRequest(job->request));
+        }
+
+        job->done = true;
+        mg_iterate_over_connections(job->loop, &HTTPServer::onWake, nullptr);
+    }, kind.requestClass);
+
+    if (!queued) {
+        return false;
+    }
+
+    job->waiting.push_back(connection);
+    if (kind.coalesced) {
+        job->key = key;
+        _sharedJobs[key] = job;
+    }
+
+    waiter.job = std::move(job);
+    _jobs.emplace(connection, std::move(waiter));
+    return true;
+}
+
+void HTTPServer::finishJob(std::unordered_map<struct mg_connection*, Waiter>::iterator it) {
+    std::shared_ptr<Job> job = std::move(it->second.job);
+    job->waiting.erase(std::find(job->waiting.begin(), job->waiting.end(), it->first));
+    _jobs.erase(it);
+
+    if (job->waiting.empty() && !job->done) {
+        job->cancellation.cancel();
+    }
+
+    if (job->waiting.empty() && !job->key.empty()) {
+        auto shared = _sharedJobs.find(job->key);
+        if (shared != _sharedJobs.end() && shared->second == job) {
+            _sharedJobs.erase(shared);
+        }
+    }
+}
+
+void HTTPServer::Job::write(std::string data) {
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        streamData += data;
+    }
+
+    mg_iterate_over_connections(loop, &HTTPServer::onWake, nullptr);
+}
+
+void HTTPServer::run() {
+    while (!stopped) {
+        mg_poll_server(server, POLL_MILLISECONDS);
+    }
+
+    // Workers post back to the loop as they finish.
+    _workers.stop();
+    _jobs.clear();
+    _sharedJobs.clear();
+
+    mg_destroy_server(&server);
+    destroyed = true;
+}
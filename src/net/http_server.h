@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mongoose/Request.h"
+#include "mongoose/Response.h"
+#include "mongoose/Server.h"
+
+#include "net/hatch_response.h"
+#include "net/worker_pool.h"
+#include "util/cancellation.h"
+#include "util/nocopy.h"
+
+/**
+ * An HTTP server which runs request handlers on a pool of worker threads.
+ *
+ * Connections are served, and requests parsed and routed, on the event loop
+ * thread.  Each request's handler then runs on a worker while the loop goes
+ * on serving other connections, and its response is posted back to the loop
+ * to be written.  A slow request only holds up its own client.
+ *
+ * Handlers may run after the loop has moved on from their connection, so
+ * they may only use the method, url and body of a request, which are copied
+ * out of the connection.  Controllers must be safe to call concurrently.
+ *
+ * Requests are queued for the workers by their cost: point operations,
+ * bulk ones such as batches and neighbor lists, and traversals.  Point
+ * operations are favored, and bulk operations and traversals may only use
+ * some of the workers, so a burst of them cannot hold up point operations
+ * for long.  Once too many bulk operations or traversals are waiting, more
+ * are refused with 503.  The queues are described at "/queues", which
+ * is answered on the event loop, even while the workers are busy.
+ *
+ * Costly reads, of neighbors and paths, are coalesced: a read arriving
+ * while an identical one is still queued is given its response rather than
+ * handled again.  Reads which have started are not joined, as they may
+ * have missed writes acknowledged before the later read arrived.
+ *
+ * Handlers may stream their responses, through the `HatchResponse::Stream`
+ * of their thread.  Each part is posted back to the loop and written as it
+ * comes, and a response is no longer timed out once it has started.
+ *
+ * A request may carry an "X-Deadline" header, of the milliseconds its
+ * client will wait.  Once they pass, it is answered with 504.  A request
+ * is cancelled once no client waits for it, having closed its connection
+ * or passed its deadline: it is dropped if it has not started, and the
+ * handler may stop early, by checking 'Cancellation::current()'.  A write
+ * answered with 504 may still have been applied.
+ */
+class HTTPServer : public Mongoose::Server {
+    DISALLOW_COPY(HTTPServer);
+public:
+    HTTPServer(int port, std::size_t workerCount);
+
+    ~HTTPServer();
+
+    /**
+     * Start the event loop thread.
+     */
+    void start();
+
+    /**
+     * Stop the event loop, once the handlers running have finished.
+     */
+    void stop();
+
+private:
+    /**
+     * A request being handled by a worker.
+     */
+    struct Job : public HatchResponse::Stream {
+        Job(struct mg_connection* connection, struct mg_server* loop)
+                : request(connection), loop(loop) {}
+
+        // Post a part of a streamed response to the loop.
+        void write(std::string data) override;
+
+        Mongoose::Request request;
+        struct mg_server* loop;
+        // Cancelled once no connection waits for the response, or at the
+        // latest deadline of those waiting.
+        Cancellation cancellation;
+
+        // Set by the worker before it handles the request, and once
+        // 'response' is ready.
+        std::atomic<bool> started{false};
+        std::unique_ptr<Mongoose::Response> response;
+        std::atomic<bool> done{false};
+
+        // The parts of a streamed response posted and not yet written.
+        std::mutex streamMutex;
+        std::string streamData;
+
+        // The key of a read which may be coalesced, or empty.
+        std::string key;
+        // The connections waiting for the response, and the response as
+        // written to them.
+        std::vector<struct mg_connection*> waiting;
+        std::string data;
+        // Whether parts of the response have been written.
+        bool streaming = false;
+    };
+
+    /**
+     * A connection waiting for the response of a job.
+     */
+    struct Waiter {
+        std::shared_ptr<Job> job;
+        // When the connection stops waiting, and whether that is its
+        // client's deadline, or the server's timeout.
+        std::chrono::steady_clock::time_point deadline;
+        bool clientDeadline;
+    };
+
+    // The mongoose callbacks, which call into the server of the connection.
+    static int onRequest(struct mg_connection* connection);
+    static int handlesRequest(struct mg_connection* connection);
+    static int onWake(struct mg_connection* connection);
+
+    // Describe the queues of the workers, as JSON.
+    std::string getQueueStats() const;
+
+    // Start or continue handling the request on 'connection'.  Returns
+    // whether the request is finished with.  Called on the event loop.
+    int serve(struct mg_connection* connection);
+
+    // Write the parts of the response of 'job' posted so far to every
+    // connection waiting for it.
+    void writeStream(Job& job);
+
+    // Queue a new job for the request on 'connection', or join it to an
+    // identical one.  Returns false if the job's class is full.
+    bool startJob(struct mg_connection* connection);
+
+    // Stop waiting for the job of a connection, cancelling it if no other
+    // connection waits for it.
+    void finishJob(std::unordered_map<struct mg_connection*, Waiter>::iterator it);
+
+    // Run the event loop until stopped.
+    void run();
+
+    WorkerPool _workers;
+
+    // The requests being handled, by connection.  Only used on the event
+    // loop.
+    std::unordered_map<struct mg_connection*, Waiter> _jobs;
+    // The latest jobs which may be coalesced, by key.  Only those not
+    // started are joined.
+    std::unordered_map<std::string, std::shared_ptr<Job>> _sharedJobs;
+    // The requests given another's response, by class.
+    std::vector<uint64_t> _coalesced;
+
+    std::thread _loop;
+};
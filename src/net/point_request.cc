@@ -0,0 +1,188 @@
+#include "net/point_request.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace {
+    const struct {
+        const char* name;
+        PointRequest::Field field;
+    } fieldNames[] = {
+        {"node_id", PointRequest::NODE_ID},
+        {"node_a_id", PointRequest::NODE_A_ID},
+        {"node_b_id", PointRequest::NODE_B_ID},
+        {"durability", PointRequest::DURABILITY},
+        {"limit", PointRequest::LIMIT},
+        {"after", PointRequest::AFTER},
+    };
+
+    /**
+     * A cursor over the scanned data.  Reads past the end see a NUL.
+     */
+    class Scanner {
+    public:
+        Scanner(const std::string& data) : _position(data.data()), _end(data.data() + data.size()) {}
+
+        char peek() const {
+            return _position < _end ? *_position : '\0';
+        }
+
+        bool atEnd() const {
+            return _position == _end;
+        }
+
+        void skipSpace() {
+            while (_position < _end &&
+                   (*_position == ' ' || *_position == '\t' || *_position == '\n' || *_position == '\r')) {
+                _position++;
+            }
+        }
+
+        bool consume(char c) {
+            if (peek() != c) {
+                return false;
+            }
+
+            _position++;
+            return true;
+        }
+
+        // Read a string without escapes, after its opening quote.
+        bool readString(const char** begin, std::size_t* length) {
+            *begin = _position;
+            while (_position < _end && *_position != '"') {
+                if (*_position == '\\' || static_cast<unsigned char>(*_position) < 0x20) {
+                    return false;
+                }
+
+                _position++;
+            }
+
+            if (_position == _end) {
+                return false;
+            }
+
+            *length = _position - *begin;
+            _position++;
+            return true;
+        }
+
+        // Read an unsigned integer, without leading zeros, which fits in
+        // 64 bits.
+        bool readUnsigned(uint64_t* value) {
+            if (peek() < '0' || peek() > '9' || (peek() == '0' && isDigit(1))) {
+                return false;
+            }
+
+            *value = 0;
+            while (isDigit(0)) {
+                uint64_t digit = *_position - '0';
+                if (*value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+                    return false;
+                }
+
+                *value = *value * 10 + digit;
+                _position++;
+            }
+
+            return true;
+        }
+
+    private:
+        bool isDigit(std::size_t offset) const {
+            return _position + offset < _end && _position[offset] >= '0' && _position[offset] <= '9';
+        }
+
+        const char* _position;
+        const char* _end;
+    };
+
+    // Find the field named by the given key, or return 0.
+    unsigned findField(const char* key, std::size_t length) {
+        for (const auto& fieldName : fieldNames) {
+            if (std::strlen(fieldName.name) == length && std::memcmp(fieldName.name, key, length) == 0) {
+                return fieldName.field;
+            }
+        }
+
+        return 0;
+    }
+}
+
+bool scanPointRequest(const std::string& data, PointRequest* request) {
+    *request = PointRequest();
+
+    Scanner scanner(data);
+    scanner.skipSpace();
+    if (!scanner.consume('{')) {
+        return false;
+    }
+
+    scanner.skipSpace();
+    bool more = !scanner.consume('}');
+    while (more) {
+        const char* key;
+        std::size_t keyLength;
+        if (!scanner.consume('"') || !scanner.readString(&key, &keyLength)) {
+            return false;
+        }
+
+        unsigned field = findField(key, keyLength);
+        if (!field || request->fields & field) {
+            return false;
+        }
+
+        request->fields |= field;
+
+        scanner.skipSpace();
+        if (!scanner.consume(':')) {
+            return false;
+        }
+
+        scanner.skipSpace();
+        if (field == PointRequest::DURABILITY) {
+            if (!scanner.consume('"') ||
+                !scanner.readString(&request->durability, &request->durabilityLength)) {
+                return false;
+            }
+        } else {
+            uint64_t value;
+            if (!scanner.readUnsigned(&value)) {
+                return false;
+            }
+
+            // Ids are read as unsigned and stored as NodeIds, as by jsoncpp.
+            switch (field) {
+                case PointRequest::NODE_ID:
+                    request->nodeId = static_cast<NodeId>(value);
+                    break;
+                case PointRequest::NODE_A_ID:
+                    request->nodeAId = static_cast<NodeId>(value);
+                    break;
+                case PointRequest::LIMIT:
+                    request->limit = value;
+                    break;
+                case PointRequest::AFTER:
+                    request->after = static_cast<NodeId>(value);
+                    break;
+                default:
+                    request->nodeBId = static_cast<NodeId>(value);
+                    break;
+            }
+        }
+
+        scanner.skipSpace();
+        if (scanner.consume('}')) {
+            more = false;
+        } else if (scanner.consume(',')) {
+            scanner.skipSpace();
+        } else {
+            return false;
+        }
+    }
+
+    scanner.skipSpace();
+    return scanner.atEnd();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "db/types.h"
+
+/**
+ * The fields of a request naming a single node or edge, such as the body of
+ * an add_node, get_edge or get_neighbors request.
+ */
+struct PointRequest {
+    enum Field : unsigned {
+        NODE_ID = 1 << 0,
+        NODE_A_ID = 1 << 1,
+        NODE_B_ID = 1 << 2,
+        DURABILITY = 1 << 3,
+        LIMIT = 1 << 4,
+        AFTER = 1 << 5,
+    };
+
+    bool has(Field field) const {
+        return fields & field;
+    }
+
+    // The fields present in the request.
+    unsigned fields = 0;
+
+    NodeId nodeId = 0;
+    NodeId nodeAId = 0;
+    NodeId nodeBId = 0;
+
+    // The page of a neighbors request.
+    uint64_t limit = 0;
+    NodeId after = 0;
+
+    // The durability name, pointing into the scanned data.
+    const char* durability = nullptr;
+    std::size_t durabilityLength = 0;
+};
+
+/**
+ * Scan 'data' as a flat JSON object of the fields of a PointRequest, without
+ * allocating, and return whether it was understood.
+ *
+ * Only the shapes clients send are understood: unsigned integer ids and a
+ * durability string without escapes, each given at most once.  Anything else,
+ * valid JSON or not, is declined, and should be parsed in full instead.
+ */
+bool scanPointRequest(const std::string& data, PointRequest* request);
@@ -0,0 +1,51 @@
+#include "net/point_request.h"
+
+#include <string>
+
+#include "util/testing.h"
+
+TEST(PointRequestScan) {
+    PointRequest request;
+
+    EXPECT_TRUE(scanPointRequest("{\"node_id\": 12}", &request));
+    EXPECT_TRUE(request.has(PointRequest::NODE_ID));
+    EXPECT_FALSE(request.has(PointRequest::NODE_A_ID));
+    EXPECT_EQ(request.nodeId, 12);
+
+    EXPECT_TRUE(scanPointRequest(" {\"node_a_id\":3,\n\"durability\" : \"group\", \"node_b_id\":0} ", &request));
+    EXPECT_EQ(request.nodeAId, 3);
+    EXPECT_EQ(request.nodeBId, 0);
+    EXPECT_EQ(std::string(request.durability, request.durabilityLength), "group");
+
+    EXPECT_TRUE(scanPointRequest("{}", &request));
+    EXPECT_EQ(request.fields, 0);
+
+    END;
+}
+
+TEST(PointRequestDecline) {
+    PointRequest request;
+
+    EXPECT_FALSE(scanPointRequest("", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": -1}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1.0}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1e3}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 01}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": \"1\"}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 18446744073709551616}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1, \"node_id\": 2}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1, \"other\": 2}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_\\u0069d\": 1}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1,}", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1} x", &request));
+    EXPECT_FALSE(scanPointRequest("{\"node_id\": 1", &request));
+
+    EXPECT_TRUE(scanPointRequest("{\"node_id\": 18446744073709551615}", &request));
+
+    END;
+}
+
+int main() {
+    PointRequestScan();
+    PointRequestDecline();
+}
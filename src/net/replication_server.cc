@@ -7,7 +7,6 @@
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TBufferTransports.h>
 
-#include "db/logged_store.h"
 #include "util/assert.h"
 
 using namespace ::apache::thrift;
@@ -19,7 +18,7 @@ using boost::shared_ptr;
 
 class ReplicationHandler : virtual public ReplicationIf {
 public:
-    ReplicationHandler(ReplicationManager* manager, GraphStore* store, bool loggingEnabled) : _replicationManager(manager), _store(store), _loggingEnabled(loggingEnabled) {};
+    ReplicationHandler(ReplicationManager* manager, GraphStore* store, LoggedStore* loggedStore) : _replicationManager(manager), _store(store), _loggedStore(loggedStore) {};
 
     bool addNode(const NodeId nodeId) {
         if (!_store->addNode(nodeId)) {
@@ -50,11 +49,11 @@ public:
     }
 
     ReplicationCheckpointResult::type checkpoint() {
-        if (!_loggingEnabled) {
+        if (!_loggedStore) {
             return ReplicationCheckpointResult::CHECKPOINT_DISABLED;
         }
 
-        auto status = dynamic_cast<LoggedStore*>(_store)->checkpoint();
+        auto status = _loggedStore->checkpoint();
         if (!status) {
             return ReplicationCheckpointResult::OUT_OF_SPACE;
         }
@@ -76,21 +75,21 @@ public:
 private:
     ReplicationManager *_replicationManager = nullptr;
     GraphStore *_store = nullptr;
-    bool _loggingEnabled;
+    LoggedStore *_loggedStore = nullptr;
 };
 
 ReplicationServer::ReplicationServer(int port, GraphStore *store, ReplicationManager *manager,
-        bool loggingEnabled) :
+        LoggedStore *loggedStore) :
     _listenPort(port),
     _store(store),
     _replicationManager(manager),
-    _loggingEnabled(loggingEnabled) {
+    _loggedStore(loggedStore) {
 
 }
 
 void ReplicationServer::start() {
     std::cout << "ReplServer started." << std::endl;
-    shared_ptr<ReplicationHandler> handler(new ReplicationHandler(_replicationManager, _store, _loggingEnabled));
+    shared_ptr<ReplicationHandler> handler(new ReplicationHandler(_replicationManager, _store, _loggedStore));
     shared_ptr<TProcessor> processor(new ReplicationProcessor(handler));
     shared_ptr<TServerTransport> serverTransport(new TServerSocket(_listenPort));
     shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
@@ -5,6 +5,7 @@
 
 #include "Replication.h"
 #include "db/graph_store.h"
+#include "db/logged_store.h"
 #include "db/replication_manager.h"
 #include "util/nocopy.h"
 #include "util/stdx/memory.h"
@@ -20,10 +21,11 @@ public:
      * port: The port to listen for RPC calls on.
      * store: The graph store used for storage.
      * manager: The replication manager.
-     * loggingEnabled: Whether *this* server has logging enabled.
+     * loggedStore: The logged store under 'store', checkpointed on request,
+     *     or null if *this* server has logging disabled.
      */
     ReplicationServer(int port, GraphStore *store, ReplicationManager *manager,
-            bool loggingEnabled);
+            LoggedStore *loggedStore);
 
     void start();
     void stop();
@@ -31,7 +33,7 @@ private:
     int _listenPort;
     GraphStore *_store;
     ReplicationManager *_replicationManager;
-    bool _loggingEnabled;
+    LoggedStore *_loggedStore;
 
     std::unique_ptr<TSimpleServer> server = nullptr;
 };
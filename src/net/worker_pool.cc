@@ -0,0 +1,131 @@
+#include "net/worker_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "util/assert.h"
+
+WorkerPool::WorkerPool(std::size_t threadCount) : WorkerPool(threadCount, {Class()}) {}
+
+WorkerPool::WorkerPool(std::size_t threadCount, std::vector<Class> classes) {
+    invariant(!classes.empty());
+    for (const auto& limits : classes) {
+        invariant(limits.weight > 0);
+        _queues.emplace_back(limits);
+    }
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(threadCount, 1); i++) {
+        _threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+bool WorkerPool::submit(std::function<void()> task, std::size_t taskClass) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        invariant(!_stopping);
+        invariant(taskClass < _queues.size());
+
+        Queue& queue = _queues[taskClass];
+        if (queue.limits.maxQueued && queue.tasks.size() >= queue.limits.maxQueued) {
+            queue.rejected++;
+            return false;
+        }
+
+        queue.tasks.push_back(std::move(task));
+        _queuedCount++;
+    }
+    _queued.notify_one();
+    return true;
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _queued.notify_all();
+
+    for (auto& thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+std::vector<WorkerPool::ClassStats> WorkerPool::getStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<ClassStats> stats;
+    for (const auto& queue : _queues) {
+        stats.push_back({queue.tasks.size(), queue.running, queue.rejected});
+    }
+
+    return stats;
+}
+
+bool WorkerPool::isRunnable(const Queue& queue) {
+    return !queue.tasks.empty() &&
+           (!queue.limits.maxRunning || queue.running < queue.limits.maxRunning);
+}
+
+bool WorkerPool::hasRunnable() const {
+    return std::any_of(_queues.begin(), _queues.end(), isRunnable);
+}
+
+std::size_t WorkerPool::chooseClass() {
+    // Each runnable class gains its weight, and the one with the most
+    // credit is chosen and pays for it with the weights of all of them.
+    // Over time, each class is chosen in proportion to its weight, with
+    // its turns spread out between those of the others.
+    std::size_t chosen = _queues.size();
+    int64_t totalWeight = 0;
+    for (std::size_t i = 0; i < _queues.size(); i++) {
+        Queue& queue = _queues[i];
+        if (!isRunnable(queue)) {
+            continue;
+        }
+
+        queue.credit += queue.limits.weight;
+        totalWeight += queue.limits.weight;
+        if (chosen == _queues.size() || queue.credit > _queues[chosen].credit) {
+            chosen = i;
+        }
+    }
+
+    invariant(chosen < _queues.size());
+    _queues[chosen].credit -= totalWeight;
+    return chosen;
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        // Tasks held back by their class's limit wait for a running task of
+        // the class to finish.
+        _queued.wait(lock, [this] { return (_stopping && !_queuedCount) || hasRunnable(); });
+        if (!hasRunnable()) {
+            return;
+        }
+
+        Queue& queue = _queues[chooseClass()];
+        std::function<void()> task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queue.running++;
+        _queuedCount--;
+
+        lock.unlock();
+        task();
+        lock.lock();
+
+        queue.running--;
+        if (_stopping && !_queuedCount) {
+            _queued.notify_all();
+        } else if (!queue.tasks.empty()) {
+            _queued.notify_one();
+        }
+    }
+}
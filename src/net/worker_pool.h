@@ -0,0 +1,104 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/nocopy.h"
+
+/**
+ * A fixed set of threads running submitted tasks.
+ *
+ * Each task is submitted to one of the pool's classes, which has its own
+ * queue, run in submission order.  While several classes have tasks
+ * waiting, the threads take tasks from them in proportion to their
+ * weights, so a class with many slow tasks cannot hold up the others for
+ * long.  A class may also be limited in how many of its tasks run at once,
+ * keeping threads free for the others, and in how many may wait.
+ *
+ * Thread-safe.
+ */
+class WorkerPool {
+    DISALLOW_COPY(WorkerPool);
+public:
+    struct Class {
+        Class() {}
+        Class(unsigned weight, std::size_t maxRunning, std::size_t maxQueued)
+                : weight(weight), maxRunning(maxRunning), maxQueued(maxQueued) {}
+
+        // The share of tasks taken from the class while others wait.
+        unsigned weight = 1;
+        // The most tasks of the class which run at once, and which wait to
+        // run, or 0 for no limit.
+        std::size_t maxRunning = 0;
+        std::size_t maxQueued = 0;
+    };
+
+    struct ClassStats {
+        std::size_t queued;
+        std::size_t running;
+        // Tasks refused since the pool started, as the queue was full.
+        uint64_t rejected;
+    };
+
+    // With one class, without limits.
+    explicit WorkerPool(std::size_t threadCount);
+    WorkerPool(std::size_t threadCount, std::vector<Class> classes);
+
+    // Runs the tasks still queued, then stops the threads.
+    ~WorkerPool();
+
+    /**
+     * Queue 'task' to run on one of the threads, as a task of 'taskClass'.
+     * Returns false, dropping the task, if the class's queue is full.
+     */
+    bool submit(std::function<void()> task, std::size_t taskClass = 0);
+
+    /**
+     * Run the tasks still queued, and stop the threads.  No more tasks may
+     * be submitted.
+     */
+    void stop();
+
+    /**
+     * Get the state of each class.
+     */
+    std::vector<ClassStats> getStats() const;
+
+private:
+    struct Queue {
+        explicit Queue(const Class& limits) : limits(limits) {}
+
+        Class limits;
+        std::deque<std::function<void()>> tasks;
+        std::size_t running = 0;
+        uint64_t rejected = 0;
+
+        // The class's credit in the weighted round robin.
+        int64_t credit = 0;
+    };
+
+    // Run tasks until stopped and the queues are empty.
+    void run();
+
+    // Whether a task of 'queue' may be started now.
+    static bool isRunnable(const Queue& queue);
+    bool hasRunnable() const;
+
+    // Choose the class of the next task to start, by smooth weighted round
+    // robin among the classes with a runnable task.  There must be one.
+    std::size_t chooseClass();
+
+    mutable std::mutex _mutex;
+    std::condition_variable _queued;
+    std::vector<Queue> _queues;
+    std::size_t _queuedCount = 0;
+    bool _stopping = false;
+
+    std::vector<std::thread> _threads;
+};
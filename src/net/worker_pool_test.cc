@@ -0,0 +1,71 @@
+#include "net/worker_pool.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "util/testing.h"
+
+TEST(WorkerPoolWeights) {
+    std::string order;
+    {
+        WorkerPool pool(1, {WorkerPool::Class(3, 0, 0), WorkerPool::Class(1, 0, 4)});
+
+        // Hold the only thread while both queues fill.
+        std::promise<void> started;
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        pool.submit([&started, released] {
+            started.set_value();
+            released.wait();
+        });
+        started.get_future().wait();
+
+        for (int i = 0; i < 8; i++) {
+            EXPECT_TRUE(pool.submit([&order] { order += 'a'; }, 0));
+        }
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(pool.submit([&order] { order += 'b'; }, 1));
+        }
+        EXPECT_FALSE(pool.submit([&order] { order += 'b'; }, 1));
+
+        auto stats = pool.getStats();
+        EXPECT_EQ(stats[0].queued, 8);
+        EXPECT_EQ(stats[1].queued, 4);
+        EXPECT_EQ(stats[1].rejected, 1);
+
+        release.set_value();
+    }
+
+    EXPECT_EQ(order, "aabaaabaaabb");
+
+    END;
+}
+
+TEST(WorkerPoolMaxRunning) {
+    std::atomic<int> running{0};
+    std::atomic<int> mostRunning{0};
+    {
+        WorkerPool pool(4, {WorkerPool::Class(), WorkerPool::Class(1, 1, 0)});
+        for (int i = 0; i < 32; i++) {
+            pool.submit([&] {
+                int now = ++running;
+                int most = mostRunning;
+                while (now > most && !mostRunning.compare_exchange_weak(most, now)) {}
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                running--;
+            }, 1);
+        }
+    }
+
+    EXPECT_EQ(mostRunning, 1);
+
+    END;
+}
+
+int main() {
+    WorkerPoolWeights();
+    WorkerPoolMaxRunning();
+}
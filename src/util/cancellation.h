@@ -0,0 +1,97 @@
+/**
+ * cancellation.h: Telling long running operations their result is no
+ * longer wanted.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+#include "util/nocopy.h"
+
+/**
+ * Cancels an operation, at once or once a deadline passes.  Operations
+ * check it now and then, and stop early with CANCELLED once it is.
+ *
+ * Thread-safe.
+ */
+class Cancellation {
+    DISALLOW_COPY(Cancellation);
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Cancellation() {}
+
+    void cancel() {
+        _cancelled = true;
+    }
+
+    /**
+     * Cancel once 'deadline' passes.
+     */
+    void setDeadline(Clock::time_point deadline) {
+        _deadline = deadline.time_since_epoch().count();
+    }
+
+    /**
+     * Move the deadline to 'deadline', if it is later.
+     */
+    void extendDeadline(Clock::time_point deadline) {
+        Clock::rep ticks = deadline.time_since_epoch().count();
+        Clock::rep current = _deadline;
+        while (current < ticks && !_deadline.compare_exchange_weak(current, ticks)) {}
+    }
+
+    /**
+     * Whether the operation should stop.  Reads the clock if there is a
+     * deadline.
+     */
+    bool isCancelled() const {
+        if (_cancelled) {
+            return true;
+        }
+
+        Clock::rep deadline = _deadline;
+        return deadline != NO_DEADLINE && Clock::now().time_since_epoch().count() >= deadline;
+    }
+
+    /**
+     * Get the cancellation of the request being handled by this thread, or
+     * null.
+     */
+    static const Cancellation* current() {
+        return *currentSlot();
+    }
+
+    /**
+     * Makes a cancellation current on this thread while in scope.
+     */
+    class Scope {
+        DISALLOW_COPY(Scope);
+    public:
+        explicit Scope(const Cancellation* cancellation) : _previous(current()) {
+            *currentSlot() = cancellation;
+        }
+
+        ~Scope() {
+            *currentSlot() = _previous;
+        }
+
+    private:
+        const Cancellation* _previous;
+    };
+
+private:
+    static const Clock::rep NO_DEADLINE = std::numeric_limits<Clock::rep>::max();
+
+    static const Cancellation** currentSlot() {
+        static thread_local const Cancellation* cancellation = nullptr;
+        return &cancellation;
+    }
+
+    std::atomic<bool> _cancelled{false};
+    std::atomic<Clock::rep> _deadline{NO_DEADLINE};
+};
@@ -0,0 +1,39 @@
+// Utilities for running work on several threads.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * Get the number of threads to split CPU bound work across.
+ */
+inline std::size_t threadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Run 'task(i)' for each i in [0, count), each on its own thread, and wait
+ * for all of them to finish.
+ */
+template <typename Task>
+void run(std::size_t count, Task task) {
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < count; i++) {
+        threads.emplace_back(task, i);
+    }
+
+    if (count) {
+        task(0);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+}
@@ -47,7 +47,13 @@ enum class StatusCode {
      */
     WRONG_PARTITION,
 
-    PARTITION_FAIL
+    PARTITION_FAIL,
+
+    /**
+     * The operation was cancelled, or its deadline passed, before it
+     * finished.
+     */
+    CANCELLED
 };
 
 class Status {